@@ -0,0 +1,59 @@
+#pragma once
+
+#include <veldrid/backend/Backends.hpp>
+#include <veldrid/GraphicsDevice.hpp>
+#include <veldrid/CommandList.hpp>
+#include <veldrid/SyncObjects.hpp>
+
+#include <chrono>
+#include <string>
+
+#include "App.hpp"
+
+//Average seconds per call of fn
+template<typename Fn>
+double MeasureSec(unsigned iterations, Fn&& fn) {
+	using _Clock = std::chrono::steady_clock;
+	auto start = _Clock::now();
+	for (unsigned i = 0; i < iterations; i++) {
+		fn();
+	}
+	std::chrono::duration<double> total = _Clock::now() - start;
+	return total.count() / iterations;
+}
+
+//Base of the measurement demos: creates a device for the window, runs
+//the measurement once, prints it and exits without presenting anything.
+class BenchApp : public AppBase {
+
+protected:
+	Veldrid::sp<Veldrid::GraphicsDevice> dev;
+
+	BenchApp(const std::string& name) : AppBase(320, 240, name) {}
+
+	virtual void RunBench() = 0;
+
+	void SubmitAndWait(Veldrid::CommandList* cmd) {
+		auto fence = dev->GetResourceFactory()->CreateFence(false);
+		dev->SubmitCommand({ cmd }, {}, {}, fence.get());
+		fence->WaitForSignal();
+	}
+
+	void OnAppStart(
+		Veldrid::SwapChainSource* swapChainSrc,
+		unsigned surfaceWidth,
+		unsigned surfaceHeight
+	) override {
+		Veldrid::GraphicsDevice::Options opt{};
+		dev = Veldrid::CreateVulkanGraphicsDevice(opt, swapChainSrc);
+	}
+
+	void OnAppExit() override {
+		dev->WaitForIdle();
+	}
+
+	bool OnAppUpdate(float) override {
+		RunBench();
+		return false;
+	}
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <veldrid/Shader.hpp>
+
+#include <string>
+#include <vector>
+
+//Shaders covering the resource kinds of a ResourceLayout, with arrays,
+//specialization and push constants, storage images and input
+//attachments. Shared by the reflection demos, the first three are
+//checked against hand written layouts.
+struct CorpusShader {
+	std::string name;
+	Veldrid::Shader::Description::Stage stage;
+	std::string source;
+};
+
+inline std::vector<CorpusShader> GetShaderCorpus() {
+	Veldrid::Shader::Description::Stage vertex{}, fragment{}, compute{};
+	vertex.vertex = 1;
+	fragment.fragment = 1;
+	compute.compute = 1;
+
+	return {
+		{ "object.vert", vertex, R"(
+#version 450
+
+layout(location = 0) in vec3 Position;
+layout(location = 1) in vec2 UV;
+
+layout(location = 0) out vec2 fsin_UV;
+
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 view;
+    mat4 proj;
+} camera;
+
+layout(set = 1, binding = 0) uniform Object {
+    mat4 model;
+} object;
+
+void main()
+{
+    fsin_UV = UV;
+    gl_Position = camera.proj * camera.view * object.model * vec4(Position, 1.0);
+}
+)" },
+		{ "object.frag", fragment, R"(
+#version 450
+
+layout(location = 0) in vec2 fsin_UV;
+layout(location = 0) out vec4 fsout_Color;
+
+layout(set = 1, binding = 1) uniform texture2D BaseColor;
+layout(set = 1, binding = 2) uniform sampler BaseSampler;
+
+layout(push_constant) uniform Material {
+    vec4 tint;
+} material;
+
+void main()
+{
+    fsout_Color = texture(sampler2D(BaseColor, BaseSampler), fsin_UV) * material.tint;
+}
+)" },
+		{ "cull.comp", compute, R"(
+#version 450
+
+layout(local_size_x_id = 0) in;
+
+layout(constant_id = 1) const uint MaxCount = 256;
+
+layout(set = 0, binding = 0) readonly buffer Bounds {
+    vec4 spheres[];
+} bounds;
+
+layout(set = 0, binding = 1) buffer Visibility {
+    uint visible[];
+} visibility;
+
+layout(set = 0, binding = 2, rgba8) uniform writeonly image2D DebugImage;
+
+layout(push_constant) uniform Params {
+    uint count;
+} params;
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= min(params.count, MaxCount)) return;
+    bool isVisible = bounds.spheres[i].w > 0.0;
+    visibility.visible[i] = isVisible ? 1u : 0u;
+    imageStore(DebugImage, ivec2(i, 0), vec4(isVisible ? 1.0 : 0.0));
+}
+)" },
+		{ "skinning.vert", vertex, R"(
+#version 450
+
+layout(constant_id = 0) const int MaxBones = 64;
+layout(constant_id = 1) const bool UseNormals = true;
+layout(constant_id = 2) const float Scale = 1.0;
+
+layout(location = 0) in vec3 Position;
+layout(location = 1) in vec3 Normal;
+layout(location = 2) in uvec4 Joints;
+layout(location = 3) in vec4 Weights;
+
+layout(location = 0) out vec3 fsin_Normal;
+
+layout(set = 0, binding = 0) uniform Skin {
+    mat4 bones[MaxBones];
+} skin;
+
+layout(set = 0, binding = 1) uniform Light {
+    vec4 direction;
+    vec4 color;
+} lights[4];
+
+layout(push_constant) uniform Draw {
+    layout(row_major) mat4 model;
+    vec4 offsets[2];
+} draw;
+
+void main()
+{
+    mat4 skinMatrix = Weights.x * skin.bones[Joints.x] + Weights.y * skin.bones[Joints.y]
+        + Weights.z * skin.bones[Joints.z] + Weights.w * skin.bones[Joints.w];
+    vec3 light = lights[0].color.rgb * max(dot(Normal, lights[0].direction.xyz), 0.0)
+        + lights[3].color.rgb;
+    fsin_Normal = UseNormals ? mat3(skinMatrix) * Normal * light : vec3(0.0);
+    gl_Position = draw.model * skinMatrix * vec4(Position * Scale, 1.0) + draw.offsets[1];
+}
+)" },
+		{ "post.comp", compute, R"(
+#version 450
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(constant_id = 0) const uint Passes = 2;
+
+layout(set = 0, binding = 0, rgba32f) uniform readonly image2D Source;
+layout(set = 0, binding = 1, r32ui) uniform uimage2D Counters;
+layout(set = 0, binding = 2, rgba16f) uniform writeonly image2D Targets[2];
+layout(set = 0, binding = 3) uniform sampler2D Luts[3];
+
+struct Tile {
+    vec4 bounds;
+    uint count;
+};
+
+layout(set = 1, binding = 0) buffer Tiles {
+    uint tileCount;
+    Tile tiles[];
+} tiles;
+
+layout(push_constant) uniform Params {
+    ivec2 size;
+    float exposure;
+} params;
+
+void main()
+{
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(p, params.size))) return;
+    vec4 c = imageLoad(Source, p) * params.exposure;
+    c = textureLod(Luts[0], c.rg, 0.0) + textureLod(Luts[2], c.ba, 0.0);
+    imageAtomicAdd(Counters, p / 8, 1u);
+    imageStore(Targets[0], p, c);
+    imageStore(Targets[1], p, c * 0.5);
+    uint slot = atomicAdd(tiles.tileCount, 1u);
+    tiles.tiles[slot].bounds = vec4(p, p + 1);
+    tiles.tiles[slot].count = Passes;
+}
+)" },
+		{ "resolve.frag", fragment, R"(
+#version 450
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput Depth;
+layout(set = 0, binding = 1) uniform sampler2DArray Shadows;
+layout(set = 0, binding = 2) readonly buffer Materials {
+    vec4 albedo[];
+} materials;
+
+layout(location = 0) in vec2 fsin_UV;
+layout(location = 0) out vec4 Albedo;
+layout(location = 1) out vec2 Normal;
+
+void main()
+{
+    float depth = subpassLoad(Depth).r;
+    Albedo = materials.albedo[0] * texture(Shadows, vec3(fsin_UV, depth)).r;
+    Normal = fsin_UV;
+}
+)" },
+	};
+}
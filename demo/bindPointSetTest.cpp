@@ -0,0 +1,181 @@
+#include <veldrid/BindableResource.hpp>
+#include <veldrid/Buffer.hpp>
+#include <veldrid/Framebuffer.hpp>
+#include <veldrid/Pipeline.hpp>
+#include <veldrid/Shader.hpp>
+#include <veldrid/Texture.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "app/Bench.hpp"
+
+const std::string VertexCode = R"(
+#version 450
+
+layout(set = 0, binding = 0) readonly buffer Values { uint values[]; };
+
+void main()
+{
+    vec2 pos = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, float(values[0] & 1u), 1.0);
+}
+)";
+
+const std::string FragmentCode = R"(
+#version 450
+
+layout(location = 0) out vec4 fsout_Color;
+
+void main()
+{
+    fsout_Color = vec4(1.0);
+}
+)";
+
+const std::string ComputeCode = R"(
+#version 450
+
+layout(local_size_x = 64) in;
+
+layout(set = 0, binding = 0) buffer Values { uint values[]; };
+
+void main()
+{
+    values[gl_GlobalInvocationID.x] = gl_GlobalInvocationID.x + 1u;
+}
+)";
+
+//Binds the same set on the graphics and then on the compute bind point.
+//Vulkan keeps the bindings of each point apart, the compute bind must
+//not be skipped as already bound or the dispatch writes nothing.
+class BindPointSetTest : public BenchApp {
+
+    static constexpr std::uint32_t kValueCount = 256;
+
+    unsigned failures = 0;
+
+    std::vector<std::uint32_t> Compile(
+        Veldrid::Shader::Description::Stage stage, const std::string& code
+    ) {
+        std::string compileInfo;
+        std::vector<std::uint32_t> spv;
+        if (!Veldrid::IGLSLCompiler::Get()->CompileToSPIRV(stage, code, "main", {}, spv, compileInfo)) {
+            std::cout << compileInfo << "\n";
+        }
+        return spv;
+    }
+
+    void RunBench() override {
+        auto factory = dev->GetResourceFactory();
+
+        using ElemKind = Veldrid::ResourceLayout::Description::ElementDescription::ResourceKind;
+        Veldrid::ResourceLayout::Description layoutDesc{};
+        layoutDesc.elements.resize(1, {});
+        layoutDesc.elements[0].name = "Values";
+        layoutDesc.elements[0].kind = ElemKind::StructuredBufferReadWrite;
+        layoutDesc.elements[0].stages.vertex = 1;
+        layoutDesc.elements[0].stages.compute = 1;
+        auto layout = factory->CreateResourceLayout(layoutDesc);
+
+        Veldrid::Buffer::Description bufDesc{};
+        bufDesc.sizeInBytes = kValueCount * sizeof(std::uint32_t);
+        bufDesc.usage.structuredBufferReadWrite = 1;
+        auto values = factory->CreateBuffer(bufDesc);
+        bufDesc.usage = {};
+        bufDesc.usage.staging = 1;
+        auto readback = factory->CreateBuffer(bufDesc);
+
+        Veldrid::ResourceSet::Description setDesc{};
+        setDesc.layout = layout;
+        setDesc.boundResources = { Veldrid::BufferRange::Make(values) };
+        auto set = factory->CreateResourceSet(setDesc);
+
+        Veldrid::Texture::Description texDesc{};
+        texDesc.width = 16;
+        texDesc.height = 16;
+        texDesc.depth = 1;
+        texDesc.mipLevels = 1;
+        texDesc.arrayLayers = 1;
+        texDesc.format = Veldrid::PixelFormat::R8_G8_B8_A8_UNorm;
+        texDesc.usage.renderTarget = 1;
+        texDesc.type = Veldrid::Texture::Description::Type::Texture2D;
+        texDesc.sampleCount = Veldrid::Texture::Description::SampleCount::x1;
+        Veldrid::Framebuffer::Description fbDesc{};
+        fbDesc.colorTargets = { { factory->CreateTexture(texDesc), 0, 0 } };
+        auto fb = factory->CreateFramebuffer(fbDesc);
+
+        Veldrid::Shader::Description vertexShaderDesc{};
+        vertexShaderDesc.stage.vertex = 1;
+        vertexShaderDesc.entryPoint = "main";
+        Veldrid::Shader::Description fragmentShaderDesc{};
+        fragmentShaderDesc.stage.fragment = 1;
+        fragmentShaderDesc.entryPoint = "main";
+        Veldrid::Shader::Description computeShaderDesc{};
+        computeShaderDesc.stage.compute = 1;
+        computeShaderDesc.entryPoint = "main";
+
+        Veldrid::GraphicsPipelineDescription graphicsDesc{};
+        graphicsDesc.blendState.attachments = { Veldrid::BlendStateDescription::Attachment::MakeOverrideBlend() };
+        graphicsDesc.depthStencilState.depthTestEnabled = false;
+        graphicsDesc.rasterizerState.cullMode = Veldrid::RasterizerStateDescription::FaceCullMode::None;
+        graphicsDesc.rasterizerState.fillMode = Veldrid::RasterizerStateDescription::PolygonFillMode::Solid;
+        graphicsDesc.rasterizerState.depthClipEnabled = true;
+        graphicsDesc.primitiveTopology = Veldrid::PrimitiveTopology::TriangleList;
+        graphicsDesc.shaderSet.shaders = {
+            factory->CreateShader(vertexShaderDesc, Compile(vertexShaderDesc.stage, VertexCode)),
+            factory->CreateShader(fragmentShaderDesc, Compile(fragmentShaderDesc.stage, FragmentCode))
+        };
+        graphicsDesc.resourceLayouts = { layout };
+        graphicsDesc.outputs = fb->GetOutputDescription();
+        auto graphicsPipeline = factory->CreateGraphicsPipeline(graphicsDesc);
+
+        Veldrid::ComputePipelineDescription computeDesc{};
+        computeDesc.computeShader = factory->CreateShader(
+            computeShaderDesc, Compile(computeShaderDesc.stage, ComputeCode));
+        computeDesc.resourceLayouts = { layout };
+        computeDesc.threadGroupSizeX = 64;
+        computeDesc.threadGroupSizeY = 1;
+        computeDesc.threadGroupSizeZ = 1;
+        auto computePipeline = factory->CreateComputePipeline(computeDesc);
+
+        auto cmd = factory->CreateCommandList();
+        cmd->Begin();
+        cmd->BeginRenderPass(fb);
+        cmd->SetPipeline(graphicsPipeline);
+        cmd->SetFullViewports();
+        cmd->SetFullScissorRects();
+        cmd->SetGraphicsResourceSet(0, set, {});
+        cmd->Draw(3);
+        cmd->EndRenderPass();
+
+        cmd->SetPipeline(computePipeline);
+        cmd->SetComputeResourceSet(0, set, {});
+        cmd->Dispatch(kValueCount / 64, 1, 1);
+        cmd->CopyBuffer(values, 0, readback, 0, bufDesc.sizeInBytes);
+        cmd->End();
+        SubmitAndWait(cmd.get());
+
+        auto* result = static_cast<const std::uint32_t*>(readback->MapToCPU());
+        for (std::uint32_t i = 0; i < kValueCount; i++) {
+            if (result[i] != i + 1) failures++;
+        }
+        readback->UnMap();
+
+        std::cout << (failures == 0 ? "PASS " : "FAIL ")
+            << "same set bound on graphics then compute\n";
+    }
+
+public:
+    BindPointSetTest() : BenchApp("Resource set bind points") {}
+
+    unsigned GetFailures() const { return failures; }
+};
+
+int main() {
+    BindPointSetTest app;
+    app.Run();
+    return app.GetFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#include <veldrid/BindableResource.hpp>
+#include <veldrid/Buffer.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "app/Bench.hpp"
+
+//Loader threads creating resource sets at once. Every set binds its own
+//buffer ranges so none is shared through the set cache, each creation
+//allocates a descriptor set and each release frees one.
+class DescriptorAllocBench : public BenchApp {
+
+    static constexpr unsigned kSetsPerThread = 4096;
+    static constexpr unsigned kRounds = 5;
+    //Covers minUniformBufferOffsetAlignment of every device
+    static constexpr std::uint32_t kRangeSize = 256;
+
+    Veldrid::sp<Veldrid::ResourceLayout> layout;
+
+    struct _Worker {
+        Veldrid::sp<Veldrid::Buffer> uniforms, structs;
+        std::vector<Veldrid::sp<Veldrid::ResourceSet>> sets;
+    };
+
+    void CreateAndRelease(_Worker& worker) {
+        auto factory = dev->GetResourceFactory();
+        for (unsigned i = 0; i < kSetsPerThread; i++) {
+            Veldrid::ResourceSet::Description desc{};
+            desc.layout = layout;
+            desc.boundResources = {
+                Veldrid::BufferRange::Make(worker.uniforms, i * kRangeSize, kRangeSize),
+                Veldrid::BufferRange::Make(worker.structs, i * kRangeSize, kRangeSize)
+            };
+            worker.sets.push_back(factory->CreateResourceSet(desc));
+        }
+        worker.sets.clear();
+    }
+
+    void RunBench() override {
+        auto factory = dev->GetResourceFactory();
+
+        using ElemKind = Veldrid::ResourceLayout::Description::ElementDescription::ResourceKind;
+        Veldrid::ResourceLayout::Description layoutDesc{};
+        layoutDesc.elements.resize(2, {});
+        layoutDesc.elements[0].name = "Uniforms";
+        layoutDesc.elements[0].kind = ElemKind::UniformBuffer;
+        layoutDesc.elements[0].stages.vertex = 1;
+        layoutDesc.elements[1].name = "Structs";
+        layoutDesc.elements[1].kind = ElemKind::StructuredBufferReadOnly;
+        layoutDesc.elements[1].stages.vertex = 1;
+        layout = factory->CreateResourceLayout(layoutDesc);
+
+        auto maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<_Worker> workers(maxThreads);
+        for (auto& worker : workers) {
+            Veldrid::Buffer::Description desc{};
+            desc.sizeInBytes = kSetsPerThread * kRangeSize;
+            desc.usage.uniformBuffer = 1;
+            worker.uniforms = factory->CreateBuffer(desc);
+            desc.usage = {};
+            desc.usage.structuredBufferReadOnly = 1;
+            worker.structs = factory->CreateBuffer(desc);
+            worker.sets.reserve(kSetsPerThread);
+        }
+
+        for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+            auto sec = MeasureSec(kRounds, [&]() {
+                std::vector<std::thread> threads;
+                for (unsigned t = 0; t < threadCount; t++) {
+                    threads.emplace_back([&, t]() { CreateAndRelease(workers[t]); });
+                }
+                for (auto& thread : threads) thread.join();
+            });
+
+            auto setCount = kSetsPerThread * threadCount;
+            std::cout << threadCount << " thread(s)"
+                << ": " << setCount / sec / 1e3 << "k sets/s"
+                << ", " << sec * 1e9 / kSetsPerThread << " ns/set per thread\n";
+        }
+    }
+
+public:
+    DescriptorAllocBench() : BenchApp("Descriptor allocation") {}
+};
+
+int main() {
+    DescriptorAllocBench app;
+    app.Run();
+}
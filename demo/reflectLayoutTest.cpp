@@ -0,0 +1,126 @@
+#include <veldrid/ResourceFactory.hpp>
+#include <veldrid/ShaderReflection.hpp>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "app/Bench.hpp"
+#include "app/ShaderCorpus.hpp"
+
+using ElemKind = Veldrid::ResourceLayout::Description::ElementDescription::ResourceKind;
+using Stage = Veldrid::Shader::Description::Stage;
+
+//Hand written layouts of the corpus shaders, the ones generated by
+//ReflectPipelineLayout have to match them. Also checks that identical
+//generated layouts are shared and how long the merge takes.
+class ReflectLayoutTest : public BenchApp {
+
+    struct ExpectedElement {
+        ElemKind kind;
+        std::uint8_t stages;
+    };
+
+    unsigned failures = 0;
+
+    void Check(bool passed, const std::string& what) {
+        std::cout << (passed ? "PASS " : "FAIL ") << what << "\n";
+        if (!passed) failures++;
+    }
+
+    void CheckLayout(
+        const std::string& name,
+        const Veldrid::ReflectedPipelineLayout& layout,
+        const std::vector<std::vector<ExpectedElement>>& expectedSets,
+        const Veldrid::PushConstantRange& expectedPush
+    ) {
+        bool same = layout.resourceLayouts.size() == expectedSets.size();
+        for (std::size_t set = 0; same && set < expectedSets.size(); set++) {
+            auto& elements = layout.resourceLayouts[set].elements;
+            auto& expected = expectedSets[set];
+            same = elements.size() == expected.size();
+            for (std::size_t i = 0; same && i < expected.size(); i++) {
+                same = elements[i].kind == expected[i].kind
+                    && elements[i].stages.value == expected[i].stages
+                    && elements[i].options.value == 0;
+            }
+        }
+        Check(same, name + " resource layouts");
+
+        auto& ranges = layout.pushConstantRanges;
+        Check(ranges.size() == 1
+            && ranges[0].stages.value == expectedPush.stages.value
+            && ranges[0].offset == expectedPush.offset
+            && ranges[0].size == expectedPush.size,
+            name + " push constant ranges");
+    }
+
+    void RunBench() override {
+        auto corpus = GetShaderCorpus();
+        std::vector<std::unique_ptr<Veldrid::ShaderModule>> modules;
+        for (auto& shader : corpus) {
+            modules.push_back(std::make_unique<Veldrid::ShaderModule>(shader.stage, shader.source));
+            Check(modules.back()->IsValid(), shader.name + " compiles");
+        }
+        if (failures != 0) return;
+
+        auto& vertex = corpus[0].stage;
+        auto& fragment = corpus[1].stage;
+        auto& compute = corpus[2].stage;
+
+        std::string error;
+        Veldrid::ReflectedPipelineLayout objectLayout;
+        Check(Veldrid::ReflectPipelineLayout({ modules[0].get(), modules[1].get() }, objectLayout, error),
+            "object pipeline reflects " + error);
+        CheckLayout("object pipeline", objectLayout,
+            {
+                { { ElemKind::UniformBuffer, vertex.value } },
+                {
+                    { ElemKind::UniformBuffer, vertex.value },
+                    { ElemKind::TextureReadOnly, fragment.value },
+                    { ElemKind::Sampler, fragment.value },
+                },
+            },
+            { fragment, 0, 16 });
+
+        Veldrid::ReflectedPipelineLayout cullLayout;
+        Check(Veldrid::ReflectPipelineLayout({ modules[2].get() }, cullLayout, error),
+            "cull pipeline reflects " + error);
+        CheckLayout("cull pipeline", cullLayout,
+            {
+                {
+                    { ElemKind::StructuredBufferReadOnly, compute.value },
+                    { ElemKind::StructuredBufferReadWrite, compute.value },
+                    { ElemKind::TextureReadWrite, compute.value },
+                },
+            },
+            { compute, 0, 4 });
+
+        auto factory = dev->GetResourceFactory();
+        auto first = Veldrid::CreateResourceLayouts(*factory, objectLayout);
+        auto second = Veldrid::CreateResourceLayouts(*factory, objectLayout);
+        bool shared = first.size() == second.size();
+        for (std::size_t i = 0; shared && i < first.size(); i++) {
+            shared = first[i].get() == second[i].get();
+        }
+        Check(shared, "generated layouts are shared");
+
+        auto sec = MeasureSec(10000, [&]() {
+            Veldrid::ReflectedPipelineLayout layout;
+            Veldrid::ReflectPipelineLayout({ modules[0].get(), modules[1].get() }, layout, error);
+        });
+        std::cout << "ReflectPipelineLayout: " << sec * 1e6 << " us per vertex+fragment pair\n";
+    }
+
+public:
+    ReflectLayoutTest() : BenchApp("Reflected pipeline layouts") {}
+
+    unsigned GetFailures() const { return failures; }
+};
+
+int main() {
+    ReflectLayoutTest app;
+    app.Run();
+    return app.GetFailures() == 0 ? 0 : 1;
+}
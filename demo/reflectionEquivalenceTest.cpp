@@ -0,0 +1,128 @@
+#include <veldrid/Shader.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "app/Bench.hpp"
+#include "app/ShaderCorpus.hpp"
+
+//The lean SPIR-V scanner must produce the same records, in the same
+//order, as the SPIRV-Cross reflector it replaces. Also compares how long
+//each of them takes per module, and checks that malformed modules are
+//declined instead of read out of bounds or walked forever.
+
+static void PrintResource(const char* reflector, const Veldrid::ShaderResource& res) {
+    std::cout << "    " << reflector << ": '" << res.name << "'"
+        << " type " << static_cast<unsigned>(res.type)
+        << " mode " << static_cast<unsigned>(res.mode)
+        << " set " << res.set << " binding " << res.binding
+        << " location " << res.location
+        << " vec " << res.vec_size << "x" << res.columns
+        << " array " << res.array_size
+        << " offset " << res.offset << " size " << res.size
+        << " constant " << res.constant_id
+        << " qualifiers " << res.qualifiers << "\n";
+}
+
+//Header of a module with the given id bound, followed by instructions
+static std::vector<std::uint32_t> MakeModule(
+    std::uint32_t bound, std::initializer_list<std::uint32_t> instructions
+) {
+    std::vector<std::uint32_t> words{ 0x07230203, 0x00010000, 0, bound, 0 };
+    words.insert(words.end(), instructions);
+    return words;
+}
+
+static constexpr std::uint32_t Op(std::uint32_t wordCount, std::uint32_t opcode) {
+    return wordCount << 16 | opcode;
+}
+
+int main() {
+    constexpr unsigned kIterations = 1000;
+
+    auto compiler = Veldrid::IGLSLCompiler::Get();
+    Veldrid::ShaderVariant variant;
+    unsigned failures = 0;
+
+    for (auto& shader : GetShaderCorpus()) {
+        std::vector<std::uint32_t> spirv;
+        std::string log;
+        if (!compiler->CompileToSPIRV(shader.stage, shader.source, "main", variant, spirv, log)) {
+            std::cout << "FAIL " << shader.name << " compiles\n" << log << "\n";
+            failures++;
+            continue;
+        }
+
+        std::vector<Veldrid::ShaderResource> lean, full;
+        bool handled = Veldrid::SPIRVReflection::reflect_shader_resources_lean(
+            spirv.data(), spirv.size(), lean, variant);
+        Veldrid::SPIRVReflection::reflect_shader_resources_spirv_cross(spirv, full, variant);
+
+        bool same = handled && lean.size() == full.size();
+        for (std::size_t i = 0; same && i < lean.size(); i++) {
+            if (!Veldrid::SPIRVReflection::is_same_resource(lean[i], full[i])) {
+                std::cout << "  record " << i << " differs\n";
+                PrintResource("lean", lean[i]);
+                PrintResource("spirv-cross", full[i]);
+                same = false;
+            }
+        }
+        if (handled && lean.size() != full.size()) {
+            std::cout << "  " << lean.size() << " records vs " << full.size() << "\n";
+        }
+        std::cout << (same ? "PASS " : "FAIL ") << shader.name
+            << (handled ? "" : " (not handled by the lean scanner)") << "\n";
+        if (!same) failures++;
+
+        auto leanSec = MeasureSec(kIterations, [&]() {
+            std::vector<Veldrid::ShaderResource> resources;
+            Veldrid::SPIRVReflection::reflect_shader_resources_lean(
+                spirv.data(), spirv.size(), resources, variant);
+        });
+        auto fullSec = MeasureSec(kIterations, [&]() {
+            std::vector<Veldrid::ShaderResource> resources;
+            Veldrid::SPIRVReflection::reflect_shader_resources_spirv_cross(spirv, resources, variant);
+        });
+        std::cout << "  lean " << leanSec * 1e6 << " us"
+            << ", spirv-cross " << fullSec * 1e6 << " us"
+            << " (" << spirv.size() << " words)\n";
+    }
+
+    struct Malformed {
+        const char* name;
+        std::vector<std::uint32_t> spirv;
+    };
+    const Malformed malformed[] = {
+        { "array of itself", MakeModule(6, {
+            Op(4, 21), 1, 32, 0,        //%1 = OpTypeInt 32 0
+            Op(4, 43), 1, 2, 4,         //%2 = OpConstant %1 4
+            Op(4, 28), 3, 3, 2,         //%3 = OpTypeArray %3 %2
+            Op(4, 32), 4, 2, 3,         //%4 = OpTypePointer Uniform %3
+            Op(4, 59), 4, 5, 2,         //%5 = OpVariable %4 Uniform
+        }) },
+        { "arrays of each other", MakeModule(7, {
+            Op(4, 21), 1, 32, 0,        //%1 = OpTypeInt 32 0
+            Op(4, 43), 1, 2, 4,         //%2 = OpConstant %1 4
+            Op(4, 28), 3, 1, 2,         //%3 = OpTypeArray %1 %2
+            Op(4, 28), 4, 3, 2,         //%4 = OpTypeArray %3 %2
+            Op(4, 28), 3, 4, 2,         //%3 = OpTypeArray %4 %2, redeclared
+            Op(4, 32), 5, 2, 4,         //%5 = OpTypePointer Uniform %4
+            Op(4, 59), 5, 6, 2,         //%6 = OpVariable %5 Uniform
+        }) },
+        { "spec constant type out of bounds", MakeModule(3, {
+            Op(4, 71), 1, 1, 0,         //OpDecorate %1 SpecId 0
+            Op(4, 50), 100, 1, 7,       //%1 = OpSpecConstant %100 7
+        }) },
+    };
+    for (auto& module : malformed) {
+        std::vector<Veldrid::ShaderResource> resources;
+        bool declined = !Veldrid::SPIRVReflection::reflect_shader_resources_lean(
+            module.spirv.data(), module.spirv.size(), resources, variant);
+        std::cout << (declined ? "PASS " : "FAIL ") << "declines " << module.name << "\n";
+        if (!declined) failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
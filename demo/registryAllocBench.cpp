@@ -0,0 +1,73 @@
+#include <veldrid/Buffer.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "app/Bench.hpp"
+
+//Every heap allocation of the process goes through here
+static std::atomic<std::uint64_t> allocCount{ 0 };
+
+void* operator new(std::size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    if (auto* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+//Resource usages recorded into a command list are tracked by
+//_DevResRegistry. Once a list reached its steady state capacity,
+//recording the same amount of usages must not allocate anymore.
+class RegistryAllocBench : public BenchApp {
+
+    static constexpr unsigned kBufferCount = 64;
+    static constexpr unsigned kUsesPerList = 100000;
+    static constexpr unsigned kRecordings = 5;
+
+    void RunBench() override {
+        auto factory = dev->GetResourceFactory();
+
+        std::vector<Veldrid::sp<Veldrid::Buffer>> buffers;
+        for (unsigned i = 0; i < kBufferCount; i++) {
+            Veldrid::Buffer::Description desc{};
+            desc.sizeInBytes = 256;
+            desc.usage.uniformBuffer = 1;
+            buffers.push_back(factory->CreateBuffer(desc));
+        }
+
+        auto cmd = factory->CreateCommandList();
+        for (unsigned r = 0; r < kRecordings; r++) {
+            cmd->Begin();
+            auto allocsBefore = allocCount.load();
+            auto sec = MeasureSec(1, [&]() {
+                //Each copy registers a read and a write usage
+                for (unsigned i = 0; i < kUsesPerList / 2; i++) {
+                    cmd->CopyBuffer(
+                        buffers[i % kBufferCount], 0,
+                        buffers[(i + 1) % kBufferCount], 0,
+                        256);
+                }
+            });
+            auto allocs = allocCount.load() - allocsBefore;
+            cmd->End();
+            SubmitAndWait(cmd.get());
+
+            std::cout << "recording " << r
+                << ": " << allocs << " allocations"
+                << ", " << sec * 1e9 / kUsesPerList << " ns/use\n";
+        }
+    }
+
+public:
+    RegistryAllocBench() : BenchApp("Resource registry allocations") {}
+};
+
+int main() {
+    RegistryAllocBench app;
+    app.Run();
+}
@@ -0,0 +1,155 @@
+#include <veldrid/Buffer.hpp>
+#include <veldrid/Framebuffer.hpp>
+#include <veldrid/Pipeline.hpp>
+#include <veldrid/Shader.hpp>
+#include <veldrid/Texture.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "app/Bench.hpp"
+
+const std::string VertexCode = R"(
+#version 450
+
+void main()
+{
+    vec2 pos = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const std::string FragmentCode = R"(
+#version 450
+
+layout(location = 0) out vec4 fsout_Color;
+
+void main()
+{
+    fsout_Color = vec4(1.0, 0.5, 0.0, 1.0);
+}
+)";
+
+//A render pass is split into one secondary per thread, each recording
+//its share of the draws in parallel. Recording time should go down with
+//the thread count until the driver or the device serializes it.
+class SecondaryRecordBench : public BenchApp {
+
+    static constexpr unsigned kDrawsPerFrame = 20000;
+    static constexpr unsigned kFrames = 20;
+
+    Veldrid::sp<Veldrid::Framebuffer> fb;
+    Veldrid::sp<Veldrid::Pipeline> pipeline;
+
+    void CreateResources() {
+        auto factory = dev->GetResourceFactory();
+
+        Veldrid::Texture::Description texDesc{};
+        texDesc.width = 256;
+        texDesc.height = 256;
+        texDesc.depth = 1;
+        texDesc.mipLevels = 1;
+        texDesc.arrayLayers = 1;
+        texDesc.format = Veldrid::PixelFormat::R8_G8_B8_A8_UNorm;
+        texDesc.usage.renderTarget = 1;
+        texDesc.type = Veldrid::Texture::Description::Type::Texture2D;
+        texDesc.sampleCount = Veldrid::Texture::Description::SampleCount::x1;
+        auto colorTarget = factory->CreateTexture(texDesc);
+
+        Veldrid::Framebuffer::Description fbDesc{};
+        fbDesc.colorTargets = { { colorTarget, 0, 0 } };
+        fb = factory->CreateFramebuffer(fbDesc);
+
+        auto spvCompiler = Veldrid::IGLSLCompiler::Get();
+        std::string compileInfo;
+        std::vector<std::uint32_t> vertexSpv, fragSpv;
+        Veldrid::Shader::Description vertexShaderDesc{};
+        vertexShaderDesc.stage.vertex = 1;
+        vertexShaderDesc.entryPoint = "main";
+        Veldrid::Shader::Description fragmentShaderDesc{};
+        fragmentShaderDesc.stage.fragment = 1;
+        fragmentShaderDesc.entryPoint = "main";
+        if (!spvCompiler->CompileToSPIRV(vertexShaderDesc.stage, VertexCode, "main", {}, vertexSpv, compileInfo)
+            || !spvCompiler->CompileToSPIRV(fragmentShaderDesc.stage, FragmentCode, "main", {}, fragSpv, compileInfo)
+        ) {
+            std::cout << compileInfo << "\n";
+        }
+
+        Veldrid::GraphicsPipelineDescription pipelineDescription{};
+        pipelineDescription.blendState.attachments = { Veldrid::BlendStateDescription::Attachment::MakeOverrideBlend() };
+        pipelineDescription.depthStencilState.depthTestEnabled = false;
+        pipelineDescription.rasterizerState.cullMode = Veldrid::RasterizerStateDescription::FaceCullMode::None;
+        pipelineDescription.rasterizerState.fillMode = Veldrid::RasterizerStateDescription::PolygonFillMode::Solid;
+        pipelineDescription.rasterizerState.depthClipEnabled = true;
+        pipelineDescription.primitiveTopology = Veldrid::PrimitiveTopology::TriangleList;
+        pipelineDescription.shaderSet.shaders = {
+            factory->CreateShader(vertexShaderDesc, vertexSpv),
+            factory->CreateShader(fragmentShaderDesc, fragSpv)
+        };
+        pipelineDescription.outputs = fb->GetOutputDescription();
+        pipeline = factory->CreateGraphicsPipeline(pipelineDescription);
+    }
+
+    double RecordFrame(Veldrid::CommandList* cmd, unsigned threadCount) {
+        cmd->Begin();
+        cmd->BeginRenderPass(fb);
+        auto secondaries = cmd->ForkSecondaries(threadCount);
+        auto recordSec = MeasureSec(1, [&]() {
+            std::vector<std::thread> workers;
+            for (unsigned t = 0; t < threadCount; t++) {
+                workers.emplace_back([&, t]() {
+                    auto& sec = secondaries[t];
+                    auto drawCount = kDrawsPerFrame / threadCount
+                        + (t < kDrawsPerFrame % threadCount ? 1 : 0);
+                    sec->Begin();
+                    sec->SetPipeline(pipeline);
+                    sec->SetFullViewports();
+                    sec->SetFullScissorRects();
+                    for (unsigned i = 0; i < drawCount; i++) {
+                        sec->Draw(3);
+                    }
+                    sec->End();
+                });
+            }
+            for (auto& worker : workers) worker.join();
+        });
+        cmd->JoinSecondaries(secondaries);
+        cmd->EndRenderPass();
+        cmd->End();
+        SubmitAndWait(cmd);
+        return recordSec;
+    }
+
+    void RunBench() override {
+        CreateResources();
+
+        auto maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        auto cmd = dev->GetResourceFactory()->CreateCommandList();
+        for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+            //The first frame allocates the pools of the new threads
+            RecordFrame(cmd.get(), threadCount);
+
+            double recordSec = 0;
+            auto totalSec = MeasureSec(kFrames, [&]() {
+                recordSec += RecordFrame(cmd.get(), threadCount);
+            });
+            recordSec /= kFrames;
+
+            std::cout << threadCount << " thread(s)"
+                << ": record " << recordSec * 1e3 << " ms/frame"
+                << ", record+execute " << totalSec * 1e3 << " ms/frame\n";
+        }
+    }
+
+public:
+    SecondaryRecordBench() : BenchApp("Secondary command list recording") {}
+};
+
+int main() {
+    SecondaryRecordBench app;
+    app.Run();
+}
@@ -0,0 +1,75 @@
+#include <veldrid/Buffer.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "app/Bench.hpp"
+
+//Thousands of small uniform updates per frame, the way per-object data
+//is usually written. The baseline is the old workaround: a staging
+//buffer per update, filled through MapToCPU and copied with CopyBuffer.
+//It is compared with CommandList::UpdateBuffer, which records updates of
+//this size inline.
+class UpdateBufferBench : public BenchApp {
+
+    static constexpr unsigned kUpdatesPerFrame = 4096;
+    static constexpr unsigned kFrames = 20;
+
+    void RunBench() override {
+        auto factory = dev->GetResourceFactory();
+
+        for (std::uint32_t size : { 16u, 64u, 256u }) {
+            Veldrid::Buffer::Description desc{};
+            desc.sizeInBytes = size * kUpdatesPerFrame;
+            desc.usage.uniformBuffer = 1;
+            auto buffer = factory->CreateBuffer(desc);
+            std::vector<std::uint8_t> payload(size, 0x5a);
+
+            Veldrid::Buffer::Description stagingDesc{};
+            stagingDesc.sizeInBytes = size;
+            stagingDesc.usage.staging = 1;
+            std::vector<Veldrid::sp<Veldrid::Buffer>> stagingBuffers;
+            stagingBuffers.reserve(kUpdatesPerFrame);
+
+            auto cmd = factory->CreateCommandList();
+            for (bool baseline : { true, false }) {
+                double recordSec = 0;
+                auto frameSec = MeasureSec(kFrames, [&]() {
+                    recordSec += MeasureSec(1, [&]() {
+                        cmd->Begin();
+                        for (unsigned i = 0; i < kUpdatesPerFrame; i++) {
+                            if (baseline) {
+                                auto staging = factory->CreateBuffer(stagingDesc);
+                                std::memcpy(staging->MapToCPU(), payload.data(), size);
+                                staging->UnMap();
+                                cmd->CopyBuffer(staging, 0, buffer, i * size, size);
+                                stagingBuffers.push_back(std::move(staging));
+                            } else {
+                                cmd->UpdateBuffer(buffer, i * size, payload.data(), size);
+                            }
+                        }
+                        cmd->End();
+                    });
+                    SubmitAndWait(cmd.get());
+                    stagingBuffers.clear();
+                });
+                recordSec /= kFrames;
+
+                std::cout << (baseline ? "staging buffer + copy" : "UpdateBuffer         ")
+                    << " size " << size
+                    << ": record " << recordSec * 1e9 / kUpdatesPerFrame << " ns/update"
+                    << ", frame " << frameSec * 1e3 << " ms\n";
+            }
+        }
+    }
+
+public:
+    UpdateBufferBench() : BenchApp("UpdateBuffer: per-update staging buffer vs UpdateBuffer") {}
+};
+
+int main() {
+    UpdateBufferBench app;
+    app.Run();
+}
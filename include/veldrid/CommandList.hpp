@@ -17,14 +17,38 @@ namespace Veldrid
     
     class CommandList : public DeviceResource{
 
+    public:
+        struct Description {
+            // Recorded once and submitted any number of times, e.g. static
+            // geometry replayed every frame. Recorded commands are kept until
+            // the next Begin or Reset, which must wait until every submission
+            // of the list completed.
+            bool isReusable = false;
+        };
+
     protected:
-        CommandList(const sp<GraphicsDevice>& dev) : DeviceResource(dev){}
+        Description description;
+
+    protected:
+        CommandList(
+            const sp<GraphicsDevice>& dev,
+            const Description& desc = {}
+        ) : 
+            DeviceResource(dev),
+            description(desc)
+        {}
 
     public:
+        const Description& GetDesc() const { return description; }
 
         virtual void Begin() = 0;
         virtual void End() = 0;
 
+        // Drops recorded commands and references to used resources, memory is
+        // kept for the next recording. Begin does this implicitly.
+        // The list must not be pending on the GPU.
+        virtual void Reset() = 0;
+
         virtual void SetPipeline(const sp<Pipeline>&) = 0;
 
         // Sets the active <see cref="DeviceBuffer"/> for the given index.
@@ -39,7 +63,13 @@ namespace Veldrid
         virtual void SetIndexBuffer(
             const sp<Buffer>& buffer, IndexFormat format, std::uint32_t offset = 0) = 0;
 
-        
+        // Updates push constants of the bound <see cref="Pipeline"/>, visible to the following
+        // draws or dispatches. The written bytes must lie within the pipeline's push constant
+        // ranges, offset and size must be multiples of 4. Values are kept when binding another
+        // pipeline declaring the same ranges and resource layouts.
+        virtual void SetPushConstants(
+            std::uint32_t offset, std::uint32_t size, const void* data) = 0;
+
         // Sets the active <see cref="ResourceSet"/> for the given index. This ResourceSet is only active for the graphics
         // Pipeline.
         // <param name="slot">The resource slot.</param>
@@ -61,9 +91,27 @@ namespace Veldrid
             const sp<ResourceSet>& rs, 
             const std::vector<std::uint32_t>& dynamicOffsets) = 0;
 
+        // Creates a <see cref="ResourceSet"/> for sets rebuilt every frame. It is allocated
+        // linearly from pools owned by this list, with no per-set bookkeeping, and is not shared
+        // like those of <see cref="ResourceFactory::CreateResourceSet"/>. It may only be bound on
+        // this list and is invalid once the submission of the list completes, or after the next
+        // Begin or Reset if the list is not submitted. Reusable lists keep the pools until then.
+        virtual sp<ResourceSet> CreateTransientResourceSet(const ResourceSet::Description& desc) = 0;
+
         virtual void BeginRenderPass(const sp<Framebuffer>& fb) = 0;
         virtual void EndRenderPass() = 0;
 
+        // Creates secondary command lists continuing the render pass begun on this list.
+        // Each of them may be recorded (Begin ... End) on its own thread, JoinSecondaries
+        // then runs them in order at the current point of the render pass.
+        // Secondaries inherit no bound state, and those joined together must not
+        // depend on each other. They can't be submitted on their own.
+        // A command needing a barrier against an earlier command of the same secondary
+        // throws std::runtime_error and is not recorded, split such work across secondaries.
+        virtual std::vector<sp<CommandList>> ForkSecondaries(std::uint32_t count) = 0;
+        // Pipeline, resource sets and dynamic states have to be set again afterwards.
+        virtual void JoinSecondaries(const std::vector<sp<CommandList>>& secondaries) = 0;
+
         // Clears the color target at the given index of the active <see cref="Framebuffer"/>.
         // The index given must be less than the number of color attachments in the active <see cref="Framebuffer"/>.
         virtual void ClearColorTarget(
@@ -10,7 +10,9 @@ namespace Veldrid
 {
     class GraphicsDevice;
     
-    class DeviceResource : public RefCntBase{
+    //Weakly referenceable so device level caches don't keep
+    //resources alive
+    class DeviceResource : public WeakRefCnt{
         DISABLE_COPY_AND_ASSIGN(DeviceResource);
 
     public:
@@ -75,6 +75,17 @@ namespace Veldrid
             ResourceBindingModel resourceBindingModel;
             bool preferDepthRangeZeroToOne;
             bool preferStandardClipSpaceYDirection;
+            // File the pipeline cache is loaded from and saved to on destruction.
+            // Empty keeps it in memory only.
+            std::string pipelineCachePath;
+            // Pipeline cache contents to start from when pipelineCachePath
+            // has none, such as the blob of a <see cref="ShaderPack"/>. Only
+            // read while the device is created.
+            const void* pipelineCacheData;
+            std::size_t pipelineCacheDataSize;
+            // Write resource sets one element at a time even when the device supports
+            // descriptor update templates, to compare the two paths.
+            bool disableDescriptorUpdateTemplates;
         };
 
         enum class UVOrigin{ TopLeft, TopRight, BottomLeft, BottomRight };
@@ -27,6 +27,20 @@ namespace Veldrid
         std::uint64_t data;
     };
 
+    // A block of push constants, small values written directly into the command list
+    // without going through a resource set.
+    struct PushConstantRange{
+        // The shader stages that access the range.
+        Shader::Description::Stage stages;
+
+        // The offset in bytes, must be a multiple of 4.
+        std::uint32_t offset;
+
+        // The size in bytes, must be a multiple of 4. Implementations guarantee
+        // at least 128 bytes in total.
+        std::uint32_t size;
+    };
+
     struct GraphicsPipelineDescription{
 
         // A description of the blend state, which controls how color values are blended into each color target.
@@ -106,6 +120,9 @@ namespace Veldrid
         
         // An array of <see cref="ResourceLayout"/>, which controls the layout of shader resources in the <see cref="Pipeline"/>.
         std::vector<sp<ResourceLayout>> resourceLayouts;
+
+        // Push constant ranges available to the shaders, set with <see cref="CommandList.SetPushConstants"/>.
+        std::vector<PushConstantRange> pushConstantRanges;
         
         // A description of the output attachments used by the <see cref="Pipeline"/>.
         OutputDescription outputs;
@@ -125,6 +142,9 @@ namespace Veldrid
         
         // An array of <see cref="ResourceLayout"/>, which controls the layout of shader resoruces in the <see cref="Pipeline"/>.
         std::vector<sp<ResourceLayout>> resourceLayouts;
+
+        // Push constant ranges available to the shader, set with <see cref="CommandList.SetPushConstants"/>.
+        std::vector<PushConstantRange> pushConstantRanges;
         
         // The X dimension of the thread group size.
         std::uint32_t threadGroupSizeX;
@@ -13,6 +13,9 @@
 #include "veldrid/SyncObjects.hpp"
 #include "veldrid/SwapChain.hpp"
 
+#include <future>
+#include <vector>
+
 namespace Veldrid
 {
 
@@ -37,9 +40,19 @@ namespace Veldrid
 
         VLD_RF_FOR_EACH_RES(VLD_RF_CREATE_WITH_DESC)
 
+        // The SPIR-V is only read during the call, it may point into a mapped
+        // file such as a <see cref="ShaderPack"/>.
         virtual sp<Shader> CreateShader(
             const Shader::Description& description,
-            const std::vector<std::uint32_t>& spvBinary) = 0;
+            const std::uint32_t* spvBinary,
+            std::size_t wordCount) = 0;
+
+        sp<Shader> CreateShader(
+            const Shader::Description& description,
+            const std::vector<std::uint32_t>& spvBinary
+        ){
+            return CreateShader(description, spvBinary.data(), spvBinary.size());
+        }
 
         virtual sp<Pipeline> CreateGraphicsPipeline(
             const GraphicsPipelineDescription& description) = 0;
@@ -47,6 +60,23 @@ namespace Veldrid
         virtual sp<Pipeline> CreateComputePipeline(
             const ComputePipelineDescription& description) = 0;
 
+        // Compiles the <see cref="Pipeline"/> on a worker thread. The future is ready
+        // once the pipeline can be used, poll it with wait_for(0) to keep drawing
+        // with a fallback pipeline until then.
+        virtual std::future<sp<Pipeline>> CreateGraphicsPipelineAsync(
+            const GraphicsPipelineDescription& description) = 0;
+
+        virtual std::future<sp<Pipeline>> CreateComputePipelineAsync(
+            const ComputePipelineDescription& description) = 0;
+
+        // Creates all pipelines at once so the driver can compile them in parallel.
+        // The results are in the order of the descriptions.
+        virtual std::vector<sp<Pipeline>> CreateGraphicsPipelines(
+            const std::vector<GraphicsPipelineDescription>& descriptions) = 0;
+
+        virtual std::vector<sp<Pipeline>> CreateComputePipelines(
+            const std::vector<ComputePipelineDescription>& descriptions) = 0;
+
         virtual sp<Texture> WrapNativeTexture(
             void* nativeHandle,
             const Texture::Description& description) = 0;
@@ -69,7 +99,11 @@ namespace Veldrid
             const TextureView::Description& description) = 0;
 
        
-        virtual sp<CommandList> CreateCommandList() = 0;
+        sp<CommandList> CreateCommandList() {
+            return CreateCommandList(CommandList::Description{});
+        }
+        virtual sp<CommandList> CreateCommandList(
+            const CommandList::Description& description) = 0;
 
         virtual sp<Fence> CreateFence(bool initialSignaled) = 0;
         //Why don't call CreateSemaphore? because there is a WinBase #define 
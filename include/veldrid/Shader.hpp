@@ -3,7 +3,12 @@
 #include "veldrid/common/RefCnt.hpp"
 #include "veldrid/DeviceResource.hpp"
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -234,6 +239,22 @@ namespace Veldrid
     //	std::string source;
     //};
 
+    class IGLSLCompiler;
+
+    /**
+     * @brief One compilation of ShaderModule::MakeBatch
+     */
+    struct ShaderCompileJob
+    {
+    	Shader::Description::Stage stage;
+
+    	std::string glsl_source;
+
+    	std::string entry_point = "main";
+
+    	ShaderVariant variant;
+    };
+
     /**
      * @brief Contains shader code, with an entry point, for a specific shader stage.
      * It is needed by a PipelineLayout to create a Pipeline.
@@ -268,6 +289,16 @@ namespace Veldrid
     		return std::make_shared<ShaderModule>(stage, glsl_source, entry_point, shader_variant);
     	}
 
+    	/**
+    	 * @brief Compiles the jobs concurrently, every thread with its own compiler
+    	 * @param jobs The shaders to compile
+    	 * @param thread_count Number of threads including the caller, 0 for one per core
+    	 * @returns One module per job in the same order, failed ones are not IsValid()
+    	 */
+    	static std::vector<std::shared_ptr<ShaderModule>> MakeBatch(
+    		const std::vector<ShaderCompileJob> &jobs,
+    		unsigned thread_count = 0);
+
     	ShaderModule &operator=(ShaderModule &&) = delete;
 
     	bool IsValid() const {return _isValid;}
@@ -314,6 +345,13 @@ namespace Veldrid
     	void set_resource_mode(const std::string &resource_name, const ShaderResourceMode &resource_mode);
 
       private:
+    	ShaderModule(
+    	    Shader::Description::Stage stage,
+    		const std::string &   glsl_source,
+    		const std::string &   entry_point,
+    		const ShaderVariant & shader_variant,
+    		IGLSLCompiler &       glsl_compiler);
+
     	//std::shared_ptr<Device> device;
     	//VkShaderModule _mod;
     	bool _isValid;
@@ -339,6 +377,200 @@ namespace Veldrid
     };
 
 
+    /**
+     * @brief Content addressed cache of GLSL compilation results, shared by all
+     *        ShaderModules. A hit hands back the SPIR-V and reflected resources
+     *        without running glslang or SPIRV-Cross.
+     *
+     * Entries are keyed on everything the result depends on: the preprocessed
+     * source, stage, entry point, variant and compiler target environment.
+     * Entries live in memory and, once a directory is set, in one file per entry.
+     */
+    class ShaderCompileCache
+    {
+      public:
+    	struct Entry
+    	{
+    		std::vector<uint32_t> spirv;
+
+    		std::vector<ShaderResource> resources;
+    	};
+
+    	struct Stats
+    	{
+    		uint32_t hits;
+
+    		uint32_t disk_hits;
+
+    		uint32_t misses;
+    	};
+
+    	static ShaderCompileCache &get();
+
+    	/**
+    	 * @brief Builds the key of a compilation
+    	 * @param stage The shader stage
+    	 * @param final_source The GLSL source after precompilation
+    	 * @param entry_point The entrypoint function name of the shader stage
+    	 * @param variant The shader variant
+    	 */
+    	static std::string make_key(Shader::Description::Stage stage,
+    	                            const std::string &        final_source,
+    	                            const std::string &        entry_point,
+    	                            const ShaderVariant &      variant);
+
+    	/**
+    	 * @brief Persists entries to a directory, created if missing. Entries found there
+    	 *        are loaded on demand. An empty path keeps the cache in memory only.
+    	 */
+    	void set_directory(const std::string &directory);
+
+    	/**
+    	 * @brief Looks the key up in memory, then on disk
+    	 * @param[out] entry Filled on a hit
+    	 * @returns Whether the key was found
+    	 */
+    	bool lookup(const std::string &key, Entry &entry);
+
+    	void store(const std::string &key, const Entry &entry);
+
+    	/**
+    	 * @brief Drops the in-memory entries, files on disk are kept
+    	 */
+    	void clear();
+
+    	Stats get_stats() const;
+
+      private:
+    	ShaderCompileCache() = default;
+
+    	std::string entry_path(const std::string &key) const;
+
+    	std::unordered_map<std::string, Entry> entries;
+
+    	std::string directory;
+
+    	mutable std::mutex m_entries;
+
+    	std::atomic<uint32_t> hits{0}, disk_hits{0}, misses{0};
+    };
+
+
+    /**
+     * @brief Lazily compiled permutations of one shader over a set of feature keywords.
+     *
+     * A permutation is a mask with bit i set when keywords[i] is defined. It is
+     * compiled on first request, on the calling thread or in the background,
+     * and kept afterwards. Permutations compiling to the same SPIR-V share one Shader.
+     */
+    class ShaderPermutations
+    {
+    	DISABLE_COPY_AND_ASSIGN(ShaderPermutations);
+
+      public:
+    	using Mask = uint64_t;
+
+    	struct Stats
+    	{
+    		/// Permutations requested at least once
+    		uint32_t requested;
+
+    		/// Shaders created, fewer than requested when permutations share SPIR-V
+    		uint32_t created;
+
+    		uint32_t failed;
+    	};
+
+    	/**
+    	 * @param device The device creating the shaders
+    	 * @param stage The shader stage
+    	 * @param glsl_source The GLSL source, keywords are tested with #ifdef
+    	 * @param keywords The feature keywords, at most 64
+    	 * @param entry_point The entrypoint function name of the shader stage
+    	 */
+    	ShaderPermutations(const sp<GraphicsDevice> &  device,
+    	                   Shader::Description::Stage  stage,
+    	                   const std::string &         glsl_source,
+    	                   std::vector<std::string>    keywords,
+    	                   const std::string &         entry_point = "main");
+
+    	/**
+    	 * @brief Waits for the background compilations still running
+    	 */
+    	~ShaderPermutations();
+
+    	/**
+    	 * @brief Builds the mask of a permutation, unknown keywords are ignored
+    	 */
+    	Mask get_mask(const std::vector<std::string> &enabled_keywords) const;
+
+    	/**
+    	 * @brief Returns the shader of a permutation, compiling it now on first request
+    	 * @returns Null if the permutation failed to compile, see get_info_log()
+    	 */
+    	sp<Shader> get(Mask mask);
+
+    	/**
+    	 * @brief Returns the shader of a permutation, compiling it on a background
+    	 *        thread on first request. Poll with wait_for(0) to keep using another
+    	 *        shader until it is ready.
+    	 */
+    	std::shared_future<sp<Shader>> get_async(Mask mask);
+
+    	/**
+    	 * @brief The compilation log of a permutation that finished compiling
+    	 */
+    	std::string get_info_log(Mask mask) const;
+
+    	const std::vector<std::string> &get_keywords() const
+    	{
+    		return keywords;
+    	}
+
+    	Stats get_stats() const;
+
+      private:
+    	struct Permutation
+    	{
+    		std::shared_future<sp<Shader>> shader;
+
+    		std::string info_log;
+    	};
+
+    	struct UniqueShader
+    	{
+    		std::vector<uint32_t> spirv;
+
+    		sp<Shader> shader;
+    	};
+
+    	/// Looks the permutation up, the returned task must be run if not null
+    	std::shared_future<sp<Shader>> request(Mask mask, std::function<void()> &task);
+
+    	sp<Shader> compile(Mask mask);
+
+    	sp<GraphicsDevice> device;
+
+    	Shader::Description::Stage stage;
+
+    	std::string glsl_source;
+
+    	std::vector<std::string> keywords;
+
+    	std::string entry_point;
+
+    	std::unordered_map<Mask, Permutation> permutations;
+
+    	/// Created shaders by hash of their SPIR-V
+    	std::unordered_multimap<size_t, UniqueShader> unique_shaders;
+
+    	mutable std::mutex m_permutations;
+
+    	std::vector<std::future<void>> background_tasks;
+
+    	uint32_t created = 0, failed = 0;
+    };
+
     /// Helper class to generate SPIRV code from GLSL source
     /// A very simple version of the glslValidator application
     class IGLSLCompiler : public RefCntBase{
@@ -380,6 +612,24 @@ namespace Veldrid
     class SPIRVReflection
     {
       public:
+    	/// How reflect_shader_resources reads the SPIRV code
+    	enum class Mode
+    	{
+    		/// Single pass scanner, SPIRV-Cross for modules it does not handle
+    		Lean,
+    		/// Always a full spirv_cross::Compiler
+    		SPIRVCross,
+    		/// Both, the SPIRV-Cross result is used and disagreements are counted
+    		Validate
+    	};
+
+    	static void set_mode(Mode mode);
+
+    	static Mode get_mode();
+
+    	/// @brief Number of modules the two readers disagreed on in Validate mode
+    	static uint32_t get_validation_mismatches();
+
     	/// @brief Reflects shader resources from SPIRV code
     	/// @param stage The Vulkan shader stage flag
     	/// @param spirv The SPIRV code of shader
@@ -389,6 +639,30 @@ namespace Veldrid
     	                              std::vector<ShaderResource> &resources,
     	                              const ShaderVariant &        variant);
 
+    	/// @brief Same records as the SPIRV-Cross path from one pass over the declarations
+    	/// @returns False, leaving resources untouched, if the module uses constructs the scanner does not handle
+    	static bool reflect_shader_resources_lean(const uint32_t *             spirv,
+    	                                          size_t                       word_count,
+    	                                          std::vector<ShaderResource> &resources,
+    	                                          const ShaderVariant &        variant);
+
+    	/// @brief Reflects through a full spirv_cross::Compiler
+    	static bool reflect_shader_resources_spirv_cross(const std::vector<uint32_t> &spirv,
+    	                                                 std::vector<ShaderResource> &resources,
+    	                                                 const ShaderVariant &        variant);
+
+    	/// @brief Whether two records are identical, as compared in Validate mode
+    	static bool is_same_resource(const ShaderResource &a, const ShaderResource &b);
+
+    	/// @brief Appends the resources to out, in the layout used by the compile cache
+    	static void serialize_resources(const std::vector<ShaderResource> &resources, std::string &out);
+
+    	/// @brief Reads resources written by serialize_resources
+    	/// @returns False unless the size bytes at data hold exactly one serialized list
+    	static bool deserialize_resources(const char *                 data,
+    	                                  size_t                       size,
+    	                                  std::vector<ShaderResource> &resources);
+
       private:
     	//void parse_shader_resources(const spirv_cross::Compiler &compiler,
     	//                            VkShaderStageFlagBits        stage,
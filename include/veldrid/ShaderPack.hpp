@@ -0,0 +1,130 @@
+#pragma once
+
+#include "veldrid/common/RefCnt.hpp"
+#include "veldrid/common/Macros.h"
+#include "veldrid/Shader.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Veldrid
+{
+    class ResourceFactory;
+
+    // A read-only archive of SPIR-V modules with their reflection, an optional
+    // pipeline cache blob and named application blobs (pipeline descriptions,
+    // ...). The file is memory mapped and only its index is read on open,
+    // entries point straight into the mapping.
+    class ShaderPack : public RefCntBase
+    {
+        DISABLE_COPY_AND_ASSIGN(ShaderPack);
+
+    public:
+        struct ShaderEntry{
+            std::string_view name;
+            Shader::Description::Stage stage;
+            std::string_view entryPoint;
+
+            // Points into the mapping, valid while the pack is alive
+            const std::uint32_t* spirv;
+            std::size_t wordCount;
+
+            // Resources serialized by SPIRVReflection::serialize_resources
+            const char* reflection;
+            std::size_t reflectionSize;
+        };
+
+        struct BlobEntry{
+            std::string_view name;
+            const void* data;
+            std::size_t size;
+        };
+
+    private:
+        const std::uint8_t* _data = nullptr;
+        std::size_t _size = 0;
+        #ifdef _WIN32
+        void* _file = nullptr;
+        void* _mapping = nullptr;
+        #endif
+
+        std::vector<ShaderEntry> _shaders;
+        std::vector<BlobEntry> _blobs;
+        std::unordered_map<std::string_view, std::size_t> _shaderIndex;
+        std::unordered_map<std::string_view, std::size_t> _blobIndex;
+        BlobEntry _pipelineCache{};
+
+        ShaderPack() = default;
+
+        bool _Map(const std::string& path, std::string& error);
+        bool _ReadIndex(std::string& error);
+
+    public:
+        ~ShaderPack();
+
+        // Returns null with a message in error if the file is missing or
+        // not a valid pack.
+        static sp<ShaderPack> Open(const std::string& path, std::string& error);
+
+        const std::vector<ShaderEntry>& GetShaders() const { return _shaders; }
+        const std::vector<BlobEntry>& GetBlobs() const { return _blobs; }
+
+        // Null if the pack has no entry of that name
+        const ShaderEntry* FindShader(std::string_view name) const;
+        const BlobEntry* FindBlob(std::string_view name) const;
+
+        // Empty if the pack was written without one. Pass it to
+        // <see cref="GraphicsDevice::Options"/> as pipelineCacheData.
+        const BlobEntry& GetPipelineCache() const { return _pipelineCache; }
+
+        // Decodes the reflection of a shader, the only entry data parsed
+        bool GetResources(const ShaderEntry& shader, std::vector<ShaderResource>& resources) const;
+
+        // Creates the shader from the mapped SPIR-V without copying it. The
+        // shader does not reference the pack once created.
+        sp<Shader> CreateShader(
+            ResourceFactory& factory,
+            const ShaderEntry& shader,
+            bool enableDebug = false) const;
+    };
+
+    // Builds the file read by <see cref="ShaderPack"/>, usually offline.
+    class ShaderPackWriter
+    {
+        struct _Entry{
+            std::uint32_t kind;
+            std::uint32_t stage;
+            std::string name;
+            std::string entryPoint;
+            std::string data;
+            std::string reflection;
+        };
+
+        std::vector<_Entry> _entries;
+
+    public:
+        void AddShader(
+            const std::string& name,
+            Shader::Description::Stage stage,
+            const std::string& entryPoint,
+            const std::vector<std::uint32_t>& spirv,
+            const std::vector<ShaderResource>& resources);
+
+        // Stores the SPIR-V and reflection of a compiled module
+        void AddShader(const std::string& name, const ShaderModule& module);
+
+        void AddBlob(const std::string& name, const void* data, std::size_t size);
+
+        // Typically the pipeline cache saved by a device that created the
+        // pipelines of the shaders in the pack.
+        void SetPipelineCache(const void* data, std::size_t size);
+
+        // Writes through a temporary file renamed over path. Returns false
+        // with a message in error on failure.
+        bool Write(const std::string& path, std::string& error) const;
+    };
+
+} // namespace Veldrid
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "veldrid/common/RefCnt.hpp"
+#include "veldrid/Shader.hpp"
+#include "veldrid/BindableResource.hpp"
+#include "veldrid/Pipeline.hpp"
+
+#include <string>
+#include <vector>
+
+namespace Veldrid
+{
+    class ResourceFactory;
+
+    // The resource and push constant layouts a set of shaders expects, as
+    // found by reflection. resourceLayouts[i] describes set i, its elements
+    // are ordered by binding.
+    struct ReflectedPipelineLayout{
+        std::vector<ResourceLayout::Description> resourceLayouts;
+        std::vector<PushConstantRange> pushConstantRanges;
+    };
+
+    // Merges the reflected resources of all the modules of a pipeline. A
+    // resource used by several stages gets the union of their stages,
+    // resources marked ShaderResourceMode::Dynamic get a dynamic binding.
+    // Fails with a message in error when the shaders declare the same
+    // binding differently, use arrays or combined image samplers, or leave
+    // holes in the bindings of a set, none of which a <see cref="ResourceLayout"/>
+    // can express.
+    bool ReflectPipelineLayout(
+        const std::vector<const ShaderModule*>& modules,
+        ReflectedPipelineLayout& layout,
+        std::string& error);
+
+    // One layout per set of a reflected pipeline layout. Identical layouts
+    // are shared by the backends that deduplicate them.
+    std::vector<sp<ResourceLayout>> CreateResourceLayouts(
+        ResourceFactory& factory,
+        const ReflectedPipelineLayout& layout);
+
+} // namespace Veldrid
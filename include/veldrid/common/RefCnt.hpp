@@ -114,6 +114,93 @@ private:
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/** \class WeakRefCnt
+
+    WeakRefCnt is the base class for objects that may be observed without
+    being owned, e.g. by a cache. When the last strong reference is released
+    weak_dispose() is called, the memory is freed once the last weak
+    reference is released too. All strong references together hold one
+    weak reference.
+
+    try_ref() turns a weak reference into a strong one if the object is
+    still alive.
+*/
+class VLD_API WeakRefCnt : public RefCntBase {
+public:
+    WeakRefCnt() : RefCntBase(), fWeakCnt(1) {}
+
+    ~WeakRefCnt() override {
+    #ifdef VLD_DEBUG
+        assert(this->getWeakCnt() == 1);
+        fWeakCnt.store(0, std::memory_order_relaxed);
+    #endif
+    }
+
+    /** Acquire a strong reference if the object has not been disposed yet.
+        Must be balanced by a call to unref() on success.
+    */
+    bool try_ref() const {
+        int32_t prev = fRefCnt.load(std::memory_order_relaxed);
+        do {
+            if (0 == prev) {
+                return false;
+            }
+        } while (!fRefCnt.compare_exchange_weak(
+            prev, prev + 1, std::memory_order_acquire, std::memory_order_relaxed));
+        return true;
+    }
+
+    /** Increment the weak count. Must be balanced by a call to weak_unref().
+        The caller must hold a strong or a weak reference.
+    */
+    void weak_ref() const {
+        assert(this->getWeakCnt() > 0);
+        // No barrier required.
+        (void)fWeakCnt.fetch_add(+1, std::memory_order_relaxed);
+    }
+
+    /** Decrement the weak count. Frees the object once it reaches 0.
+    */
+    void weak_unref() const {
+        assert(this->getWeakCnt() > 0);
+        if (1 == fWeakCnt.fetch_add(-1, std::memory_order_acq_rel)) {
+        #ifdef VLD_DEBUG
+            // so our destructor won't complain
+            fWeakCnt.store(1, std::memory_order_relaxed);
+        #endif
+            this->RefCntBase::internal_dispose();
+        }
+    }
+
+    /** True once the last strong reference was released.
+    */
+    bool weak_expired() const {
+        return fRefCnt.load(std::memory_order_relaxed) == 0;
+    }
+
+protected:
+    /** Called when the strong count goes to 0, release what observers
+        must not reach anymore. The object is still fully constructed.
+    */
+    virtual void weak_dispose() const {}
+
+private:
+#ifdef VLD_DEBUG
+    int32_t getWeakCnt() const {
+        return fWeakCnt.load(std::memory_order_relaxed);
+    }
+#endif
+
+    void internal_dispose() const override {
+        this->weak_dispose();
+        this->weak_unref();
+    }
+
+    mutable std::atomic<int32_t> fWeakCnt;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
 /** Call obj->ref() and return obj. The obj must not be nullptr.
  */
 template <typename T> static inline T* Ref(T* obj) {
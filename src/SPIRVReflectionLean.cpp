@@ -0,0 +1,1010 @@
+#include "veldrid/Shader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+namespace Veldrid
+{
+namespace
+{
+enum DecorationBits : uint32_t
+{
+	HasBlock        = 1 << 0,
+	HasBufferBlock  = 1 << 1,
+	HasBuiltIn      = 1 << 2,
+	HasNonWritable  = 1 << 3,
+	HasNonReadable  = 1 << 4,
+	HasRowMajor     = 1 << 5,
+	HasColMajor     = 1 << 6,
+	HasOffset       = 1 << 7,
+	HasMatrixStride = 1 << 8,
+	HasArrayStride  = 1 << 9,
+	HasSpecId       = 1 << 10,
+};
+
+/// Type, constant or variable declared by the module
+struct SpvId
+{
+	spv::Op op = spv::OpNop;
+
+	/// Result type of constants and variables, component, element or pointee type of types
+	uint32_t type = 0;
+
+	/// Int and float width, vector and matrix count, array length id, pointer and variable storage class
+	uint32_t operand = 0;
+
+	uint32_t image_dim = 0;
+
+	uint32_t image_sampled = 0;
+
+	/// Low word of scalar constants
+	uint32_t value = 0;
+
+	/// Struct members, indexing SpvModule::members
+	uint32_t first_member = 0;
+
+	uint32_t member_count = 0;
+
+	const uint32_t *member_types = nullptr;
+
+	uint32_t decorations = 0;
+
+	uint32_t set = 0, binding = 0, location = 0, input_attachment_index = 0, spec_id = 0, array_stride = 0;
+
+	std::string_view name;
+};
+
+struct SpvMember
+{
+	uint32_t decorations = 0;
+
+	uint32_t offset = 0;
+
+	uint32_t matrix_stride = 0;
+};
+
+struct SpvMemberDecoration
+{
+	uint32_t struct_id, member, decoration, value;
+};
+
+/// Index of the declarations of a module, built in one pass that stops at the first function
+class SpvModule
+{
+  public:
+	bool parse(const uint32_t *words, size_t word_count);
+
+	const SpvId &get(uint32_t id) const
+	{
+		return ids[id];
+	}
+
+	const SpvMember &member(const SpvId &type, uint32_t index) const
+	{
+		return members[type.first_member + index];
+	}
+
+	/// Strips the pointer and arrays of a variable's type
+	uint32_t base_type(uint32_t type_id) const;
+
+	/// The innermost array dimension, like SPIRType::array[0]. Spec constant lengths give the constant id.
+	uint32_t innermost_array_size(uint32_t type_id) const;
+
+	bool is_builtin(const SpvId &var) const;
+
+	bool in_entry_point_interface(uint32_t var_id) const;
+
+	/// Flags set on the variable or on every member of its block
+	uint32_t buffer_block_flags(const SpvId &var) const;
+
+	std::string block_name(uint32_t var_id) const;
+
+	/// Whether storage buffers are reported by instance name, HLSL reuses block types
+	bool ssbo_instance_name_is_significant() const;
+
+	bool declared_struct_size(const SpvId &type, size_t &size) const;
+
+	bool declared_struct_size_runtime_array(const SpvId &type, size_t array_size, size_t &size) const;
+
+	bool declared_member_size(const SpvId &type, uint32_t index, size_t &size) const;
+
+	std::vector<uint32_t> variables;
+
+	std::vector<uint32_t> spec_constants;
+
+  private:
+	bool evaluate_u32(uint32_t id, uint32_t &value) const;
+
+	void decorate(SpvId &id, uint32_t decoration, uint32_t value);
+
+	std::vector<SpvId> ids;
+
+	std::vector<SpvMember> members;
+
+	uint32_t version = 0;
+
+	bool source_known = false;
+
+	bool source_hlsl = false;
+
+	uint32_t entry_point_count = 0;
+
+	const uint32_t *interface_ids = nullptr;
+
+	size_t interface_count = 0;
+};
+
+std::string_view read_string(const uint32_t *operands, size_t operand_count, size_t &string_words)
+{
+	auto *chars  = reinterpret_cast<const char *>(operands);
+	auto  length = strnlen(chars, operand_count * sizeof(uint32_t));
+	string_words = length / sizeof(uint32_t) + 1;
+	return {chars, length};
+}
+
+void SpvModule::decorate(SpvId &id, uint32_t decoration, uint32_t value)
+{
+	switch (decoration)
+	{
+		case spv::DecorationBlock: id.decorations |= HasBlock; break;
+		case spv::DecorationBufferBlock: id.decorations |= HasBufferBlock; break;
+		case spv::DecorationBuiltIn: id.decorations |= HasBuiltIn; break;
+		case spv::DecorationNonWritable: id.decorations |= HasNonWritable; break;
+		case spv::DecorationNonReadable: id.decorations |= HasNonReadable; break;
+		case spv::DecorationArrayStride:
+			id.decorations |= HasArrayStride;
+			id.array_stride = value;
+			break;
+		case spv::DecorationSpecId:
+			id.decorations |= HasSpecId;
+			id.spec_id = value;
+			break;
+		case spv::DecorationDescriptorSet: id.set = value; break;
+		case spv::DecorationBinding: id.binding = value; break;
+		case spv::DecorationLocation: id.location = value; break;
+		case spv::DecorationInputAttachmentIndex: id.input_attachment_index = value; break;
+		default: break;
+	}
+}
+
+bool SpvModule::parse(const uint32_t *words, size_t word_count)
+{
+	// Byte swapped modules are left to SPIRV-Cross
+	if (word_count < 5 || words[0] != spv::MagicNumber)
+	{
+		return false;
+	}
+	version = words[1];
+	ids.resize(words[3]);
+
+	std::vector<SpvMemberDecoration> member_decorations;
+
+	auto valid = [&](uint32_t id) { return id < ids.size(); };
+	// Results are declared once and types only refer to types declared before them, which rules
+	// out cycles in the type graph. Only pointers may be forward declared.
+	auto declared = [&](uint32_t id) { return valid(id) && ids[id].op != spv::OpNop; };
+	auto fresh    = [&](uint32_t id) { return valid(id) && ids[id].op == spv::OpNop; };
+
+	for (size_t offset = 5; offset < word_count;)
+	{
+		auto op_count = words[offset] >> spv::WordCountShift;
+		auto opcode   = static_cast<spv::Op>(words[offset] & spv::OpCodeMask);
+		if (op_count == 0 || word_count - offset < op_count)
+		{
+			return false;
+		}
+		auto *ops   = words + offset + 1;
+		auto  count = size_t(op_count - 1);
+		offset += op_count;
+
+		// Declarations all precede the first function
+		if (opcode == spv::OpFunction)
+		{
+			break;
+		}
+
+		switch (opcode)
+		{
+			case spv::OpSource:
+				if (count < 1)
+				{
+					return false;
+				}
+				source_known = ops[0] == spv::SourceLanguageESSL || ops[0] == spv::SourceLanguageGLSL ||
+				               ops[0] == spv::SourceLanguageHLSL;
+				source_hlsl  = ops[0] == spv::SourceLanguageHLSL;
+				break;
+			case spv::OpEntryPoint:
+			{
+				if (count < 3)
+				{
+					return false;
+				}
+				// SPIRV-Cross reflects the first entry point
+				if (entry_point_count++ == 0)
+				{
+					size_t string_words;
+					read_string(ops + 2, count - 2, string_words);
+					interface_ids   = ops + 2 + string_words;
+					interface_count = count > 2 + string_words ? count - 2 - string_words : 0;
+				}
+				break;
+			}
+			case spv::OpName:
+			{
+				if (count < 2 || !valid(ops[0]))
+				{
+					return false;
+				}
+				size_t string_words;
+				ids[ops[0]].name = read_string(ops + 1, count - 1, string_words);
+				break;
+			}
+			case spv::OpDecorate:
+			{
+				if (count < 2 || !valid(ops[0]))
+				{
+					return false;
+				}
+				decorate(ids[ops[0]], ops[1], count > 2 ? ops[2] : 0);
+				break;
+			}
+			case spv::OpMemberDecorate:
+			{
+				if (count < 3 || !valid(ops[0]))
+				{
+					return false;
+				}
+				member_decorations.push_back({ops[0], ops[1], ops[2], count > 3 ? ops[3] : 0});
+				break;
+			}
+			case spv::OpDecorationGroup:
+			case spv::OpGroupDecorate:
+			case spv::OpGroupMemberDecorate:
+				return false;
+			case spv::OpTypeVoid:
+			case spv::OpTypeBool:
+			case spv::OpTypeSampler:
+				if (count < 1 || !fresh(ops[0]))
+				{
+					return false;
+				}
+				ids[ops[0]].op = opcode;
+				break;
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+				if (count < 2 || !fresh(ops[0]))
+				{
+					return false;
+				}
+				ids[ops[0]].op      = opcode;
+				ids[ops[0]].operand = ops[1];
+				break;
+			case spv::OpTypeSampledImage:
+			case spv::OpTypeRuntimeArray:
+				if (count < 2 || !fresh(ops[0]) || !declared(ops[1]))
+				{
+					return false;
+				}
+				ids[ops[0]].op   = opcode;
+				ids[ops[0]].type = ops[1];
+				break;
+			case spv::OpTypeVector:
+			case spv::OpTypeMatrix:
+			case spv::OpTypeArray:
+				if (count < 3 || !fresh(ops[0]) || !declared(ops[1]) || (opcode == spv::OpTypeArray && !declared(ops[2])))
+				{
+					return false;
+				}
+				ids[ops[0]].op      = opcode;
+				ids[ops[0]].type    = ops[1];
+				ids[ops[0]].operand = ops[2];
+				break;
+			case spv::OpTypeForwardPointer:
+				if (count < 2 || !fresh(ops[0]))
+				{
+					return false;
+				}
+				// Completed by its OpTypePointer, the pointee stays unknown until then
+				ids[ops[0]].op      = spv::OpTypePointer;
+				ids[ops[0]].operand = ops[1];
+				break;
+			case spv::OpTypePointer:
+			{
+				if (count < 3 || !valid(ops[0]) || !declared(ops[2]))
+				{
+					return false;
+				}
+				bool forward = ids[ops[0]].op == spv::OpTypePointer && ids[ops[0]].type == 0;
+				if (!fresh(ops[0]) && !forward)
+				{
+					return false;
+				}
+				ids[ops[0]].op      = opcode;
+				ids[ops[0]].operand = ops[1];
+				ids[ops[0]].type    = ops[2];
+				break;
+			}
+			case spv::OpTypeImage:
+			{
+				if (count < 8 || !fresh(ops[0]) || !declared(ops[1]))
+				{
+					return false;
+				}
+				auto &image         = ids[ops[0]];
+				image.op            = opcode;
+				image.type          = ops[1];
+				image.image_dim     = ops[2];
+				image.image_sampled = ops[6];
+				break;
+			}
+			case spv::OpTypeStruct:
+			{
+				if (count < 1 || !fresh(ops[0]) || !std::all_of(ops + 1, ops + count, declared))
+				{
+					return false;
+				}
+				auto &type        = ids[ops[0]];
+				type.op           = opcode;
+				type.member_types = ops + 1;
+				type.member_count = uint32_t(count - 1);
+				type.first_member = uint32_t(members.size());
+				members.resize(members.size() + type.member_count);
+				break;
+			}
+			case spv::OpConstant:
+			case spv::OpSpecConstant:
+			case spv::OpConstantTrue:
+			case spv::OpConstantFalse:
+			case spv::OpSpecConstantTrue:
+			case spv::OpSpecConstantFalse:
+			case spv::OpConstantNull:
+			case spv::OpConstantComposite:
+			case spv::OpSpecConstantComposite:
+			case spv::OpSpecConstantOp:
+			{
+				if (count < 2 || !declared(ops[0]) || !fresh(ops[1]))
+				{
+					return false;
+				}
+				auto &constant = ids[ops[1]];
+				constant.op    = opcode;
+				constant.type  = ops[0];
+				if (opcode == spv::OpConstant || opcode == spv::OpSpecConstant)
+				{
+					constant.value = count > 2 ? ops[2] : 0;
+				}
+				else if (opcode == spv::OpConstantTrue || opcode == spv::OpSpecConstantTrue)
+				{
+					constant.value = 1;
+				}
+				if (opcode == spv::OpSpecConstant || opcode == spv::OpSpecConstantTrue ||
+				    opcode == spv::OpSpecConstantFalse)
+				{
+					spec_constants.push_back(ops[1]);
+				}
+				break;
+			}
+			case spv::OpVariable:
+			{
+				if (count < 3 || !fresh(ops[1]))
+				{
+					return false;
+				}
+				auto &var   = ids[ops[1]];
+				var.op      = opcode;
+				var.type    = ops[0];
+				var.operand = ops[2];
+				variables.push_back(ops[1]);
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	// Member decorations precede the structs they apply to
+	for (auto &dec : member_decorations)
+	{
+		auto &type = ids[dec.struct_id];
+		if (type.op != spv::OpTypeStruct || dec.member >= type.member_count)
+		{
+			continue;
+		}
+		auto &member = members[type.first_member + dec.member];
+		switch (dec.decoration)
+		{
+			case spv::DecorationBuiltIn: member.decorations |= HasBuiltIn; break;
+			case spv::DecorationNonWritable: member.decorations |= HasNonWritable; break;
+			case spv::DecorationNonReadable: member.decorations |= HasNonReadable; break;
+			case spv::DecorationRowMajor: member.decorations |= HasRowMajor; break;
+			case spv::DecorationColMajor: member.decorations |= HasColMajor; break;
+			case spv::DecorationOffset:
+				member.decorations |= HasOffset;
+				member.offset = dec.value;
+				break;
+			case spv::DecorationMatrixStride:
+				member.decorations |= HasMatrixStride;
+				member.matrix_stride = dec.value;
+				break;
+			default: break;
+		}
+	}
+
+	// Every type referenced by a variable must be declared
+	for (auto var_id : variables)
+	{
+		auto &var = ids[var_id];
+		if (!valid(var.type) || ids[var.type].op != spv::OpTypePointer)
+		{
+			return false;
+		}
+		for (auto type = ids[var.type].type;; type = ids[type].type)
+		{
+			if (!valid(type) || ids[type].op == spv::OpNop)
+			{
+				return false;
+			}
+			if (ids[type].op != spv::OpTypeArray && ids[type].op != spv::OpTypeRuntimeArray)
+			{
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+uint32_t SpvModule::base_type(uint32_t type_id) const
+{
+	type_id = ids[type_id].type;
+	while (ids[type_id].op == spv::OpTypeArray || ids[type_id].op == spv::OpTypeRuntimeArray)
+	{
+		type_id = ids[type_id].type;
+	}
+	return type_id;
+}
+
+uint32_t SpvModule::innermost_array_size(uint32_t type_id) const
+{
+	uint32_t size = 1;
+	for (type_id = ids[type_id].type;; type_id = ids[type_id].type)
+	{
+		auto &type = ids[type_id];
+		if (type.op == spv::OpTypeRuntimeArray)
+		{
+			size = 0;
+		}
+		else if (type.op == spv::OpTypeArray)
+		{
+			auto &length = ids[type.operand];
+			size         = length.op == spv::OpConstant ? length.value : type.operand;
+		}
+		else
+		{
+			return size;
+		}
+	}
+}
+
+bool SpvModule::is_builtin(const SpvId &var) const
+{
+	if (var.decorations & HasBuiltIn)
+	{
+		return true;
+	}
+	// A block with a builtin member is a builtin block
+	auto &type = ids[base_type(var.type)];
+	for (uint32_t i = 0; type.op == spv::OpTypeStruct && i < type.member_count; i++)
+	{
+		if (member(type, i).decorations & HasBuiltIn)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SpvModule::in_entry_point_interface(uint32_t var_id) const
+{
+	auto storage = ids[var_id].operand;
+	if (version < 0x10400)
+	{
+		// Before SPIR-V 1.4 only stage IO is listed, single entry point modules use everything
+		if (storage != spv::StorageClassInput && storage != spv::StorageClassOutput)
+		{
+			return true;
+		}
+		if (entry_point_count <= 1)
+		{
+			return true;
+		}
+	}
+	return std::find(interface_ids, interface_ids + interface_count, var_id) != interface_ids + interface_count;
+}
+
+bool SpvModule::ssbo_instance_name_is_significant() const
+{
+	if (source_known)
+	{
+		return source_hlsl;
+	}
+
+	// Without OpSource, aliased block types hint at HLSL style declarations
+	std::vector<uint32_t> block_types;
+	for (auto var_id : variables)
+	{
+		auto &var     = ids[var_id];
+		auto  type_id = base_type(var.type);
+		if (var.operand == spv::StorageClassStorageBuffer ||
+		    (var.operand == spv::StorageClassUniform && (ids[type_id].decorations & HasBufferBlock)))
+		{
+			if (std::find(block_types.begin(), block_types.end(), type_id) != block_types.end())
+			{
+				return true;
+			}
+			block_types.push_back(type_id);
+		}
+	}
+	return false;
+}
+
+uint32_t SpvModule::buffer_block_flags(const SpvId &var) const
+{
+	auto  flags = var.decorations;
+	auto &type  = ids[base_type(var.type)];
+	if (type.op != spv::OpTypeStruct || type.member_count == 0)
+	{
+		return flags;
+	}
+	auto all_members = member(type, 0).decorations;
+	for (uint32_t i = 1; i < type.member_count; i++)
+	{
+		all_members &= member(type, i).decorations;
+	}
+	return flags | all_members;
+}
+
+std::string SpvModule::block_name(uint32_t var_id) const
+{
+	auto  type_id = base_type(ids[var_id].type);
+	auto &name    = ids[type_id].name;
+	if (!name.empty())
+	{
+		return std::string{name};
+	}
+	if (!ids[var_id].name.empty())
+	{
+		return std::string{ids[var_id].name};
+	}
+	return "_" + std::to_string(type_id) + "_" + std::to_string(var_id);
+}
+
+bool SpvModule::evaluate_u32(uint32_t id, uint32_t &value) const
+{
+	auto &constant = ids[id];
+	if (constant.op != spv::OpConstant && constant.op != spv::OpSpecConstant)
+	{
+		return false;
+	}
+	value = constant.value;
+	return true;
+}
+
+bool SpvModule::declared_struct_size(const SpvId &type, size_t &size) const
+{
+	if (type.op != spv::OpTypeStruct || type.member_count == 0)
+	{
+		return false;
+	}
+
+	// Offsets can be declared out of order, the highest one ends the struct
+	uint32_t member_index   = 0;
+	size_t   highest_offset = 0;
+	for (uint32_t i = 0; i < type.member_count; i++)
+	{
+		auto &m = member(type, i);
+		if (!(m.decorations & HasOffset))
+		{
+			return false;
+		}
+		if (m.offset > highest_offset)
+		{
+			highest_offset = m.offset;
+			member_index   = i;
+		}
+	}
+
+	size_t member_size;
+	if (!declared_member_size(type, member_index, member_size))
+	{
+		return false;
+	}
+	size = highest_offset + member_size;
+	return true;
+}
+
+bool SpvModule::declared_struct_size_runtime_array(const SpvId &type, size_t array_size, size_t &size) const
+{
+	if (!declared_struct_size(type, size))
+	{
+		return false;
+	}
+
+	auto  last_id = type.member_types[type.member_count - 1];
+	auto &last    = ids[last_id];
+	if (last.op == spv::OpTypeRuntimeArray || last.op == spv::OpTypeArray)
+	{
+		// The innermost dimension decides, as for SPIRType::array[0]
+		uint32_t innermost = last_id;
+		while (ids[ids[innermost].type].op == spv::OpTypeArray || ids[ids[innermost].type].op == spv::OpTypeRuntimeArray)
+		{
+			innermost = ids[innermost].type;
+		}
+		if (ids[innermost].op == spv::OpTypeRuntimeArray)
+		{
+			if (!(last.decorations & HasArrayStride))
+			{
+				return false;
+			}
+			size += array_size * last.array_stride;
+		}
+	}
+	return true;
+}
+
+bool SpvModule::declared_member_size(const SpvId &struct_type, uint32_t index, size_t &size) const
+{
+	auto  type_id = struct_type.member_types[index];
+	auto &m       = member(struct_type, index);
+	if (type_id >= ids.size())
+	{
+		return false;
+	}
+	auto &type = ids[type_id];
+
+	if (type.op == spv::OpTypePointer)
+	{
+		if (type.operand != spv::StorageClassPhysicalStorageBuffer)
+		{
+			return false;
+		}
+		size = 8;
+		return true;
+	}
+
+	// Opaque and logical types have no declared size
+	auto base_id = type_id;
+	while (ids[base_id].op == spv::OpTypeArray || ids[base_id].op == spv::OpTypeRuntimeArray)
+	{
+		base_id = ids[base_id].type;
+	}
+	auto &base = ids[base_id];
+	if (base.op != spv::OpTypeInt && base.op != spv::OpTypeFloat && base.op != spv::OpTypeVector &&
+	    base.op != spv::OpTypeMatrix && base.op != spv::OpTypeStruct && base.op != spv::OpTypePointer)
+	{
+		return false;
+	}
+
+	if (type.op == spv::OpTypeArray || type.op == spv::OpTypeRuntimeArray)
+	{
+		// The outermost dimension times the stride of the array type
+		uint32_t length = 0;
+		if (type.op == spv::OpTypeArray && !evaluate_u32(type.operand, length))
+		{
+			return false;
+		}
+		if (!(type.decorations & HasArrayStride))
+		{
+			return false;
+		}
+		size = size_t(type.array_stride) * length;
+		return true;
+	}
+
+	if (type.op == spv::OpTypeStruct)
+	{
+		return declared_struct_size(type, size);
+	}
+
+	if (type.op == spv::OpTypeMatrix)
+	{
+		if (!(m.decorations & HasMatrixStride))
+		{
+			return false;
+		}
+		auto &column = ids[type.type];
+		if (m.decorations & HasRowMajor)
+		{
+			size = size_t(m.matrix_stride) * column.operand;
+		}
+		else if (m.decorations & HasColMajor)
+		{
+			size = size_t(m.matrix_stride) * type.operand;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	if (type.op == spv::OpTypeVector)
+	{
+		size = size_t(type.operand) * (ids[type.type].operand / 8);
+		return true;
+	}
+
+	size = type.operand / 8;
+	return true;
+}
+
+/// Categories in the order SPIRV-Cross lists them
+enum class Category
+{
+	Input,
+	InputAttachment,
+	Output,
+	Image,
+	ImageSampler,
+	ImageStorage,
+	Sampler,
+	BufferUniform,
+	BufferStorage,
+	PushConstant,
+	None
+};
+
+Category classify(const SpvModule &module, uint32_t var_id)
+{
+	auto &var     = module.get(var_id);
+	auto  storage = var.operand;
+	if (storage == spv::StorageClassFunction || !module.in_entry_point_interface(var_id) || module.is_builtin(var))
+	{
+		return Category::None;
+	}
+
+	auto &type = module.get(module.base_type(var.type));
+	if (storage == spv::StorageClassInput)
+	{
+		return Category::Input;
+	}
+	if (storage == spv::StorageClassUniformConstant && type.op == spv::OpTypeImage && type.image_dim == spv::DimSubpassData)
+	{
+		return Category::InputAttachment;
+	}
+	if (storage == spv::StorageClassOutput)
+	{
+		return Category::Output;
+	}
+	if (storage == spv::StorageClassUniform && (type.decorations & HasBlock))
+	{
+		return Category::BufferUniform;
+	}
+	if ((storage == spv::StorageClassUniform && (type.decorations & HasBufferBlock)) || storage == spv::StorageClassStorageBuffer)
+	{
+		return Category::BufferStorage;
+	}
+	if (storage == spv::StorageClassPushConstant)
+	{
+		return Category::PushConstant;
+	}
+	if (storage == spv::StorageClassUniformConstant)
+	{
+		if (type.op == spv::OpTypeImage && type.image_sampled == 2)
+		{
+			return Category::ImageStorage;
+		}
+		if (type.op == spv::OpTypeImage && type.image_sampled == 1)
+		{
+			return Category::Image;
+		}
+		if (type.op == spv::OpTypeSampler)
+		{
+			return Category::Sampler;
+		}
+		if (type.op == spv::OpTypeSampledImage)
+		{
+			return Category::ImageSampler;
+		}
+	}
+	return Category::None;
+}
+
+void read_vec_size(const SpvModule &module, const SpvId &var, ShaderResource &resource)
+{
+	auto &type        = module.get(module.base_type(var.type));
+	resource.vec_size = 1;
+	resource.columns  = 1;
+	if (type.op == spv::OpTypeVector)
+	{
+		resource.vec_size = type.operand;
+	}
+	else if (type.op == spv::OpTypeMatrix)
+	{
+		resource.vec_size = module.get(type.type).operand;
+		resource.columns  = type.operand;
+	}
+}
+
+bool read_buffer_size(const SpvModule &module, const SpvId &var, ShaderResource &resource, const ShaderVariant &variant)
+{
+	size_t array_size = 0;
+	auto  &sizes      = variant.get_runtime_array_sizes();
+	auto   it         = sizes.find(resource.name);
+	if (it != sizes.end())
+	{
+		array_size = it->second;
+	}
+
+	size_t size;
+	if (!module.declared_struct_size_runtime_array(module.get(module.base_type(var.type)), array_size, size))
+	{
+		return false;
+	}
+	resource.size = uint32_t(size);
+	return true;
+}
+}        // namespace
+
+bool SPIRVReflection::reflect_shader_resources_lean(const uint32_t *spirv, size_t word_count, std::vector<ShaderResource> &resources, const ShaderVariant &variant)
+{
+	SpvModule module;
+	if (!module.parse(spirv, word_count))
+	{
+		return false;
+	}
+
+	std::vector<Category> categories;
+	categories.reserve(module.variables.size());
+	for (auto var_id : module.variables)
+	{
+		categories.push_back(classify(module, var_id));
+	}
+
+	auto ssbo_instance_names = module.ssbo_instance_name_is_significant();
+
+	std::vector<ShaderResource> reflected;
+	for (int category = 0; category < int(Category::None); category++)
+	{
+		for (size_t i = 0; i < module.variables.size(); i++)
+		{
+			if (categories[i] != Category(category))
+			{
+				continue;
+			}
+			auto  var_id = module.variables[i];
+			auto &var    = module.get(var_id);
+
+			ShaderResource resource{};
+			resource.name       = std::string{var.name};
+			resource.array_size = module.innermost_array_size(var.type);
+			resource.set        = var.set;
+			resource.binding    = var.binding;
+
+			switch (Category(category))
+			{
+				case Category::Input:
+				case Category::Output:
+					resource.type = category == int(Category::Input) ? ShaderResourceType::Input : ShaderResourceType::Output;
+					if (module.get(module.base_type(var.type)).decorations & HasBlock)
+					{
+						resource.name = module.block_name(var_id);
+					}
+					resource.set      = 0;
+					resource.binding  = 0;
+					resource.location = var.location;
+					read_vec_size(module, var, resource);
+					break;
+				case Category::InputAttachment:
+					resource.type                   = ShaderResourceType::InputAttachment;
+					resource.input_attachment_index = var.input_attachment_index;
+					break;
+				case Category::Image:
+					resource.type = ShaderResourceType::Image;
+					break;
+				case Category::ImageSampler:
+					resource.type = ShaderResourceType::ImageSampler;
+					break;
+				case Category::ImageStorage:
+					resource.type = ShaderResourceType::ImageStorage;
+					if (var.decorations & HasNonReadable)
+					{
+						resource.qualifiers |= ShaderResourceQualifiers::NonReadable;
+					}
+					if (var.decorations & HasNonWritable)
+					{
+						resource.qualifiers |= ShaderResourceQualifiers::NonWritable;
+					}
+					break;
+				case Category::Sampler:
+					resource.type = ShaderResourceType::Sampler;
+					break;
+				case Category::BufferUniform:
+				case Category::BufferStorage:
+				{
+					resource.type = category == int(Category::BufferUniform) ? ShaderResourceType::BufferUniform : ShaderResourceType::BufferStorage;
+					if (category == int(Category::BufferStorage) && ssbo_instance_names)
+					{
+						resource.name = var.name.empty() ? "_" + std::to_string(var_id) : std::string{var.name};
+					}
+					else
+					{
+						resource.name = module.block_name(var_id);
+					}
+					if (!read_buffer_size(module, var, resource, variant))
+					{
+						return false;
+					}
+					if (resource.type == ShaderResourceType::BufferStorage)
+					{
+						auto flags = module.buffer_block_flags(var);
+						if (flags & HasNonReadable)
+						{
+							resource.qualifiers |= ShaderResourceQualifiers::NonReadable;
+						}
+						if (flags & HasNonWritable)
+						{
+							resource.qualifiers |= ShaderResourceQualifiers::NonWritable;
+						}
+					}
+					break;
+				}
+				case Category::PushConstant:
+				{
+					resource.type       = ShaderResourceType::PushConstant;
+					resource.array_size = 0;
+					resource.set        = 0;
+					resource.binding    = 0;
+
+					auto &type   = module.get(module.base_type(var.type));
+					resource.offset = std::numeric_limits<uint32_t>::max();
+					for (uint32_t m = 0; type.op == spv::OpTypeStruct && m < type.member_count; m++)
+					{
+						resource.offset = std::min(resource.offset, module.member(type, m).offset);
+					}
+					if (!read_buffer_size(module, var, resource, variant))
+					{
+						return false;
+					}
+					resource.size -= resource.offset;
+					break;
+				}
+				default:
+					break;
+			}
+			reflected.push_back(std::move(resource));
+		}
+	}
+
+	for (auto id : module.spec_constants)
+	{
+		auto &constant = module.get(id);
+		if (!(constant.decorations & HasSpecId))
+		{
+			continue;
+		}
+
+		ShaderResource resource{};
+		resource.type        = ShaderResourceType::SpecializationConstant;
+		resource.name        = std::string{constant.name};
+		resource.offset      = 0;
+		resource.constant_id = constant.spec_id;
+
+		auto &type = module.get(constant.type);
+		if (type.op == spv::OpTypeBool)
+		{
+			resource.size = 4;
+		}
+		else if (type.op == spv::OpTypeInt || type.op == spv::OpTypeFloat)
+		{
+			resource.size = type.operand == 32 ? 4 : type.operand == 64 ? 8 : 0;
+		}
+		reflected.push_back(std::move(resource));
+	}
+
+	resources.insert(resources.end(), std::make_move_iterator(reflected.begin()), std::make_move_iterator(reflected.end()));
+	return true;
+}
+}        // namespace Veldrid
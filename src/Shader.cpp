@@ -1,9 +1,19 @@
 #include "veldrid/Shader.hpp"
+#include "veldrid/GraphicsDevice.hpp"
 
 #include "veldrid/common/RefCnt.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <mutex>
+#include <thread>
 
 //VKBP_DISABLE_WARNINGS()
 #include <SPIRV/GLSL.std.450.h>
@@ -134,9 +144,6 @@ const TBuiltInResource DefaultTBuiltInResource = {
 
 class _GlslangContainer : public Veldrid::RefCntBase {
 
-    static std::atomic<_GlslangContainer*> _pinstance;
-    static std::mutex _m;
-
     _GlslangContainer(){
         // Initialize glslang library.
 	    glslang::InitializeProcess();
@@ -145,33 +152,28 @@ class _GlslangContainer : public Veldrid::RefCntBase {
 public:
 
     ~_GlslangContainer() {
-        //Presumably non-multithreaded
-        _pinstance = nullptr;
         // Shutdown glslang library.
 	    glslang::FinalizeProcess();
     }
 
+    //Initialized once per process, compilers on any thread share it.
+    //Kept until exit, tearing glslang down while another thread
+    //fetches it again can't be made safe.
     static Veldrid::sp<_GlslangContainer> Get() {
-        if (_pinstance == nullptr) {
-            std::lock_guard<std::mutex> lock{ _m };
-            if (_pinstance == nullptr) {
-                _pinstance = new _GlslangContainer();
-            }
-        } else {
-            _pinstance.load(std::memory_order::memory_order_relaxed)->ref();
-        }
-        return Veldrid::sp{ _pinstance.load()};
+        static Veldrid::sp<_GlslangContainer> instance{ new _GlslangContainer() };
+        return instance;
     }
 
 
 };
 
-std::atomic<_GlslangContainer*> _GlslangContainer::_pinstance{ nullptr };
-std::mutex _GlslangContainer::_m{};
-
 
 namespace Veldrid{
 
+    // The environment every shader is compiled for, part of the compile cache key
+    static constexpr auto kTargetClientVersion   = glslang::EShTargetClientVersion::EShTargetVulkan_1_1;
+    static constexpr auto kTargetLanguageVersion = glslang::EShTargetLanguageVersion::EShTargetSpv_1_3;
+
     class GLSLCompilerImpl : public IGLSLCompiler {
         glslang::EShTargetLanguage        env_target_language;
     	glslang::EShTargetLanguageVersion env_target_language_version;
@@ -234,8 +236,8 @@ namespace Veldrid{
 	        shader.setSourceEntryPoint(entryPoint.c_str());
 	        shader.setPreamble(shaderVariant.get_preamble().c_str());
 	        shader.addProcesses(shaderVariant.get_processes());
-			shader.setEnvClient(glslang::EShClient::EShClientVulkan, glslang::EShTargetClientVersion::EShTargetVulkan_1_1);
-			shader.setEnvTarget(glslang::EShTargetLanguage::EshTargetSpv, glslang::EShTargetLanguageVersion::EShTargetSpv_1_3);
+			shader.setEnvClient(glslang::EShClient::EShClientVulkan, kTargetClientVersion);
+			shader.setEnvTarget(glslang::EShTargetLanguage::EshTargetSpv, kTargetLanguageVersion);
 
 	        //if (env_target_language != glslang::EShTargetLanguage::EShTargetNone)
 	        //{
@@ -369,12 +371,317 @@ std::string Connect(const std::vector<std::string> &lines){
 	return result;
 }
 
+// Bumped whenever the key or the file layout changes
+static constexpr uint32_t kShaderCacheVersion = 2;
+static constexpr char     kShaderCacheMagic[4] = {'V', 'S', 'P', 'V'};
+
+static void append_u32(std::string &out, uint32_t value)
+{
+	out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void append_string(std::string &out, const std::string &value)
+{
+	append_u32(out, static_cast<uint32_t>(value.size()));
+	out += value;
+}
+
+// Bounds checked reader over a loaded cache file
+struct CacheFileReader
+{
+	const char *data;
+
+	size_t size;
+
+	size_t offset = 0;
+
+	bool read_u32(uint32_t &value)
+	{
+		if (size - offset < sizeof(value))
+		{
+			return false;
+		}
+		std::memcpy(&value, data + offset, sizeof(value));
+		offset += sizeof(value);
+		return true;
+	}
+
+	bool read_string(std::string &value)
+	{
+		uint32_t length;
+		if (!read_u32(length) || size - offset < length)
+		{
+			return false;
+		}
+		value.assign(data + offset, length);
+		offset += length;
+		return true;
+	}
+};
+
+void SPIRVReflection::serialize_resources(const std::vector<ShaderResource> &resources, std::string &out)
+{
+	append_u32(out, static_cast<uint32_t>(resources.size()));
+	for (auto &resource : resources)
+	{
+		append_u32(out, static_cast<uint32_t>(resource.type));
+		append_u32(out, static_cast<uint32_t>(resource.mode));
+		append_u32(out, resource.set);
+		append_u32(out, resource.binding);
+		append_u32(out, resource.location);
+		append_u32(out, resource.input_attachment_index);
+		append_u32(out, resource.vec_size);
+		append_u32(out, resource.columns);
+		append_u32(out, resource.array_size);
+		append_u32(out, resource.offset);
+		append_u32(out, resource.size);
+		append_u32(out, resource.constant_id);
+		append_u32(out, resource.qualifiers);
+		append_string(out, resource.name);
+	}
+}
+
+bool SPIRVReflection::deserialize_resources(const char *data, size_t size, std::vector<ShaderResource> &resources)
+{
+	CacheFileReader reader{data, size};
+
+	uint32_t resource_count;
+	if (!reader.read_u32(resource_count))
+	{
+		return false;
+	}
+	resources.clear();
+	for (uint32_t i = 0; i < resource_count; i++)
+	{
+		ShaderResource resource{};
+		uint32_t       type, mode;
+		if (!reader.read_u32(type) || !reader.read_u32(mode) ||
+		    !reader.read_u32(resource.set) || !reader.read_u32(resource.binding) ||
+		    !reader.read_u32(resource.location) || !reader.read_u32(resource.input_attachment_index) ||
+		    !reader.read_u32(resource.vec_size) || !reader.read_u32(resource.columns) ||
+		    !reader.read_u32(resource.array_size) || !reader.read_u32(resource.offset) ||
+		    !reader.read_u32(resource.size) || !reader.read_u32(resource.constant_id) ||
+		    !reader.read_u32(resource.qualifiers) || !reader.read_string(resource.name))
+		{
+			return false;
+		}
+		resource.type = static_cast<ShaderResourceType>(type);
+		resource.mode = static_cast<ShaderResourceMode>(mode);
+		resources.push_back(std::move(resource));
+	}
+	return reader.offset == size;
+}
+
+ShaderCompileCache &ShaderCompileCache::get()
+{
+	static ShaderCompileCache cache;
+	return cache;
+}
+
+std::string ShaderCompileCache::make_key(Shader::Description::Stage stage,
+                                         const std::string &        final_source,
+                                         const std::string &        entry_point,
+                                         const ShaderVariant &      variant)
+{
+	std::string key;
+	append_u32(key, kShaderCacheVersion);
+	append_u32(key, kTargetClientVersion);
+	append_u32(key, kTargetLanguageVersion);
+	append_u32(key, stage.value);
+	append_string(key, entry_point);
+
+	// get_id() only hashes the preamble, keep the text to rule out collisions
+	append_string(key, std::to_string(variant.get_id()));
+	append_string(key, variant.get_preamble());
+	append_u32(key, static_cast<uint32_t>(variant.get_processes().size()));
+	for (auto &process : variant.get_processes())
+	{
+		append_string(key, process);
+	}
+
+	// Runtime array sizes only affect reflection, in a stable order
+	std::vector<std::pair<std::string, size_t>> array_sizes(
+	    variant.get_runtime_array_sizes().begin(), variant.get_runtime_array_sizes().end());
+	std::sort(array_sizes.begin(), array_sizes.end());
+	append_u32(key, static_cast<uint32_t>(array_sizes.size()));
+	for (auto &[name, size] : array_sizes)
+	{
+		append_string(key, name);
+		append_u32(key, static_cast<uint32_t>(size));
+	}
+
+	append_string(key, final_source);
+	return key;
+}
+
+void ShaderCompileCache::set_directory(const std::string &directory_)
+{
+	std::lock_guard<std::mutex> lock{m_entries};
+	directory = directory_;
+	if (!directory.empty())
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(directory, ec);
+	}
+}
+
+std::string ShaderCompileCache::entry_path(const std::string &key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.spvc",
+	              static_cast<unsigned long long>(std::hash<std::string>{}(key)));
+	return (std::filesystem::path(directory) / name).string();
+}
+
+static bool read_entry_file(const std::string &path, const std::string &key, ShaderCompileCache::Entry &entry)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+	std::string data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+	CacheFileReader reader{data.data(), data.size()};
+	if (data.size() < sizeof(kShaderCacheMagic) ||
+	    std::memcmp(data.data(), kShaderCacheMagic, sizeof(kShaderCacheMagic)) != 0)
+	{
+		return false;
+	}
+	reader.offset = sizeof(kShaderCacheMagic);
+
+	// The file name is only a hash, the stored key must match exactly
+	std::string stored_key;
+	if (!reader.read_string(stored_key) || stored_key != key)
+	{
+		return false;
+	}
+
+	uint32_t word_count;
+	if (!reader.read_u32(word_count) || (data.size() - reader.offset) / sizeof(uint32_t) < word_count)
+	{
+		return false;
+	}
+	entry.spirv.resize(word_count);
+	std::memcpy(entry.spirv.data(), data.data() + reader.offset, word_count * sizeof(uint32_t));
+	reader.offset += word_count * sizeof(uint32_t);
+
+	return SPIRVReflection::deserialize_resources(
+	    data.data() + reader.offset, data.size() - reader.offset, entry.resources);
+}
+
+static bool write_entry_file(const std::string &path, const std::string &key, const ShaderCompileCache::Entry &entry)
+{
+	std::string data(kShaderCacheMagic, sizeof(kShaderCacheMagic));
+	append_string(data, key);
+	append_u32(data, static_cast<uint32_t>(entry.spirv.size()));
+	data.append(reinterpret_cast<const char *>(entry.spirv.data()), entry.spirv.size() * sizeof(uint32_t));
+	SPIRVReflection::serialize_resources(entry.resources, data);
+
+	// Readers never see a partially written entry
+	auto tmp_path = path + ".tmp";
+	{
+		std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+		if (!file.write(data.data(), data.size()))
+		{
+			return false;
+		}
+		file.close();
+		if (!file)
+		{
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmp_path, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(tmp_path, ec);
+		return false;
+	}
+	return true;
+}
+
+bool ShaderCompileCache::lookup(const std::string &key, Entry &entry)
+{
+	std::string path;
+	{
+		std::lock_guard<std::mutex> lock{m_entries};
+		auto                        it = entries.find(key);
+		if (it != entries.end())
+		{
+			entry = it->second;
+			hits.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		if (!directory.empty())
+		{
+			path = entry_path(key);
+		}
+	}
+
+	if (!path.empty() && read_entry_file(path, key, entry))
+	{
+		std::lock_guard<std::mutex> lock{m_entries};
+		entries.emplace(key, entry);
+		disk_hits.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	misses.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void ShaderCompileCache::store(const std::string &key, const Entry &entry)
+{
+	std::string path;
+	{
+		std::lock_guard<std::mutex> lock{m_entries};
+		entries[key] = entry;
+		if (!directory.empty())
+		{
+			path = entry_path(key);
+		}
+	}
+
+	// A failed write only costs a recompilation next run
+	if (!path.empty())
+	{
+		write_entry_file(path, key, entry);
+	}
+}
+
+void ShaderCompileCache::clear()
+{
+	std::lock_guard<std::mutex> lock{m_entries};
+	entries.clear();
+}
+
+ShaderCompileCache::Stats ShaderCompileCache::get_stats() const
+{
+	return {hits.load(std::memory_order_relaxed),
+	        disk_hits.load(std::memory_order_relaxed),
+	        misses.load(std::memory_order_relaxed)};
+}
+
 ShaderModule::ShaderModule(
 	//std::shared_ptr<Device>& device,
 	Shader::Description::Stage stage, 
 	const std::string &glsl_source, 
 	const std::string &entry_point, 
 	const ShaderVariant &shader_variant
+) :
+    ShaderModule(stage, glsl_source, entry_point, shader_variant, *IGLSLCompiler::Get())
+{
+}
+
+ShaderModule::ShaderModule(
+	Shader::Description::Stage stage,
+	const std::string &glsl_source,
+	const std::string &entry_point,
+	const ShaderVariant &shader_variant,
+	IGLSLCompiler &glsl_compiler
 ) :
     //device{device},
     _isValid(false),
@@ -405,27 +712,36 @@ ShaderModule::ShaderModule(
 	// Precompile source into the final spirv bytecode
 	auto glsl_final_source = Connect(precompile_shader(source));
 
-	// Compile the GLSL source
-	
-	auto glsl_compiler = IGLSLCompiler::Get();
-
-	if (!glsl_compiler->CompileToSPIRV(stage, glsl_final_source, entry_point, shader_variant, spirv, info_log))
+	// Unchanged sources skip compilation and reflection
+	auto &compile_cache = ShaderCompileCache::get();
+	auto  cache_key     = ShaderCompileCache::make_key(stage, glsl_final_source, entry_point, shader_variant);
+	ShaderCompileCache::Entry cached;
+	if (compile_cache.lookup(cache_key, cached))
 	{
-		//LOGE("Shader compilation failed for shader \"{}\"", glsl_source.get_filename());
-		//LOGE("Shader compilation failed");
-		//LOGE("{}", info_log);
-		//throw VulkanException{VK_ERROR_INITIALIZATION_FAILED};
-        return;
+		spirv     = std::move(cached.spirv);
+		resources = std::move(cached.resources);
 	}
+	else
+	{
+		// Compile the GLSL source
+		if (!glsl_compiler.CompileToSPIRV(stage, glsl_final_source, entry_point, shader_variant, spirv, info_log))
+		{
+			//LOGE("Shader compilation failed for shader \"{}\"", glsl_source.get_filename());
+			//LOGE("Shader compilation failed");
+			//LOGE("{}", info_log);
+			//throw VulkanException{VK_ERROR_INITIALIZATION_FAILED};
+			return;
+		}
 
-	SPIRVReflection spirv_reflection;
+		// Reflect all shader resouces
+		//if (!spirv_reflection.reflect_shader_resources(stage, spirv, resources, shader_variant))
+		//{
+		//	throw VulkanException{VK_ERROR_INITIALIZATION_FAILED};
+		//}
+		SPIRVReflection::reflect_shader_resources(spirv, resources, shader_variant);
 
-	// Reflect all shader resouces
-	//if (!spirv_reflection.reflect_shader_resources(stage, spirv, resources, shader_variant))
-	//{
-	//	throw VulkanException{VK_ERROR_INITIALIZATION_FAILED};
-	//}
-	SPIRVReflection::reflect_shader_resources(spirv, resources, shader_variant);
+		compile_cache.store(cache_key, {spirv, resources});
+	}
 
 	// Generate a unique id, determined by source and variant
 	std::hash<std::string> hasher{};
@@ -447,6 +763,46 @@ ShaderModule::~ShaderModule()
 	//vkDestroyShaderModule(device->Handle(), _mod, nullptr);
 }
 
+std::vector<std::shared_ptr<ShaderModule>> ShaderModule::MakeBatch(
+	const std::vector<ShaderCompileJob> &jobs,
+	unsigned thread_count
+)
+{
+	std::vector<std::shared_ptr<ShaderModule>> modules(jobs.size());
+
+	if (thread_count == 0)
+	{
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+	thread_count = std::min<size_t>(thread_count, jobs.size());
+
+	// Workers pull the next job until none is left, each with its own compiler
+	std::atomic<size_t> next_job{0};
+	auto worker = [&]() {
+		auto glsl_compiler = IGLSLCompiler::Get();
+		for (size_t i = next_job++; i < jobs.size(); i = next_job++)
+		{
+			auto &job  = jobs[i];
+			modules[i] = std::shared_ptr<ShaderModule>(new ShaderModule(
+			    job.stage, job.glsl_source, job.entry_point, job.variant, *glsl_compiler));
+		}
+	};
+
+	// The calling thread compiles too
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < thread_count; i++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	return modules;
+}
+
 //ShaderModule::ShaderModule(ShaderModule &&other) :
 //    //device{other.device},
 //    _isValid(other._isValid),
@@ -490,6 +846,164 @@ void ShaderModule::set_resource_mode(const std::string &resource_name, const Sha
 	}
 }
 
+ShaderPermutations::ShaderPermutations(const sp<GraphicsDevice> &  device,
+                                       Shader::Description::Stage  stage,
+                                       const std::string &         glsl_source,
+                                       std::vector<std::string>    keywords,
+                                       const std::string &         entry_point) :
+    device{device},
+    stage{stage},
+    glsl_source{glsl_source},
+    keywords{std::move(keywords)},
+    entry_point{entry_point}
+{
+	assert(this->keywords.size() <= sizeof(Mask) * 8);
+}
+
+ShaderPermutations::~ShaderPermutations()
+{
+	for (auto &task : background_tasks)
+	{
+		task.wait();
+	}
+}
+
+ShaderPermutations::Mask ShaderPermutations::get_mask(const std::vector<std::string> &enabled_keywords) const
+{
+	Mask mask = 0;
+	for (auto &keyword : enabled_keywords)
+	{
+		auto it = std::find(keywords.begin(), keywords.end(), keyword);
+		if (it != keywords.end())
+		{
+			mask |= Mask{1} << (it - keywords.begin());
+		}
+	}
+	return mask;
+}
+
+std::shared_future<sp<Shader>> ShaderPermutations::request(Mask mask, std::function<void()> &task)
+{
+	std::scoped_lock lock{m_permutations};
+
+	auto it = permutations.find(mask);
+	if (it != permutations.end())
+	{
+		return it->second.shader;
+	}
+
+	// The first request compiles, later ones wait on the same future
+	auto compile_task = std::make_shared<std::packaged_task<sp<Shader>()>>([this, mask]() { return compile(mask); });
+	auto future       = compile_task->get_future().share();
+	permutations[mask].shader = future;
+	task = [compile_task]() { (*compile_task)(); };
+	return future;
+}
+
+sp<Shader> ShaderPermutations::get(Mask mask)
+{
+	std::function<void()> task;
+	auto                  future = request(mask, task);
+	if (task)
+	{
+		task();
+	}
+	return future.get();
+}
+
+std::shared_future<sp<Shader>> ShaderPermutations::get_async(Mask mask)
+{
+	std::function<void()> task;
+	auto                  future = request(mask, task);
+	if (task)
+	{
+		auto background = std::async(std::launch::async, std::move(task));
+
+		std::scoped_lock lock{m_permutations};
+		// Drop the tasks that are done, only running ones need waiting for
+		background_tasks.erase(std::remove_if(background_tasks.begin(), background_tasks.end(),
+		                                      [](const std::future<void> &task) {
+			                                      return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		                                      }),
+		                       background_tasks.end());
+		background_tasks.push_back(std::move(background));
+	}
+	return future;
+}
+
+sp<Shader> ShaderPermutations::compile(Mask mask)
+{
+	ShaderVariant variant;
+	for (size_t i = 0; i < keywords.size(); i++)
+	{
+		if (mask & (Mask{1} << i))
+		{
+			variant.add_define(keywords[i]);
+		}
+	}
+
+	// Goes through the compile cache, permutations seen by a previous run are not recompiled
+	ShaderModule module{stage, glsl_source, entry_point, variant};
+
+	// Keywords the source ignores compile to an existing shader, must hold the lock
+	auto &spirv       = module.GetBinary();
+	auto  find_unique = [&]() -> sp<Shader> {
+		auto range = unique_shaders.equal_range(module.GetID());
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second.spirv == spirv)
+			{
+				return it->second.shader;
+			}
+		}
+		return nullptr;
+	};
+
+	{
+		std::scoped_lock lock{m_permutations};
+		permutations[mask].info_log = module.GetInfoLog();
+		if (!module.IsValid())
+		{
+			failed++;
+			return nullptr;
+		}
+		if (auto shader = find_unique())
+		{
+			return shader;
+		}
+	}
+
+	// Other permutations keep being served while the device creates the shader
+	Shader::Description desc{};
+	desc.stage      = stage;
+	desc.entryPoint = entry_point;
+	auto shader     = device->GetResourceFactory()->CreateShader(desc, spirv);
+
+	std::scoped_lock lock{m_permutations};
+	// Another permutation with the same SPIR-V may have won the race
+	if (auto existing = find_unique())
+	{
+		return existing;
+	}
+	unique_shaders.emplace(module.GetID(), UniqueShader{spirv, shader});
+	created++;
+	return shader;
+}
+
+std::string ShaderPermutations::get_info_log(Mask mask) const
+{
+	std::scoped_lock lock{m_permutations};
+
+	auto it = permutations.find(mask);
+	return it != permutations.end() ? it->second.info_log : std::string{};
+}
+
+ShaderPermutations::Stats ShaderPermutations::get_stats() const
+{
+	std::scoped_lock lock{m_permutations};
+	return {static_cast<uint32_t>(permutations.size()), created, failed};
+}
+
 ShaderVariant::ShaderVariant(std::string &&preamble, std::vector<std::string> &&processes) :
     preamble{std::move(preamble)},
     processes{std::move(processes)}
@@ -623,6 +1137,20 @@ inline void read_shader_resource(const spirv_cross::Compiler &compiler,
 	//LOGE("Not implemented! Read shader resources of type.");
 }
 
+// Buffer blocks carry access qualifiers on their members instead of the variable
+inline bool has_resource_decoration(const spirv_cross::Compiler &compiler,
+                                    const spirv_cross::Resource &resource,
+                                    spv::Decoration              decoration)
+{
+	if (compiler.has_decoration(resource.id, decoration))
+	{
+		return true;
+	}
+	const auto &type = compiler.get_type(resource.base_type_id);
+	return type.basetype == spirv_cross::SPIRType::Struct &&
+	       compiler.get_buffer_block_flags(resource.id).get(decoration);
+}
+
 template <spv::Decoration T>
 inline void read_resource_decoration(const spirv_cross::Compiler & /*compiler*/,
                                      const spirv_cross::Resource & /*resource*/,
@@ -674,7 +1202,10 @@ inline void read_resource_decoration<spv::DecorationNonWritable>(const spirv_cro
                                                                  ShaderResource &             shader_resource,
                                                                  const ShaderVariant &        variant)
 {
-	shader_resource.qualifiers |= ShaderResourceQualifiers::NonWritable;
+	if (has_resource_decoration(compiler, resource, spv::DecorationNonWritable))
+	{
+		shader_resource.qualifiers |= ShaderResourceQualifiers::NonWritable;
+	}
 }
 
 template <>
@@ -683,7 +1214,10 @@ inline void read_resource_decoration<spv::DecorationNonReadable>(const spirv_cro
                                                                  ShaderResource &             shader_resource,
                                                                  const ShaderVariant &        variant)
 {
-	shader_resource.qualifiers |= ShaderResourceQualifiers::NonReadable;
+	if (has_resource_decoration(compiler, resource, spv::DecorationNonReadable))
+	{
+		shader_resource.qualifiers |= ShaderResourceQualifiers::NonReadable;
+	}
 }
 
 inline void read_resource_vec_size(const spirv_cross::Compiler &compiler,
@@ -948,7 +1482,7 @@ inline void read_shader_resource<ShaderResourceType::BufferStorage>(const spirv_
 
 	for (auto &resource : storage_resources)
 	{
-		ShaderResource shader_resource;
+		ShaderResource shader_resource{};
 		shader_resource.type   = ShaderResourceType::BufferStorage;
 		//shader_resource.stages = stage;
 		shader_resource.name   = resource.name;
@@ -1030,7 +1564,63 @@ void parse_specialization_constants(const spirv_cross::Compiler &compiler, std::
 	}
 }
 
+static std::atomic<SPIRVReflection::Mode> reflection_mode{SPIRVReflection::Mode::Lean};
+static std::atomic<uint32_t>              reflection_mismatches{0};
+
+void SPIRVReflection::set_mode(Mode mode)
+{
+	reflection_mode.store(mode, std::memory_order_relaxed);
+}
+
+SPIRVReflection::Mode SPIRVReflection::get_mode()
+{
+	return reflection_mode.load(std::memory_order_relaxed);
+}
+
+uint32_t SPIRVReflection::get_validation_mismatches()
+{
+	return reflection_mismatches.load(std::memory_order_relaxed);
+}
+
+bool SPIRVReflection::is_same_resource(const ShaderResource &a, const ShaderResource &b)
+{
+	return a.type == b.type && a.mode == b.mode && a.set == b.set && a.binding == b.binding &&
+	       a.location == b.location && a.input_attachment_index == b.input_attachment_index &&
+	       a.vec_size == b.vec_size && a.columns == b.columns && a.array_size == b.array_size &&
+	       a.offset == b.offset && a.size == b.size && a.constant_id == b.constant_id &&
+	       a.qualifiers == b.qualifiers && a.name == b.name;
+}
+
 bool SPIRVReflection::reflect_shader_resources(const std::vector<uint32_t> &spirv, std::vector<ShaderResource> &resources, const ShaderVariant &variant)
+{
+	auto mode = get_mode();
+	if (mode == Mode::SPIRVCross)
+	{
+		return reflect_shader_resources_spirv_cross(spirv, resources, variant);
+	}
+
+	std::vector<ShaderResource> lean;
+	if (!reflect_shader_resources_lean(spirv.data(), spirv.size(), lean, variant))
+	{
+		return reflect_shader_resources_spirv_cross(spirv, resources, variant);
+	}
+
+	if (mode == Mode::Validate)
+	{
+		std::vector<ShaderResource> full;
+		reflect_shader_resources_spirv_cross(spirv, full, variant);
+		if (!std::equal(lean.begin(), lean.end(), full.begin(), full.end(), is_same_resource))
+		{
+			reflection_mismatches.fetch_add(1, std::memory_order_relaxed);
+		}
+		lean = std::move(full);
+	}
+
+	resources.insert(resources.end(), std::make_move_iterator(lean.begin()), std::make_move_iterator(lean.end()));
+	return true;
+}
+
+bool SPIRVReflection::reflect_shader_resources_spirv_cross(const std::vector<uint32_t> &spirv, std::vector<ShaderResource> &resources, const ShaderVariant &variant)
 {
 	spirv_cross::CompilerGLSL compiler{spirv};
 
@@ -0,0 +1,333 @@
+#include "veldrid/ShaderPack.hpp"
+#include "veldrid/ResourceFactory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace Veldrid
+{
+    //File layout, little endian:
+    //  _PackHeader
+    //  _PackEntry[entryCount]
+    //  names and entry points
+    //  entry data, each 8 byte aligned so SPIR-V can be used in place
+    static constexpr char kPackMagic[4] = { 'V', 'P', 'A', 'K' };
+    static constexpr std::uint32_t kPackVersion = 1;
+
+    enum _PackEntryKind : std::uint32_t {
+        _PackEntryShader = 0,
+        _PackEntryBlob = 1,
+        _PackEntryPipelineCache = 2,
+    };
+
+    struct _PackHeader {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t entryCount;
+        std::uint32_t reserved;
+    };
+
+    struct _PackEntry {
+        std::uint32_t kind;
+        std::uint32_t stage;
+        std::uint32_t nameOffset;
+        std::uint32_t nameSize;
+        std::uint32_t entryPointOffset;
+        std::uint32_t entryPointSize;
+        std::uint32_t reserved[2];
+        std::uint64_t dataOffset;
+        std::uint64_t dataSize;
+        std::uint64_t reflectionOffset;
+        std::uint64_t reflectionSize;
+    };
+    static_assert(sizeof(_PackHeader) == 16 && sizeof(_PackEntry) == 64,
+        "Pack structures are read in place");
+
+    ShaderPack::~ShaderPack() {
+        #ifdef _WIN32
+        if (_data != nullptr) UnmapViewOfFile(_data);
+        if (_mapping != nullptr) CloseHandle(_mapping);
+        if (_file != nullptr) CloseHandle(_file);
+        #else
+        if (_data != nullptr) munmap(const_cast<std::uint8_t*>(_data), _size);
+        #endif
+    }
+
+    bool ShaderPack::_Map(const std::string& path, std::string& error) {
+        #ifdef _WIN32
+        auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            error = "Cannot open " + path;
+            return false;
+        }
+        _file = file;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(_PackHeader)) {
+            error = "Not a shader pack: " + path;
+            return false;
+        }
+        _size = static_cast<std::size_t>(size.QuadPart);
+
+        _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (_mapping == nullptr) {
+            error = "Cannot map " + path;
+            return false;
+        }
+        _data = static_cast<const std::uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (_data == nullptr) {
+            error = "Cannot map " + path;
+            return false;
+        }
+        #else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "Cannot open " + path;
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(_PackHeader)) {
+            close(fd);
+            error = "Not a shader pack: " + path;
+            return false;
+        }
+        _size = static_cast<std::size_t>(st.st_size);
+
+        //The mapping stays valid once the descriptor is closed
+        auto* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            _size = 0;
+            error = "Cannot map " + path;
+            return false;
+        }
+        _data = static_cast<const std::uint8_t*>(data);
+        #endif
+        return true;
+    }
+
+    bool ShaderPack::_ReadIndex(std::string& error) {
+        auto* header = reinterpret_cast<const _PackHeader*>(_data);
+        if (std::memcmp(header->magic, kPackMagic, sizeof(kPackMagic)) != 0
+            || header->version != kPackVersion
+        ) {
+            error = "Not a shader pack or unsupported version";
+            return false;
+        }
+        if ((_size - sizeof(_PackHeader)) / sizeof(_PackEntry) < header->entryCount) {
+            error = "Truncated shader pack index";
+            return false;
+        }
+
+        auto inBounds = [&](std::uint64_t offset, std::uint64_t size) {
+            return offset <= _size && size <= _size - offset;
+        };
+        auto string = [&](std::uint32_t offset, std::uint32_t size) {
+            return std::string_view(reinterpret_cast<const char*>(_data) + offset, size);
+        };
+
+        auto* entries = reinterpret_cast<const _PackEntry*>(_data + sizeof(_PackHeader));
+        for (std::uint32_t i = 0; i < header->entryCount; i++) {
+            auto& e = entries[i];
+            if (!inBounds(e.nameOffset, e.nameSize)
+                || !inBounds(e.entryPointOffset, e.entryPointSize)
+                || !inBounds(e.dataOffset, e.dataSize)
+                || !inBounds(e.reflectionOffset, e.reflectionSize)
+            ) {
+                error = "Shader pack entry out of bounds";
+                return false;
+            }
+
+            auto* data = _data + e.dataOffset;
+            switch (e.kind) {
+            case _PackEntryShader: {
+                if (e.dataOffset % sizeof(std::uint32_t) != 0
+                    || e.dataSize % sizeof(std::uint32_t) != 0
+                ) {
+                    error = "Misaligned SPIR-V in shader pack";
+                    return false;
+                }
+                ShaderEntry shader{};
+                shader.name = string(e.nameOffset, e.nameSize);
+                shader.stage.value = static_cast<std::uint8_t>(e.stage);
+                shader.entryPoint = string(e.entryPointOffset, e.entryPointSize);
+                shader.spirv = reinterpret_cast<const std::uint32_t*>(data);
+                shader.wordCount = e.dataSize / sizeof(std::uint32_t);
+                shader.reflection = reinterpret_cast<const char*>(_data + e.reflectionOffset);
+                shader.reflectionSize = e.reflectionSize;
+                _shaderIndex.emplace(shader.name, _shaders.size());
+                _shaders.push_back(shader);
+            } break;
+            case _PackEntryBlob:
+                _blobIndex.emplace(string(e.nameOffset, e.nameSize), _blobs.size());
+                _blobs.push_back({ string(e.nameOffset, e.nameSize), data, e.dataSize });
+                break;
+            case _PackEntryPipelineCache:
+                _pipelineCache = { {}, data, e.dataSize };
+                break;
+            default:
+                //Written by a newer writer, skip what we don't know
+                break;
+            }
+        }
+        return true;
+    }
+
+    sp<ShaderPack> ShaderPack::Open(const std::string& path, std::string& error) {
+        sp<ShaderPack> pack(new ShaderPack());
+        if (!pack->_Map(path, error) || !pack->_ReadIndex(error)) {
+            return nullptr;
+        }
+        return pack;
+    }
+
+    const ShaderPack::ShaderEntry* ShaderPack::FindShader(std::string_view name) const {
+        auto it = _shaderIndex.find(name);
+        return it != _shaderIndex.end() ? &_shaders[it->second] : nullptr;
+    }
+
+    const ShaderPack::BlobEntry* ShaderPack::FindBlob(std::string_view name) const {
+        auto it = _blobIndex.find(name);
+        return it != _blobIndex.end() ? &_blobs[it->second] : nullptr;
+    }
+
+    bool ShaderPack::GetResources(
+        const ShaderEntry& shader, std::vector<ShaderResource>& resources
+    ) const {
+        return SPIRVReflection::deserialize_resources(
+            shader.reflection, shader.reflectionSize, resources);
+    }
+
+    sp<Shader> ShaderPack::CreateShader(
+        ResourceFactory& factory,
+        const ShaderEntry& shader,
+        bool enableDebug
+    ) const {
+        Shader::Description desc{};
+        desc.stage = shader.stage;
+        desc.entryPoint = std::string(shader.entryPoint);
+        desc.enableDebug = enableDebug;
+        return factory.CreateShader(desc, shader.spirv, shader.wordCount);
+    }
+
+    void ShaderPackWriter::AddShader(
+        const std::string& name,
+        Shader::Description::Stage stage,
+        const std::string& entryPoint,
+        const std::vector<std::uint32_t>& spirv,
+        const std::vector<ShaderResource>& resources
+    ) {
+        _Entry entry{};
+        entry.kind = _PackEntryShader;
+        entry.stage = stage.value;
+        entry.name = name;
+        entry.entryPoint = entryPoint;
+        entry.data.assign(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(std::uint32_t));
+        SPIRVReflection::serialize_resources(resources, entry.reflection);
+        _entries.push_back(std::move(entry));
+    }
+
+    void ShaderPackWriter::AddShader(const std::string& name, const ShaderModule& module) {
+        AddShader(name, module.GetStage(), module.GetEntryPoint(), module.GetBinary(), module.GetResources());
+    }
+
+    void ShaderPackWriter::AddBlob(const std::string& name, const void* data, std::size_t size) {
+        _Entry entry{};
+        entry.kind = _PackEntryBlob;
+        entry.name = name;
+        entry.data.assign(static_cast<const char*>(data), size);
+        _entries.push_back(std::move(entry));
+    }
+
+    void ShaderPackWriter::SetPipelineCache(const void* data, std::size_t size) {
+        _entries.erase(std::remove_if(_entries.begin(), _entries.end(), [](auto& e) {
+            return e.kind == _PackEntryPipelineCache;
+        }), _entries.end());
+
+        _Entry entry{};
+        entry.kind = _PackEntryPipelineCache;
+        entry.data.assign(static_cast<const char*>(data), size);
+        _entries.push_back(std::move(entry));
+    }
+
+    bool ShaderPackWriter::Write(const std::string& path, std::string& error) const {
+        std::vector<_PackEntry> index(_entries.size());
+
+        //Strings follow the index, then the 8 byte aligned payloads
+        std::string strings;
+        std::size_t stringsOffset = sizeof(_PackHeader) + index.size() * sizeof(_PackEntry);
+        for (std::size_t i = 0; i < _entries.size(); i++) {
+            auto& e = _entries[i];
+            auto& rec = index[i];
+            rec.kind = e.kind;
+            rec.stage = e.stage;
+            rec.nameOffset = static_cast<std::uint32_t>(stringsOffset + strings.size());
+            rec.nameSize = static_cast<std::uint32_t>(e.name.size());
+            strings += e.name;
+            rec.entryPointOffset = static_cast<std::uint32_t>(stringsOffset + strings.size());
+            rec.entryPointSize = static_cast<std::uint32_t>(e.entryPoint.size());
+            strings += e.entryPoint;
+        }
+
+        std::string payload;
+        std::size_t payloadOffset = (stringsOffset + strings.size() + 7) & ~std::size_t(7);
+        auto append = [&](const std::string& bytes, std::uint64_t& offset, std::uint64_t& size) {
+            payload.resize((payload.size() + 7) & ~std::size_t(7), '\0');
+            offset = payloadOffset + payload.size();
+            size = bytes.size();
+            payload += bytes;
+        };
+        for (std::size_t i = 0; i < _entries.size(); i++) {
+            append(_entries[i].data, index[i].dataOffset, index[i].dataSize);
+            append(_entries[i].reflection, index[i].reflectionOffset, index[i].reflectionSize);
+        }
+
+        _PackHeader header{};
+        std::memcpy(header.magic, kPackMagic, sizeof(kPackMagic));
+        header.version = kPackVersion;
+        header.entryCount = static_cast<std::uint32_t>(index.size());
+
+        //Readers never see a partially written pack
+        auto tmpPath = path + ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            std::string padding(payloadOffset - stringsOffset - strings.size(), '\0');
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(_PackEntry));
+            file.write(strings.data(), strings.size());
+            file.write(padding.data(), padding.size());
+            file.write(payload.data(), payload.size());
+            file.close();
+            if (!file) {
+                error = "Cannot write " + tmpPath;
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, path, ec);
+        if (ec) {
+            std::filesystem::remove(tmpPath, ec);
+            error = "Cannot replace " + path;
+            return false;
+        }
+        return true;
+    }
+
+} // namespace Veldrid
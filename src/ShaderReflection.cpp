@@ -0,0 +1,156 @@
+#include "veldrid/ShaderReflection.hpp"
+#include "veldrid/ResourceFactory.hpp"
+
+#include <algorithm>
+#include <map>
+
+namespace Veldrid
+{
+    using _ResourceKind = ResourceLayout::Description::ElementDescription::ResourceKind;
+
+    static bool _ToResourceKind(const ShaderResource& res, _ResourceKind& kind)
+    {
+        switch (res.type)
+        {
+            case ShaderResourceType::BufferUniform:
+                kind = _ResourceKind::UniformBuffer; return true;
+            case ShaderResourceType::BufferStorage:
+                kind = (res.qualifiers & ShaderResourceQualifiers::NonWritable)
+                    ? _ResourceKind::StructuredBufferReadOnly
+                    : _ResourceKind::StructuredBufferReadWrite;
+                return true;
+            case ShaderResourceType::Image:
+                kind = _ResourceKind::TextureReadOnly; return true;
+            case ShaderResourceType::ImageStorage:
+                kind = _ResourceKind::TextureReadWrite; return true;
+            case ShaderResourceType::Sampler:
+                kind = _ResourceKind::Sampler; return true;
+            default:
+                return false;
+        }
+    }
+
+    bool ReflectPipelineLayout(
+        const std::vector<const ShaderModule*>& modules,
+        ReflectedPipelineLayout& layout,
+        std::string& error)
+    {
+        using Element = ResourceLayout::Description::ElementDescription;
+
+        layout = {};
+        std::map<std::uint32_t, std::map<std::uint32_t, Element>> sets;
+
+        for (auto* mod : modules)
+        {
+            auto stage = mod->GetStage();
+            for (auto& res : mod->GetResources())
+            {
+                if (res.type == ShaderResourceType::PushConstant)
+                {
+                    //Ranges used by several stages with the same extent are merged
+                    auto& ranges = layout.pushConstantRanges;
+                    auto it = std::find_if(ranges.begin(), ranges.end(), [&](auto& r) {
+                        return r.offset == res.offset && r.size == res.size;
+                    });
+                    if (it == ranges.end())
+                    {
+                        PushConstantRange range{};
+                        range.stages = stage;
+                        range.offset = res.offset;
+                        range.size = res.size;
+                        ranges.push_back(range);
+                    }
+                    else
+                    {
+                        it->stages.value |= stage.value;
+                    }
+                    continue;
+                }
+
+                if (res.type == ShaderResourceType::ImageSampler
+                    || res.type == ShaderResourceType::InputAttachment)
+                {
+                    error = "Resource '" + res.name + "' has no matching resource kind";
+                    return false;
+                }
+
+                Element::ResourceKind kind;
+                if (!_ToResourceKind(res, kind)) continue; //Inputs, outputs, constants
+
+                if (res.array_size != 1)
+                {
+                    error = "Resource '" + res.name + "' is an array";
+                    return false;
+                }
+
+                auto& bindings = sets[res.set];
+                auto [it, inserted] = bindings.try_emplace(res.binding);
+                auto& elem = it->second;
+                if (inserted)
+                {
+                    elem.name = res.name;
+                    elem.kind = kind;
+                    elem.stages.value = 0;
+                    elem.options.value = 0;
+                }
+                else if (elem.kind != kind)
+                {
+                    //Read-only in one stage and written in another
+                    bool storage = [](auto k) {
+                        return k == _ResourceKind::StructuredBufferReadOnly
+                            || k == _ResourceKind::StructuredBufferReadWrite;
+                    }(elem.kind);
+                    if (!storage || res.type != ShaderResourceType::BufferStorage)
+                    {
+                        error = "Resource '" + res.name + "' is declared differently across stages";
+                        return false;
+                    }
+                    elem.kind = _ResourceKind::StructuredBufferReadWrite;
+                }
+                elem.stages.value |= stage.value;
+                if (res.mode == ShaderResourceMode::Dynamic)
+                {
+                    elem.options.dynamicBinding = 1;
+                }
+            }
+        }
+
+        if (!sets.empty())
+        {
+            //Unused sets in between get empty layouts
+            layout.resourceLayouts.resize(sets.rbegin()->first + 1);
+        }
+        for (auto& [set, bindings] : sets)
+        {
+            auto& elements = layout.resourceLayouts[set].elements;
+            //An element's binding is its index in the layout
+            std::uint32_t expected = 0;
+            for (auto& [binding, elem] : bindings)
+            {
+                if (binding != expected++)
+                {
+                    error = "Set " + std::to_string(set) + " has no resource at binding "
+                        + std::to_string(expected - 1);
+                    layout = {};
+                    return false;
+                }
+                elements.push_back(elem);
+            }
+        }
+        return true;
+    }
+
+    std::vector<sp<ResourceLayout>> CreateResourceLayouts(
+        ResourceFactory& factory,
+        const ReflectedPipelineLayout& layout)
+    {
+        std::vector<sp<ResourceLayout>> layouts;
+        layouts.reserve(layout.resourceLayouts.size());
+        for (auto& desc : layout.resourceLayouts)
+        {
+            layouts.push_back(factory.CreateResourceLayout(desc));
+        }
+        return layouts;
+    }
+
+} // namespace Veldrid
@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
+#include <cstdint>
 
 /// @brief Helper macro to test the result of Vulkan calls which can return an error.
 #define VK_CHECK(x)                                                 \
@@ -54,6 +56,8 @@ struct VkDevExtNames {
     static const char* VK_KHR_GET_MEMORY_REQ2;
     static const char* VK_KHR_DEDICATED_ALLOCATION;
     static const char* VK_KHR_DRIVER_PROPS;
+    static const char* VK_EXT_PIPELINE_CREATION_FEEDBACK;
+    static const char* VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE;
 
 };
 
@@ -65,3 +69,22 @@ struct VkCommonStrings {
 
 std::vector<std::string> EnumerateInstanceLayers();
 std::vector<std::string> EnumerateInstanceExtensions();
+
+
+namespace Veldrid {
+    //Hint stored in buffers & textures telling where the resource sits in
+    //the tracking tables of the command list that used it last.
+    //High 32 bits: registry generation, low 32 bits: slot index.
+    struct _ResTrackingTag {
+        std::atomic<std::uint64_t> value{ 0 };
+    };
+
+    //Mip level / array layer range of a texture, cubemap faces count
+    //as separate layers. Default constructed range covers everything.
+    struct _TexSubresRange {
+        std::uint32_t baseMipLevel = 0;
+        std::uint32_t levelCount = ~0u;
+        std::uint32_t baseArrayLayer = 0;
+        std::uint32_t layerCount = ~0u;
+    };
+}
@@ -1,7 +1,11 @@
 #include "VkDescriptorPoolMgr.hpp"
 
-#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "VkCommon.hpp"
 
@@ -20,65 +24,236 @@ namespace Veldrid {
 		//}
 	}
 
+	//Vulkan type of each DescriptorTypeCounts slot
+	static const VkDescriptorType _kTrackedTypes[kDescriptorTypeCount] = {
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+		VK_DESCRIPTOR_TYPE_SAMPLER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+	};
+
+	static DescriptorTypeCounts _ToTypeCounts(const DescriptorResourceCounts& drcs){
+		return {
+			drcs.uniformBufferCount,
+			drcs.sampledImageCount,
+			drcs.samplerCount,
+			drcs.storageBufferCount,
+			drcs.storageImageCount,
+			drcs.uniformBufferDynamicCount,
+			drcs.storageBufferDynamicCount,
+		};
+	}
+
+	static bool _Fits(const DescriptorTypeCounts& capacity, const DescriptorTypeCounts& counts){
+		for (unsigned i = 0; i < kDescriptorTypeCount; i++) {
+			if (capacity[i] < counts[i]) return false;
+		}
+		return true;
+	}
+
+	//Weight kept by the histogram each time a shard merges into it
+	static constexpr double _kDemandDecay = 0.5;
+	//Extra room over the observed average, so that a pool is rarely
+	//retired for lack of one type before the others run out
+	static constexpr double _kHeadroom = 1.125;
+
 	void _DescriptorPoolMgr::Init(VkDevice dev, unsigned maxSets){
-		assert(_currentPool == nullptr);
+		assert(_shards == nullptr);
 		_dev = dev;
 		_maxSets = maxSets;
-		auto firstPool = _CreatePool();
-		auto firstPoolContainer = new Container();
-		firstPoolContainer->mgr = this;
-		firstPoolContainer->pool = firstPool;
-		_currentPool.reset(firstPoolContainer);
+		_shardCount = std::max(1u, std::thread::hardware_concurrency());
+		_shards.reset(new _Shard[_shardCount]);
+		//Pools are created on first use in each shard
 	}
 
 	void _DescriptorPoolMgr::DeInit(){
-		//All dirty pools should be recycled by now.
-		assert(_dirtyPools.empty());
-		//Retire current pool
-		_currentPool = nullptr;
+		//Retire current pools, they go back to _recycled
+		for (unsigned i = 0; i < _shardCount; i++) {
+			_shards[i].currentPool = nullptr;
+		}
+		//All other containers should be released by now.
+		assert(_liveContainers.load() == 0);
 
-		while (!_freePools.empty()) {
-			auto pool = _freePools.front();
-			_freePools.pop();
-			vkDestroyDescriptorPool(_dev, pool, nullptr);
+		for (unsigned i = 0; i < _shardCount; i++) {
+			for (auto& pool : _shards[i].freePools) {
+				vkDestroyDescriptorPool(_dev, pool.pool, nullptr);
+			}
 		}
+		_shards.reset();
+		_shardCount = 0;
+
+		auto* node = _recycled.exchange(nullptr, std::memory_order_acquire);
+		while (node != nullptr) {
+			auto* next = node->next;
+			vkDestroyDescriptorPool(_dev, node->pool.pool, nullptr);
+			delete node;
+			node = next;
+		}
+
+		//Device is idle, every batch is completed
+		for (auto& batch : _inFlightTransient) {
+			for (auto& pool : batch.pools) {
+				vkDestroyDescriptorPool(_dev, pool.pool, nullptr);
+			}
+			vkDestroyFence(_dev, batch.fence, nullptr);
+		}
+		_inFlightTransient.clear();
+
+		for (auto& pool : _freeTransientPools) {
+			vkDestroyDescriptorPool(_dev, pool.pool, nullptr);
+		}
+		_freeTransientPools.clear();
+
+		for (auto fence : _freeFences) {
+			vkDestroyFence(_dev, fence, nullptr);
+		}
+		_freeFences.clear();
 	}
 
 
 	void _DescriptorPoolMgr::_ReleaseContainer(Container* container){
-		//std::scoped_lock l{_m_pool};
+		//No set of the pool is alive and no shard uses it,
+		//nobody else touches the pool anymore.
+		if (container->retiredEarly) {
+			//Shaped for an older demand, new pools fit better
+			vkDestroyDescriptorPool(_dev, container->pool, nullptr);
+			_liveContainers.fetch_sub(1, std::memory_order_relaxed);
+			return;
+		}
+		VK_CHECK(vkResetDescriptorPool(_dev, container->pool, 0));
 
-		//Mainly for debug purposes
-		//assert(_dirtyPools.find(container) != _dirtyPools.end());
-		//may not be in dirty pool list during manager destruction
-		_dirtyPools.erase(container);
+		auto* node = new _FreePool{
+			{ container->pool, container->capacity },
+			_recycled.load(std::memory_order_relaxed)
+		};
+		while (!_recycled.compare_exchange_weak(
+			node->next, node, std::memory_order_release, std::memory_order_relaxed)
+		) {}
+		_liveContainers.fetch_sub(1, std::memory_order_relaxed);
+	}
 
-		VK_CHECK(vkResetDescriptorPool(_dev, container->pool, 0));
-		_freePools.push(container->pool);
+	_DescriptorPoolMgr::_Shard& _DescriptorPoolMgr::_GetShard(){
+		//Threads are numbered once, in order of first allocation
+		static std::atomic<unsigned> nextThread{0};
+		thread_local unsigned threadIndex = nextThread.fetch_add(1, std::memory_order_relaxed);
+		return _shards[threadIndex % _shardCount];
 	}
-	VkDescriptorPool _DescriptorPoolMgr::_GetOnePool(){
-		//Should only be called from allocate
-		//std::scoped_lock l{_m_pool};
 
-		VkDescriptorPool rawPool;
-		if(!_freePools.empty()){
-			rawPool = _freePools.front();
-			_freePools.pop();
-		} else {
-			rawPool = _CreatePool();
+	_DescriptorPoolMgr::_Pool _DescriptorPoolMgr::_GetOnePool(
+		_Shard& shard, const DescriptorTypeCounts& counts
+	){
+		auto findFitting = [&]() {
+			return std::find_if(shard.freePools.begin(), shard.freePools.end(),
+				[&](const _Pool& p) { return _Fits(p.capacity, counts); });
+		};
+
+		auto it = findFitting();
+		if (it == shard.freePools.end()) {
+			//Take everything recycled so far
+			auto* node = _recycled.exchange(nullptr, std::memory_order_acquire);
+			while (node != nullptr) {
+				auto* next = node->next;
+				shard.freePools.push_back(node->pool);
+				delete node;
+				node = next;
+			}
+			it = findFitting();
 		}
 
-		return rawPool;
+		if(it != shard.freePools.end()){
+			auto pool = *it;
+			*it = shard.freePools.back();
+			shard.freePools.pop_back();
+			return pool;
+		}
+		//Pools of an outdated shape stay around for layouts they fit
+		_MergeDemand(shard.pendingDemand, shard.pendingSets);
+		shard.pendingDemand = {};
+		shard.pendingSets = 0;
+		return _CreatePool(counts);
 	}
 
+	sp<_DescriptorPoolMgr::Container> _DescriptorPoolMgr::_Wrap(const _Pool& pool){
+		auto container = new _DescriptorPoolMgr::Container();
+		container->pool = pool.pool;
+		container->mgr = this;
+		container->capacity = pool.capacity;
+		container->used = {};
+		container->usedSets = 0;
+		container->retiredEarly = false;
+		_liveContainers.fetch_add(1, std::memory_order_relaxed);
+		return sp(container);
+	}
 
-	VkDescriptorPool _DescriptorPoolMgr::_CreatePool()
-	{
+	bool _DescriptorPoolMgr::_Retire(
+		const DescriptorTypeCounts& capacity,
+		const DescriptorTypeCounts& used,
+		std::uint32_t usedSets
+	){
+		std::uint64_t reservedCount = 0, usedCount = 0;
+		for (unsigned i = 0; i < kDescriptorTypeCount; i++) {
+			reservedCount += capacity[i];
+			usedCount += used[i];
+		}
+		_poolsRetired.fetch_add(1, std::memory_order_relaxed);
+		_descriptorsReserved.fetch_add(reservedCount, std::memory_order_relaxed);
+		_descriptorsUsed.fetch_add(usedCount, std::memory_order_relaxed);
+		if (usedSets < _maxSets) {
+			_poolsRetiredEarly.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+
+	void _DescriptorPoolMgr::_MergeDemand(const DescriptorTypeCounts& demand, std::uint32_t sets){
+		if (sets == 0) return;
+
+		std::scoped_lock l{_demand.m};
+		//Older samples fade out
+		for (unsigned i = 0; i < kDescriptorTypeCount; i++) {
+			_demand.descriptors[i] = _demand.descriptors[i] * _kDemandDecay + demand[i];
+		}
+		_demand.sets = _demand.sets * _kDemandDecay + sets;
+	}
+
+	_DescriptorPoolMgr::_Pool _DescriptorPoolMgr::_CreatePool(const DescriptorTypeCounts& counts){
+		std::array<double, kDescriptorTypeCount> perSet{};
+		{
+			std::scoped_lock l{_demand.m};
+			if (_demand.sets > 0) {
+				for (unsigned i = 0; i < kDescriptorTypeCount; i++) {
+					perSet[i] = _demand.descriptors[i] / _demand.sets;
+				}
+			}
+		}
+
+		if (std::all_of(perSet.begin(), perSet.end(), [](double d) { return d == 0; })) {
+			//Nothing observed yet, start from the default shape
+			for (auto sz : _poolSizes.sizes) {
+				auto slot = std::find(std::begin(_kTrackedTypes), std::end(_kTrackedTypes), sz.type);
+				if (slot != std::end(_kTrackedTypes)) {
+					perSet[slot - std::begin(_kTrackedTypes)] = sz.multiplier;
+				}
+			}
+		}
+
+		_Pool res;
 		std::vector<VkDescriptorPoolSize> sizes;
-		sizes.reserve(_poolSizes.sizes.size());
-		for (auto sz : _poolSizes.sizes) {
-			sizes.push_back({sz.type, uint32_t(sz.multiplier * _maxSets)});
+		sizes.reserve(kDescriptorTypeCount);
+		for (unsigned i = 0; i < kDescriptorTypeCount; i++) {
+			auto count = std::uint32_t(std::ceil(perSet[i] * _kHeadroom * _maxSets));
+			//The set asking for the pool must fit
+			count = std::max(count, counts[i]);
+			res.capacity[i] = count;
+			if (count > 0) {
+				sizes.push_back({_kTrackedTypes[i], count});
+			}
 		}
+
 		VkDescriptorPoolCreateInfo pool_info = {};
 		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		pool_info.flags = 0;
@@ -86,34 +261,43 @@ namespace Veldrid {
 		pool_info.poolSizeCount = (uint32_t)sizes.size();
 		pool_info.pPoolSizes = sizes.data();
 
-		VkDescriptorPool descriptorPool;
-		VK_CHECK(vkCreateDescriptorPool(_dev, &pool_info, nullptr, &descriptorPool));
+		VK_CHECK(vkCreateDescriptorPool(_dev, &pool_info, nullptr, &res.pool));
+		_poolsCreated.fetch_add(1, std::memory_order_relaxed);
 
-		return descriptorPool;
+		return res;
 	}
 
-	_DescriptorSet _DescriptorPoolMgr::Allocate(VkDescriptorSetLayout layout){
+	_DescriptorSet _DescriptorPoolMgr::Allocate(
+		VkDescriptorSetLayout layout, const DescriptorResourceCounts& drcs
+	){
 
 		sp<Container> toBeSwapped {nullptr};
 		_DescriptorSet allocated {};
+		auto counts = _ToTypeCounts(drcs);
 
 		VkDescriptorSetAllocateInfo allocInfo;
 		allocInfo.pNext = nullptr;
 		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
 
+		auto& shard = _GetShard();
 		{
-			//Critical section guard
-			std::scoped_lock l{_m_pool};
+			//Only threads sharing the shard contend
+			std::scoped_lock l{shard.m};
 
-			//Try to allocate from current pool.
-			auto vkPool = _currentPool->pool;
-			allocInfo.descriptorPool = vkPool;
-			
-			allocInfo.pSetLayouts = &layout;
+			for (unsigned i = 0; i < kDescriptorTypeCount; i++) {
+				shard.pendingDemand[i] += counts[i];
+			}
+			shard.pendingSets += 1;
 
 			VkDescriptorSet set;
-			VkResult result = vkAllocateDescriptorSets(_dev, &allocInfo, &set);
+			VkResult result = VK_ERROR_OUT_OF_POOL_MEMORY;
+			//Try to allocate from current pool.
+			if (shard.currentPool != nullptr) {
+				allocInfo.descriptorPool = shard.currentPool->pool;
+				result = vkAllocateDescriptorSets(_dev, &allocInfo, &set);
+			}
 
 			switch (result) {
 				case VK_SUCCESS: break;
@@ -121,29 +305,26 @@ namespace Veldrid {
 				case VK_ERROR_FRAGMENTED_POOL:
 				case VK_ERROR_OUT_OF_POOL_MEMORY:{
 					//Fetch a new pool
-					auto newPool = _GetOnePool();
+					auto newPool = _GetOnePool(shard, counts);
 
 					//Try to allocate from a clean pool
-					allocInfo.descriptorPool = newPool;
+					allocInfo.descriptorPool = newPool.pool;
 					result = vkAllocateDescriptorSets(_dev, &allocInfo, &set);
 					if(result != VK_SUCCESS){
 						//Still can't allocate, maybe the set is too large?
 						//Clean up
-						_freePools.push(newPool);
+						shard.freePools.push_back(newPool);
 						return allocated;
 					}
 
-					//Allocate succeeded, seems like the current pool is full
-					//Add to dirty pools
-					_dirtyPools.insert(_currentPool.get());
-					//Wrap the raw pool
-					auto container = new _DescriptorPoolMgr::Container();
-					container->pool = newPool;
-					container->mgr = this;
-					//return sp(container);
-					toBeSwapped.reset(container);
+					//Allocate succeeded, seems like the current pool is full.
+					//It is recycled once its last set is released.
+					if (auto& full = shard.currentPool; full != nullptr) {
+						full->retiredEarly = _Retire(full->capacity, full->used, full->usedSets);
+					}
+					toBeSwapped = _Wrap(newPool);
 					//change current pool to new pool
-					_currentPool.swap(toBeSwapped);
+					shard.currentPool.swap(toBeSwapped);
 
 				} break;
 
@@ -151,14 +332,163 @@ namespace Veldrid {
 					return allocated;
 			}
 
+			auto& current = *shard.currentPool;
+			for (unsigned i = 0; i < kDescriptorTypeCount; i++) {
+				current.used[i] += counts[i];
+			}
+			current.usedSets += 1;
+			shard.setsAllocated += 1;
+
 			allocated = _DescriptorSet(
-				_currentPool, set
+				shard.currentPool, set
 			);
 		}
 		//Release the mutex to allow old container to do its clean-ups
-		
+
 		return allocated;
 	}
 
+	_TransientDescriptorPool _DescriptorPoolMgr::_AcquireTransientPool(
+		const DescriptorTypeCounts& counts
+	){
+		{
+			std::scoped_lock l{_m_transient};
+			_ReclaimCompletedBatches();
+			auto it = std::find_if(_freeTransientPools.begin(), _freeTransientPools.end(),
+				[&](const _Pool& p) { return _Fits(p.capacity, counts); });
+			if (it != _freeTransientPools.end()) {
+				auto pool = *it;
+				*it = _freeTransientPools.back();
+				_freeTransientPools.pop_back();
+				return { pool.pool, pool.capacity, {}, 0, false };
+			}
+		}
+
+		auto pool = _CreatePool(counts);
+		return { pool.pool, pool.capacity, {}, 0, false };
+	}
+
+	void _DescriptorPoolMgr::_ReturnTransientPool(const _TransientDescriptorPool& pool){
+		//Transient sets are most of the demand in a typical frame
+		_MergeDemand(pool.used, pool.usedSets);
+		if (pool.retiredEarly) {
+			vkDestroyDescriptorPool(_dev, pool.pool, nullptr);
+			return;
+		}
+		VK_CHECK(vkResetDescriptorPool(_dev, pool.pool, 0));
+		_freeTransientPools.push_back({ pool.pool, pool.capacity });
+	}
+
+	void _DescriptorPoolMgr::_ReclaimCompletedBatches(){
+		//Submissions on the same queue retire in order,
+		//stop at the first one still pending.
+		while (!_inFlightTransient.empty()) {
+			auto& batch = _inFlightTransient.front();
+			if (vkGetFenceStatus(_dev, batch.fence) != VK_SUCCESS) {
+				break;
+			}
+
+			for (auto& pool : batch.pools) {
+				_ReturnTransientPool(pool);
+			}
+			VK_CHECK(vkResetFences(_dev, 1, &batch.fence));
+			_freeFences.push_back(batch.fence);
+			_inFlightTransient.pop_front();
+		}
+	}
+
+	VkDescriptorSet _DescriptorPoolMgr::AllocateTransient(
+		std::vector<_TransientDescriptorPool>& pools,
+		VkDescriptorSetLayout layout, const DescriptorResourceCounts& drcs
+	){
+		auto counts = _ToTypeCounts(drcs);
+
+		VkDescriptorSetAllocateInfo allocInfo;
+		allocInfo.pNext = nullptr;
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult result = VK_ERROR_OUT_OF_POOL_MEMORY;
+		if (!pools.empty()) {
+			allocInfo.descriptorPool = pools.back().pool;
+			result = vkAllocateDescriptorSets(_dev, &allocInfo, &set);
+		}
+
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+			//Full pools stay in the list until the submission completes
+			if (!pools.empty()) {
+				auto& full = pools.back();
+				full.retiredEarly = _Retire(full.capacity, full.used, full.usedSets);
+			}
+			pools.push_back(_AcquireTransientPool(counts));
+
+			allocInfo.descriptorPool = pools.back().pool;
+			result = vkAllocateDescriptorSets(_dev, &allocInfo, &set);
+		}
+		if (result != VK_SUCCESS) {
+			return VK_NULL_HANDLE;
+		}
+
+		auto& pool = pools.back();
+		for (unsigned i = 0; i < kDescriptorTypeCount; i++) {
+			pool.used[i] += counts[i];
+		}
+		pool.usedSets += 1;
+		return set;
+	}
+
+	void _DescriptorPoolMgr::ReleaseTransientPools(std::vector<_TransientDescriptorPool>& pools){
+		if (pools.empty()) return;
+
+		std::scoped_lock l{_m_transient};
+		for (auto& pool : pools) {
+			_ReturnTransientPool(pool);
+		}
+		pools.clear();
+	}
+
+	VkFence _DescriptorPoolMgr::AcquireFence(){
+		{
+			std::scoped_lock l{_m_transient};
+			_ReclaimCompletedBatches();
+			if (!_freeFences.empty()) {
+				auto fence = _freeFences.back();
+				_freeFences.pop_back();
+				return fence;
+			}
+		}
+
+		VkFenceCreateInfo fenceCI{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+		VkFence fence;
+		VK_CHECK(vkCreateFence(_dev, &fenceCI, nullptr, &fence));
+		return fence;
+	}
+
+	void _DescriptorPoolMgr::RetireTransientPools(
+		std::vector<_TransientDescriptorPool>& pools, VkFence fence
+	){
+		assert(fence != VK_NULL_HANDLE);
+
+		std::scoped_lock l{_m_transient};
+		_inFlightTransient.push_back({ fence, std::move(pools) });
+		pools.clear();
+	}
+
+	_DescriptorPoolMgr::Stats _DescriptorPoolMgr::GetStats(){
+		Stats stats{};
+		stats.poolsCreated = _poolsCreated.load(std::memory_order_relaxed);
+		stats.poolsRetired = _poolsRetired.load(std::memory_order_relaxed);
+		stats.poolsRetiredEarly = _poolsRetiredEarly.load(std::memory_order_relaxed);
+		stats.descriptorsReserved = _descriptorsReserved.load(std::memory_order_relaxed);
+		stats.descriptorsUsed = _descriptorsUsed.load(std::memory_order_relaxed);
+		for (unsigned i = 0; i < _shardCount; i++) {
+			std::scoped_lock l{_shards[i].m};
+			stats.setsAllocated += _shards[i].setsAllocated;
+		}
+		return stats;
+	}
+
 
 }
\ No newline at end of file
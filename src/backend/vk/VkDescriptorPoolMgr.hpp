@@ -5,10 +5,13 @@
 #include "veldrid/common/RefCnt.hpp"
 #include "veldrid/common/Macros.h"
 
+#include <array>
+#include <atomic>
 #include <cstdint>
-#include <queue>
-#include <unordered_set>
+#include <deque>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 namespace Veldrid {
 
@@ -25,10 +28,16 @@ namespace Veldrid {
         std::uint32_t storageBufferDynamicCount;
     };
 
+	//Descriptor types a resource layout can use, in the order of
+	//DescriptorResourceCounts. Pools only reserve these.
+	constexpr unsigned kDescriptorTypeCount = 7;
+	using DescriptorTypeCounts = std::array<std::uint32_t, kDescriptorTypeCount>;
+
 	struct PoolSize {
 		VkDescriptorType type;
 		float multiplier;
 	};
+	//Initial pool shape, used until allocations give a better one
 	struct PoolSizes {
 		std::vector<PoolSize> sizes =
 		{
@@ -46,38 +55,135 @@ namespace Veldrid {
 		};
 	};
 
+	//Pool of a command list's transient sets. Sets are allocated linearly
+	//and never freed, the pool is reset as a whole once the submission
+	//using it completes.
+	struct _TransientDescriptorPool{
+		VkDescriptorPool pool;
+		DescriptorTypeCounts capacity;
+		DescriptorTypeCounts used;
+		std::uint32_t usedSets;
+		//Ran out of a type with sets left, destroyed instead of reused
+		bool retiredEarly;
+	};
+
 	class _DescriptorPoolMgr{
 
 	public:
 		 struct Container : public RefCntBase{
 			VkDescriptorPool pool;
 			_DescriptorPoolMgr* mgr;
+			//Descriptors the pool was created with
+			DescriptorTypeCounts capacity;
+			//Allocated so far, only touched under the owning shard's lock
+			DescriptorTypeCounts used;
+			std::uint32_t usedSets;
+			//Ran out of a type with sets left, destroyed instead of reused
+			bool retiredEarly;
 
 			~Container(){
 				mgr->_ReleaseContainer(this);
 			}
 		 };
 
+		struct Stats {
+			std::uint32_t poolsCreated;
+			//Pools swapped out because a type or the set count ran out
+			std::uint32_t poolsRetired;
+			//Of those, retired with sets left, a descriptor type ran out
+			std::uint32_t poolsRetiredEarly;
+			std::uint64_t setsAllocated;
+			//Over retired pools, descriptors reserved and actually allocated.
+			//Their difference is the waste, their ratio the utilization.
+			std::uint64_t descriptorsReserved;
+			std::uint64_t descriptorsUsed;
+		};
+
 	private:
+		struct _Pool{
+			VkDescriptorPool pool;
+			DescriptorTypeCounts capacity;
+		};
+
+		//Reset pool waiting for reuse, linked into _recycled
+		struct _FreePool{
+			_Pool pool;
+			_FreePool* next;
+		};
+
+		//Pool chain of the threads mapped to it. Threads get their own
+		//shard up to the shard count, allocations rarely contend.
+		struct _Shard{
+			std::mutex m;
+			//Currently active pool, that is not full.
+			sp<Container> currentPool;
+			//'Clean' pools taken from _recycled
+			std::vector<_Pool> freePools;
+			//Demand not yet merged into _demand
+			DescriptorTypeCounts pendingDemand{};
+			std::uint32_t pendingSets = 0;
+			std::uint64_t setsAllocated = 0;
+		};
+
+		struct _TransientBatch{
+			VkFence fence;
+			std::vector<_TransientDescriptorPool> pools;
+		};
+
+		//Moving histogram of descriptors per set. Shards merge their
+		//demand when they create a pool, older samples decay each time.
+		struct _Demand{
+			std::mutex m;
+			std::array<double, kDescriptorTypeCount> descriptors{};
+			double sets = 0;
+		};
+
 		VkDevice _dev;
 
 		unsigned _maxSets;
 		PoolSizes _poolSizes;
 
-		//'Clean' pools.
-		std::queue<VkDescriptorPool> _freePools;
-		//previously full pools, some sets might be freed, but at least one set is in use.
-		std::unordered_set<Container*> _dirtyPools;
-		//Currently active pool, that is not full.
-		sp<Container> _currentPool;
+		std::unique_ptr<_Shard[]> _shards;
+		unsigned _shardCount = 0;
+
+		//Pools released by any thread, pushed lock-free. Consumers take
+		//the whole list at once so popped nodes are never reused under them.
+		std::atomic<_FreePool*> _recycled{nullptr};
+		//Containers alive, for the DeInit check
+		std::atomic<std::uint32_t> _liveContainers{0};
+
+		_Demand _demand;
+		std::atomic<std::uint32_t> _poolsCreated{0}, _poolsRetired{0}, _poolsRetiredEarly{0};
+		std::atomic<std::uint64_t> _descriptorsReserved{0}, _descriptorsUsed{0};
 
-		std::mutex _m_pool;
+		//Transient pools, recycled once the fence of their batch is signaled
+		std::mutex _m_transient;
+		std::vector<_Pool> _freeTransientPools;
+		std::deque<_TransientBatch> _inFlightTransient;
+		std::vector<VkFence> _freeFences;
 
-		//Thread-safe release
+		//Thread-safe release, lock-free
 		void _ReleaseContainer(Container* container);
 
-		VkDescriptorPool _GetOnePool();
-		VkDescriptorPool _CreatePool();
+		_Shard& _GetShard();
+		//Clean pool with room for counts, must hold the shard's lock
+		_Pool _GetOnePool(_Shard& shard, const DescriptorTypeCounts& counts);
+		//Sized from the demand histogram, room for counts at least
+		_Pool _CreatePool(const DescriptorTypeCounts& counts);
+		void _MergeDemand(const DescriptorTypeCounts& demand, std::uint32_t sets);
+		sp<Container> _Wrap(const _Pool& pool);
+		//Record the utilization of a pool replaced because it was full,
+		//true if it ran out of a type before the set count.
+		bool _Retire(
+			const DescriptorTypeCounts& capacity,
+			const DescriptorTypeCounts& used,
+			std::uint32_t usedSets);
+
+		_TransientDescriptorPool _AcquireTransientPool(const DescriptorTypeCounts& counts);
+		//Must hold _m_transient
+		void _ReturnTransientPool(const _TransientDescriptorPool& pool);
+		//Recycle pools whose submissions are completed, must hold _m_transient
+		void _ReclaimCompletedBatches();
 
 	public:
 		//Must call Init
@@ -87,7 +193,28 @@ namespace Veldrid {
 		void Init(VkDevice dev, unsigned maxSets);
 		void DeInit();
 
-		_DescriptorSet Allocate(VkDescriptorSetLayout layout);
+		//Thread-safe. counts are the descriptors of layout, they drive
+		//the sizing of new pools.
+		_DescriptorSet Allocate(
+			VkDescriptorSetLayout layout, const DescriptorResourceCounts& counts);
+
+		//Allocates from the last of pools, appending a new pool when it
+		//is full. pools belong to one command list, calls on the same
+		//pools must not overlap. Returns a null handle on failure.
+		VkDescriptorSet AllocateTransient(
+			std::vector<_TransientDescriptorPool>& pools,
+			VkDescriptorSetLayout layout, const DescriptorResourceCounts& counts);
+
+		//Return pools that never made it into a submission
+		void ReleaseTransientPools(std::vector<_TransientDescriptorPool>& pools);
+
+		//Fence used to track a submission that references transient pools
+		VkFence AcquireFence();
+
+		//Hand pools over to the manager, reset once fence is signaled
+		void RetireTransientPools(std::vector<_TransientDescriptorPool>& pools, VkFence fence);
+
+		Stats GetStats();
 	};
 
 
@@ -0,0 +1,104 @@
+#include "VkFixupCmdMgr.hpp"
+
+#include <cassert>
+
+#include "VkCommon.hpp"
+
+namespace Veldrid {
+
+    void _FixupCmdMgr::Init(VkDevice dev, std::uint32_t queueFamily) {
+        _dev = dev;
+
+        VkCommandPoolCreateInfo cmdPoolCI{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        cmdPoolCI.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+                        | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        cmdPoolCI.queueFamilyIndex = queueFamily;
+        VK_CHECK(vkCreateCommandPool(_dev, &cmdPoolCI, nullptr, &_pool));
+    }
+
+    void _FixupCmdMgr::DeInit() {
+        for (auto& batch : _inFlightBatches) {
+            vkDestroyFence(_dev, batch.fence, nullptr);
+        }
+        _inFlightBatches.clear();
+
+        for (auto fence : _freeFences) {
+            vkDestroyFence(_dev, fence, nullptr);
+        }
+        _freeFences.clear();
+        _freeCmdBufs.clear();
+
+        //Frees all command buffers allocated from it
+        vkDestroyCommandPool(_dev, _pool, nullptr);
+    }
+
+    void _FixupCmdMgr::_ReclaimCompletedBatches() {
+        while (!_inFlightBatches.empty()) {
+            auto& batch = _inFlightBatches.front();
+            if (vkGetFenceStatus(_dev, batch.fence) != VK_SUCCESS) {
+                break;
+            }
+
+            _freeCmdBufs.insert(_freeCmdBufs.end(), batch.cmdBufs.begin(), batch.cmdBufs.end());
+            VK_CHECK(vkResetFences(_dev, 1, &batch.fence));
+            _freeFences.push_back(batch.fence);
+            _inFlightBatches.pop_front();
+        }
+    }
+
+    VkCommandBuffer _FixupCmdMgr::Record(const _SubmitFixup& fixup) {
+        assert(!fixup.Empty());
+
+        _ReclaimCompletedBatches();
+        VkCommandBuffer cb;
+        if (!_freeCmdBufs.empty()) {
+            cb = _freeCmdBufs.back();
+            _freeCmdBufs.pop_back();
+        } else {
+            VkCommandBufferAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+            allocInfo.commandPool = _pool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            VK_CHECK(vkAllocateCommandBuffers(_dev, &allocInfo, &cb));
+        }
+
+        //Begin implicitly resets the buffer
+        VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK(vkBeginCommandBuffer(cb, &beginInfo));
+
+        vkCmdPipelineBarrier(
+            cb,
+            fixup.srcStages ? fixup.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            fixup.dstStages ? fixup.dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            fixup.bufBarriers.size(), fixup.bufBarriers.data(),
+            fixup.imgBarriers.size(), fixup.imgBarriers.data());
+
+        VK_CHECK(vkEndCommandBuffer(cb));
+        return cb;
+    }
+
+    VkFence _FixupCmdMgr::AcquireFence() {
+        _ReclaimCompletedBatches();
+        if (!_freeFences.empty()) {
+            auto fence = _freeFences.back();
+            _freeFences.pop_back();
+            return fence;
+        }
+
+        VkFenceCreateInfo fenceCI{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+        VkFence fence;
+        VK_CHECK(vkCreateFence(_dev, &fenceCI, nullptr, &fence));
+        return fence;
+    }
+
+    void _FixupCmdMgr::RetireCmdBufs(std::vector<VkCommandBuffer>& cmdBufs, VkFence fence) {
+        assert(fence != VK_NULL_HANDLE);
+
+        _inFlightBatches.push_back({ fence, std::move(cmdBufs) });
+        cmdBufs.clear();
+    }
+
+}
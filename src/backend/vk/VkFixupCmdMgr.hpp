@@ -0,0 +1,67 @@
+#pragma once
+
+#include <volk.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace Veldrid {
+
+    //Barriers needed before a command list can run after the
+    //previously submitted ones.
+    struct _SubmitFixup {
+        std::vector<VkBufferMemoryBarrier> bufBarriers;
+        std::vector<VkImageMemoryBarrier> imgBarriers;
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+
+        bool Empty() const { return bufBarriers.empty() && imgBarriers.empty(); }
+        void Clear() {
+            bufBarriers.clear();
+            imgBarriers.clear();
+            srcStages = 0;
+            dstStages = 0;
+        }
+    };
+
+    //Short command buffers recording submit time fixup barriers.
+    //Recycled once the fence tracking their submission is signaled.
+    //Not thread safe, callers serialize submissions.
+    class _FixupCmdMgr {
+
+        struct _InFlightBatch {
+            VkFence fence;
+            std::vector<VkCommandBuffer> cmdBufs;
+        };
+
+    private:
+        VkDevice _dev;
+        VkCommandPool _pool;
+
+        std::vector<VkCommandBuffer> _freeCmdBufs;
+        std::vector<VkFence> _freeFences;
+        std::deque<_InFlightBatch> _inFlightBatches;
+
+        void _ReclaimCompletedBatches();
+
+    public:
+        //Must call Init
+        _FixupCmdMgr() {}
+        ~_FixupCmdMgr() {}
+
+        void Init(VkDevice dev, std::uint32_t queueFamily);
+        //Device must be idle
+        void DeInit();
+
+        //Record fixup's barriers into a ready to submit command buffer
+        VkCommandBuffer Record(const _SubmitFixup& fixup);
+
+        //Fence used to track a submission that references fixup buffers
+        VkFence AcquireFence();
+
+        //Hand buffers back, recycled once fence is signaled
+        void RetireCmdBufs(std::vector<VkCommandBuffer>& cmdBufs, VkFence fence);
+    };
+
+}
@@ -0,0 +1,171 @@
+#include "VkPipelineCacheMgr.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "VkCommon.hpp"
+
+namespace Veldrid {
+
+    void _PipelineCacheMgr::Init(
+        VkDevice dev, VkPhysicalDevice phyDev,
+        bool supportsFeedback, const std::string& path,
+        const void* initialData, std::size_t initialSize
+    ) {
+        _dev = dev;
+        vkGetPhysicalDeviceProperties(phyDev, &_props);
+        _supportsFeedback = supportsFeedback;
+        _path = path;
+        _created = 0;
+        _hits = 0;
+        _misses = 0;
+        _loadedBytes = 0;
+
+        std::vector<std::uint8_t> data;
+        if (!_path.empty()) {
+            data = _LoadFile();
+            //A blob from another driver or device is at best ignored by
+            //the implementation, don't rely on it.
+            if (!_IsCompatible(data)) {
+                data.clear();
+            }
+        }
+        //The file written by the last run is newer than shipped data
+        if (data.empty() && initialData != nullptr) {
+            auto* bytes = static_cast<const std::uint8_t*>(initialData);
+            data.assign(bytes, bytes + initialSize);
+            if (!_IsCompatible(data)) {
+                data.clear();
+            }
+        }
+
+        VkPipelineCacheCreateInfo cacheCI{};
+        cacheCI.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheCI.initialDataSize = data.size();
+        cacheCI.pInitialData = data.empty() ? nullptr : data.data();
+        if (vkCreatePipelineCache(_dev, &cacheCI, nullptr, &_cache) != VK_SUCCESS) {
+            //Corrupted payload behind a valid header, start empty
+            cacheCI.initialDataSize = 0;
+            cacheCI.pInitialData = nullptr;
+            VK_CHECK(vkCreatePipelineCache(_dev, &cacheCI, nullptr, &_cache));
+            data.clear();
+        }
+        _loadedBytes = data.size();
+    }
+
+    void _PipelineCacheMgr::DeInit() {
+        if (!_path.empty()) {
+            Save();
+        }
+        vkDestroyPipelineCache(_dev, _cache, nullptr);
+        _cache = VK_NULL_HANDLE;
+    }
+
+    std::vector<std::uint8_t> _PipelineCacheMgr::_LoadFile() const {
+        std::ifstream file(_path, std::ios::binary | std::ios::ate);
+        if (!file) return {};
+
+        auto size = file.tellg();
+        if (size <= 0) return {};
+
+        std::vector<std::uint8_t> data(static_cast<std::size_t>(size));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(data.data()), size)) return {};
+        return data;
+    }
+
+    bool _PipelineCacheMgr::_IsCompatible(const std::vector<std::uint8_t>& data) const {
+        //VkPipelineCacheHeaderVersionOne, read field by field as the
+        //blob has no alignment guarantee.
+        constexpr std::size_t headerSize = 16 + VK_UUID_SIZE;
+        if (data.size() < headerSize) return false;
+
+        std::uint32_t fields[4];
+        std::memcpy(fields, data.data(), sizeof(fields));
+        auto length = fields[0];
+        auto version = fields[1];
+        auto vendorID = fields[2];
+        auto deviceID = fields[3];
+
+        return length >= headerSize
+            && length <= data.size()
+            && version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            && vendorID == _props.vendorID
+            && deviceID == _props.deviceID
+            && std::memcmp(data.data() + 16, _props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    const void* _PipelineCacheMgr::AttachFeedback(
+        Feedback& fb, std::uint32_t stageCount, const void* pNext
+    ) {
+        if (!_supportsFeedback) return pNext;
+        assert(stageCount <= sizeof(fb.stages) / sizeof(fb.stages[0]));
+
+        fb.pipeline = {};
+        fb.createInfo = {};
+        fb.createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+        fb.createInfo.pNext = pNext;
+        fb.createInfo.pPipelineCreationFeedback = &fb.pipeline;
+        fb.createInfo.pipelineStageCreationFeedbackCount = stageCount;
+        fb.createInfo.pPipelineStageCreationFeedbacks = fb.stages;
+        return &fb.createInfo;
+    }
+
+    void _PipelineCacheMgr::RecordCreation(const Feedback& fb) {
+        _created.fetch_add(1, std::memory_order_relaxed);
+        if (!_supportsFeedback
+            || !(fb.pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)
+        ) {
+            return;
+        }
+
+        if (fb.pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) {
+            _hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            _misses.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool _PipelineCacheMgr::Save() {
+        if (_path.empty()) return false;
+
+        std::scoped_lock l{ _m_save };
+
+        std::size_t size = 0;
+        if (vkGetPipelineCacheData(_dev, _cache, &size, nullptr) != VK_SUCCESS) return false;
+        std::vector<std::uint8_t> data(size);
+        if (vkGetPipelineCacheData(_dev, _cache, &size, data.data()) != VK_SUCCESS) return false;
+        data.resize(size);
+
+        //Readers never see a partially written cache
+        auto tmpPath = _path + ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!file.write(reinterpret_cast<const char*>(data.data()), data.size())) {
+                return false;
+            }
+            file.close();
+            if (!file) return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, _path, ec);
+        if (ec) {
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+        return true;
+    }
+
+    _PipelineCacheMgr::Stats _PipelineCacheMgr::GetStats() const {
+        Stats stats{};
+        stats.created = _created.load(std::memory_order_relaxed);
+        stats.hits = _hits.load(std::memory_order_relaxed);
+        stats.misses = _misses.load(std::memory_order_relaxed);
+        stats.loadedBytes = _loadedBytes;
+        return stats;
+    }
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <volk.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Veldrid {
+
+    //Device wide VkPipelineCache, optionally persisted to a file so
+    //pipelines compiled by a previous run are reused.
+    class _PipelineCacheMgr {
+
+    public:
+        struct Stats {
+            //Pipelines created through the cache
+            std::uint32_t created;
+            //Creation feedback, only counted when the driver reports it
+            std::uint32_t hits;
+            std::uint32_t misses;
+            //Size of the blob the cache was seeded with, 0 if rejected
+            std::size_t loadedBytes;
+        };
+
+        //Creation feedback of one pipeline, enough stages for any
+        //graphics pipeline.
+        struct Feedback {
+            VkPipelineCreationFeedbackEXT pipeline;
+            VkPipelineCreationFeedbackEXT stages[8];
+            VkPipelineCreationFeedbackCreateInfoEXT createInfo;
+        };
+
+    private:
+        VkDevice _dev;
+        VkPhysicalDeviceProperties _props;
+        bool _supportsFeedback;
+        std::string _path;
+
+        VkPipelineCache _cache;
+
+        std::atomic<std::uint32_t> _created, _hits, _misses;
+        std::size_t _loadedBytes;
+
+        std::mutex _m_save;
+
+        //Read the file at _path, empty if missing or unusable
+        std::vector<std::uint8_t> _LoadFile() const;
+        //Blob was written by the same driver for the same device
+        bool _IsCompatible(const std::vector<std::uint8_t>& data) const;
+
+    public:
+        //Must call Init
+        _PipelineCacheMgr() {}
+        ~_PipelineCacheMgr() {}
+
+        //An empty path keeps the cache in memory only. initialData seeds
+        //the cache when the file is missing or unusable.
+        void Init(
+            VkDevice dev, VkPhysicalDevice phyDev,
+            bool supportsFeedback, const std::string& path,
+            const void* initialData = nullptr, std::size_t initialSize = 0);
+        //Saves the cache if a path was given, no pipeline creation
+        //may be in progress.
+        void DeInit();
+
+        VkPipelineCache GetHandle() const { return _cache; }
+
+        //Returns pNext with creation feedback chained in front when
+        //the driver supports it. fb must outlive the creation call.
+        const void* AttachFeedback(Feedback& fb, std::uint32_t stageCount, const void* pNext);
+        //Count a created pipeline, fb must have been attached
+        void RecordCreation(const Feedback& fb);
+
+        //Write the cache to the path given at Init, through a temporary
+        //file renamed over the old one. Returns false on failure.
+        bool Save();
+
+        Stats GetStats() const;
+    };
+
+}
@@ -0,0 +1,53 @@
+#include "VkPipelineCompilePool.hpp"
+
+namespace Veldrid {
+
+    _PipelineCompilePool::_PipelineCompilePool() : _stop(false) {
+        //Leave a core to the thread waiting on the results
+        auto workerCount = std::thread::hardware_concurrency();
+        workerCount = workerCount > 1 ? workerCount - 1 : 1;
+        for (unsigned i = 0; i < workerCount; i++) {
+            _workers.emplace_back([this]() { _WorkerMain(); });
+        }
+    }
+
+    _PipelineCompilePool::~_PipelineCompilePool() {
+        {
+            std::scoped_lock l{ _m_tasks };
+            _stop = true;
+        }
+        _cv.notify_all();
+        for (auto& worker : _workers) {
+            worker.join();
+        }
+    }
+
+    _PipelineCompilePool& _PipelineCompilePool::Get() {
+        static _PipelineCompilePool pool;
+        return pool;
+    }
+
+    void _PipelineCompilePool::_Enqueue(std::function<void()> task) {
+        {
+            std::scoped_lock l{ _m_tasks };
+            _tasks.push_back(std::move(task));
+        }
+        _cv.notify_one();
+    }
+
+    void _PipelineCompilePool::_WorkerMain() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock l{ _m_tasks };
+                _cv.wait(l, [this]() { return _stop || !_tasks.empty(); });
+                if (_tasks.empty()) return;
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+            //The task and what it captured are released before waiting again
+            task();
+        }
+    }
+
+}
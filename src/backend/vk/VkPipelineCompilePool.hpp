@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Veldrid {
+
+    //Worker threads compiling pipelines off the calling thread. Shared by
+    //every device: tasks keep their device alive, so the last reference
+    //may be dropped on a worker, which must not own the workers then.
+    class _PipelineCompilePool {
+
+        std::vector<std::thread> _workers;
+        std::deque<std::function<void()>> _tasks;
+        std::mutex _m_tasks;
+        std::condition_variable _cv;
+        bool _stop;
+
+        _PipelineCompilePool();
+
+        void _WorkerMain();
+        void _Enqueue(std::function<void()> task);
+
+    public:
+        //Runs the queued tasks before joining
+        ~_PipelineCompilePool();
+
+        //Started on first use, one worker per core but one
+        static _PipelineCompilePool& Get();
+
+        template<typename Fn>
+        auto Submit(Fn&& fn) -> std::future<decltype(fn())> {
+            using Result = decltype(fn());
+            //std::function needs a copyable callable
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+            auto future = task->get_future();
+            _Enqueue([task]() { (*task)(); });
+            return future;
+        }
+    };
+
+}
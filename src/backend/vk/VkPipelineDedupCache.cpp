@@ -0,0 +1,330 @@
+#include "VkPipelineDedupCache.hpp"
+
+#include <cassert>
+
+#include "veldrid/common/Common.hpp"
+
+#include "VulkanPipeline.hpp"
+
+namespace Veldrid {
+
+    static void _HashCombine(std::size_t& seed, std::size_t v) {
+        seed ^= v + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    }
+
+    template<typename T>
+    static void _Hash(std::size_t& seed, const T& v) {
+        _HashCombine(seed, std::hash<T>{}(v));
+    }
+
+    std::size_t HashPipelineDescription(const GraphicsPipelineDescription& desc) {
+        std::size_t h = 0;
+
+        auto& blend = desc.blendState;
+        _Hash(h, blend.blendConstant.r);
+        _Hash(h, blend.blendConstant.g);
+        _Hash(h, blend.blendConstant.b);
+        _Hash(h, blend.blendConstant.a);
+        _Hash(h, blend.alphaToCoverageEnabled);
+        for (auto& att : blend.attachments) {
+            _Hash(h, att.blendEnabled);
+            _Hash(h, att.colorWriteMask.value);
+            _Hash(h, att.sourceColorFactor);
+            _Hash(h, att.destinationColorFactor);
+            _Hash(h, att.colorFunction);
+            _Hash(h, att.sourceAlphaFactor);
+            _Hash(h, att.destinationAlphaFactor);
+            _Hash(h, att.alphaFunction);
+        }
+
+        auto& ds = desc.depthStencilState;
+        _Hash(h, ds.depthTestEnabled);
+        _Hash(h, ds.depthWriteEnabled);
+        _Hash(h, ds.depthComparison);
+        _Hash(h, ds.stencilTestEnabled);
+        for (auto* stencil : { &ds.stencilFront, &ds.stencilBack }) {
+            _Hash(h, stencil->fail);
+            _Hash(h, stencil->pass);
+            _Hash(h, stencil->depthFail);
+            _Hash(h, stencil->comparison);
+        }
+        _Hash(h, ds.stencilReadMask);
+        _Hash(h, ds.stencilWriteMask);
+        _Hash(h, ds.stencilReference);
+
+        auto& rs = desc.rasterizerState;
+        _Hash(h, rs.cullMode);
+        _Hash(h, rs.fillMode);
+        _Hash(h, rs.frontFace);
+        _Hash(h, rs.depthClipEnabled);
+        _Hash(h, rs.scissorTestEnabled);
+
+        _Hash(h, desc.primitiveTopology);
+
+        for (auto& layout : desc.shaderSet.vertexLayouts) {
+            _Hash(h, layout.stride);
+            _Hash(h, layout.instanceStepRate);
+            for (auto& elem : layout.elements) {
+                _Hash(h, elem.name);
+                _Hash(h, elem.semantic);
+                _Hash(h, elem.format);
+                _Hash(h, elem.offset);
+            }
+        }
+        //Shaders and layouts are told apart by identity
+        for (auto& shader : desc.shaderSet.shaders) {
+            _Hash(h, shader.get());
+        }
+        for (auto& spec : desc.shaderSet.specializations) {
+            _Hash(h, spec.id);
+            _Hash(h, spec.type);
+            _Hash(h, spec.data);
+        }
+        for (auto& layout : desc.resourceLayouts) {
+            _Hash(h, layout.get());
+        }
+        for (auto& range : desc.pushConstantRanges) {
+            _Hash(h, range.stages.value);
+            _Hash(h, range.offset);
+            _Hash(h, range.size);
+        }
+
+        auto& outputs = desc.outputs;
+        _Hash(h, outputs.depthAttachment.has_value());
+        if (outputs.depthAttachment.has_value()) {
+            _Hash(h, outputs.depthAttachment->format);
+        }
+        for (auto& att : outputs.colorAttachment) {
+            _Hash(h, att.format);
+        }
+        _Hash(h, outputs.sampleCount);
+
+        _Hash(h, desc.resourceBindingModel != nullptr);
+        if (desc.resourceBindingModel != nullptr) {
+            _Hash(h, *desc.resourceBindingModel);
+        }
+        return h;
+    }
+
+    //Element wise comparison of two vectors
+    template<typename T, typename Fn>
+    static bool _IsSameVec(const std::vector<T>& a, const std::vector<T>& b, Fn&& isSame) {
+        if (a.size() != b.size()) return false;
+        for (std::size_t i = 0; i < a.size(); i++) {
+            if (!isSame(a[i], b[i])) return false;
+        }
+        return true;
+    }
+
+    static bool _IsSameStencil(
+        const DepthStencilStateDescription::StencilBehavior& a,
+        const DepthStencilStateDescription::StencilBehavior& b
+    ) {
+        return a.fail == b.fail && a.pass == b.pass
+            && a.depthFail == b.depthFail && a.comparison == b.comparison;
+    }
+
+    bool IsSamePipelineDescription(
+        const GraphicsPipelineDescription& a, const GraphicsPipelineDescription& b
+    ) {
+        auto& ba = a.blendState;
+        auto& bb = b.blendState;
+        if (ba.blendConstant.r != bb.blendConstant.r
+            || ba.blendConstant.g != bb.blendConstant.g
+            || ba.blendConstant.b != bb.blendConstant.b
+            || ba.blendConstant.a != bb.blendConstant.a
+            || ba.alphaToCoverageEnabled != bb.alphaToCoverageEnabled
+            || !_IsSameVec(ba.attachments, bb.attachments, [](auto& x, auto& y) {
+                return x.blendEnabled == y.blendEnabled
+                    && x.colorWriteMask.value == y.colorWriteMask.value
+                    && x.sourceColorFactor == y.sourceColorFactor
+                    && x.destinationColorFactor == y.destinationColorFactor
+                    && x.colorFunction == y.colorFunction
+                    && x.sourceAlphaFactor == y.sourceAlphaFactor
+                    && x.destinationAlphaFactor == y.destinationAlphaFactor
+                    && x.alphaFunction == y.alphaFunction;
+            })
+        ) {
+            return false;
+        }
+
+        auto& da = a.depthStencilState;
+        auto& db = b.depthStencilState;
+        if (da.depthTestEnabled != db.depthTestEnabled
+            || da.depthWriteEnabled != db.depthWriteEnabled
+            || da.depthComparison != db.depthComparison
+            || da.stencilTestEnabled != db.stencilTestEnabled
+            || !_IsSameStencil(da.stencilFront, db.stencilFront)
+            || !_IsSameStencil(da.stencilBack, db.stencilBack)
+            || da.stencilReadMask != db.stencilReadMask
+            || da.stencilWriteMask != db.stencilWriteMask
+            || da.stencilReference != db.stencilReference
+        ) {
+            return false;
+        }
+
+        auto& ra = a.rasterizerState;
+        auto& rb = b.rasterizerState;
+        if (ra.cullMode != rb.cullMode
+            || ra.fillMode != rb.fillMode
+            || ra.frontFace != rb.frontFace
+            || ra.depthClipEnabled != rb.depthClipEnabled
+            || ra.scissorTestEnabled != rb.scissorTestEnabled
+            || a.primitiveTopology != b.primitiveTopology
+        ) {
+            return false;
+        }
+
+        auto& sa = a.shaderSet;
+        auto& sb = b.shaderSet;
+        if (!_IsSameVec(sa.vertexLayouts, sb.vertexLayouts, [](auto& x, auto& y) {
+                return x.stride == y.stride
+                    && x.instanceStepRate == y.instanceStepRate
+                    && _IsSameVec(x.elements, y.elements, [](auto& ex, auto& ey) {
+                        return ex.name == ey.name && ex.semantic == ey.semantic
+                            && ex.format == ey.format && ex.offset == ey.offset;
+                    });
+            })
+            || !_IsSameVec(sa.shaders, sb.shaders, [](auto& x, auto& y) {
+                return x.get() == y.get();
+            })
+            || !_IsSameVec(sa.specializations, sb.specializations, [](auto& x, auto& y) {
+                return x.id == y.id && x.type == y.type && x.data == y.data;
+            })
+            || !_IsSameVec(a.resourceLayouts, b.resourceLayouts, [](auto& x, auto& y) {
+                return x.get() == y.get();
+            })
+            || !_IsSameVec(a.pushConstantRanges, b.pushConstantRanges, [](auto& x, auto& y) {
+                return x.stages.value == y.stages.value && x.offset == y.offset && x.size == y.size;
+            })
+        ) {
+            return false;
+        }
+
+        auto& oa = a.outputs;
+        auto& ob = b.outputs;
+        if (oa.depthAttachment.has_value() != ob.depthAttachment.has_value()
+            || (oa.depthAttachment.has_value() && oa.depthAttachment->format != ob.depthAttachment->format)
+            || !_IsSameVec(oa.colorAttachment, ob.colorAttachment, [](auto& x, auto& y) {
+                return x.format == y.format;
+            })
+            || oa.sampleCount != ob.sampleCount
+        ) {
+            return false;
+        }
+
+        if ((a.resourceBindingModel == nullptr) != (b.resourceBindingModel == nullptr)) return false;
+        return a.resourceBindingModel == nullptr
+            || *a.resourceBindingModel == *b.resourceBindingModel;
+    }
+
+    void _PipelineDedupCache::DeInit() {
+        assert(_entries.empty());
+    }
+
+    sp<Pipeline> _PipelineDedupCache::_Find(
+        std::size_t hash, const GraphicsPipelineDescription& desc,
+        std::vector<VulkanPipelineBase*>& expired
+    ) {
+        auto range = _entries.equal_range(hash);
+        for (auto it = range.first; it != range.second;) {
+            auto* pipeline = it->second.pipeline;
+            if (!IsSamePipelineDescription(it->second.desc, desc)) {
+                ++it;
+                continue;
+            }
+            if (pipeline->try_ref()) {
+                //Adopt the reference taken by try_ref
+                return sp<Pipeline>(pipeline);
+            }
+            //Being destroyed on another thread, its eviction will find nothing
+            expired.push_back(pipeline);
+            it = _entries.erase(it);
+        }
+        return nullptr;
+    }
+
+    sp<Pipeline> _PipelineDedupCache::Find(
+        std::size_t hash, const GraphicsPipelineDescription& desc
+    ) {
+        std::vector<VulkanPipelineBase*> expired;
+        sp<Pipeline> res;
+        {
+            std::scoped_lock l{ _m_entries };
+            res = _Find(hash, desc, expired);
+        }
+        //Weak references are dropped outside the lock, the last one
+        //destroys the pipeline.
+        for (auto* p : expired) p->weak_unref();
+
+        if (res != nullptr) {
+            _hits.fetch_add(1, std::memory_order_relaxed);
+        }
+        return res;
+    }
+
+    sp<Pipeline> _PipelineDedupCache::Insert(
+        std::size_t hash, const GraphicsPipelineDescription& desc,
+        sp<Pipeline> created
+    ) {
+        auto* vkPipeline = PtrCast<VulkanPipelineBase>(created.get());
+        std::vector<VulkanPipelineBase*> expired;
+
+        sp<Pipeline> res;
+        {
+            std::scoped_lock l{ _m_entries };
+            //Someone else created the same pipeline meanwhile
+            res = _Find(hash, desc, expired);
+            if (res == nullptr) {
+                vkPipeline->weak_ref();
+                vkPipeline->_dedupCache = this;
+                vkPipeline->_dedupHash = hash;
+                auto it = _entries.emplace(hash, _Entry{ desc, {}, vkPipeline });
+                if (desc.resourceBindingModel != nullptr) {
+                    auto& entry = it->second;
+                    entry.bindingModel = *desc.resourceBindingModel;
+                    entry.desc.resourceBindingModel = &entry.bindingModel;
+                }
+                res = std::move(created);
+                _misses.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                //The redundant compile is dropped, the caller is
+                //served from the cache
+                _hits.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        for (auto* p : expired) p->weak_unref();
+
+        return res;
+    }
+
+    sp<Pipeline> _PipelineDedupCache::GetOrCreate(
+        const GraphicsPipelineDescription& desc,
+        const std::function<sp<Pipeline>()>& create
+    ) {
+        auto hash = HashPipelineDescription(desc);
+        if (auto res = Find(hash, desc); res != nullptr) {
+            return res;
+        }
+        //Compile without holding the lock
+        return Insert(hash, desc, create());
+    }
+
+    void _PipelineDedupCache::Evict(const VulkanPipelineBase* pipeline, std::size_t hash) {
+        bool found = false;
+        {
+            std::scoped_lock l{ _m_entries };
+            auto range = _entries.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second.pipeline == pipeline) {
+                    _entries.erase(it);
+                    found = true;
+                    break;
+                }
+            }
+        }
+        //Not the last weak reference, the pipeline holds its own
+        if (found) pipeline->weak_unref();
+    }
+
+}
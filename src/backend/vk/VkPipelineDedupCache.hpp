@@ -0,0 +1,82 @@
+#pragma once
+
+#include "veldrid/common/RefCnt.hpp"
+#include "veldrid/Pipeline.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace Veldrid {
+
+    class VulkanPipelineBase;
+
+    //Hands out the live pipeline created from an identical description
+    //instead of building a new one. Entries only hold weak references,
+    //a pipeline evicts itself when its last user releases it.
+    class _PipelineDedupCache {
+
+    public:
+        struct Stats {
+            std::uint32_t hits;
+            std::uint32_t misses;
+        };
+
+    private:
+        struct _Entry {
+            //Copy used to tell hash collisions apart, its strong references
+            //keep shaders and layouts from being reused at the same address.
+            GraphicsPipelineDescription desc;
+            //desc.resourceBindingModel points here instead of at caller memory
+            ResourceBindingModel bindingModel;
+            VulkanPipelineBase* pipeline;
+        };
+
+        std::unordered_multimap<std::size_t, _Entry> _entries;
+        std::mutex _m_entries;
+
+        std::atomic<std::uint32_t> _hits, _misses;
+
+        //Live pipeline matching desc, must hold the lock.
+        //Expired entries met on the way are dropped into expired.
+        sp<Pipeline> _Find(
+            std::size_t hash, const GraphicsPipelineDescription& desc,
+            std::vector<VulkanPipelineBase*>& expired);
+
+    public:
+        _PipelineDedupCache() : _hits(0), _misses(0) {}
+        ~_PipelineDedupCache() {}
+
+        //Every cached pipeline holds the device, nothing is left by then
+        void DeInit();
+
+        //create is called without holding the lock, identical descriptions
+        //created concurrently may build twice, only one is kept.
+        sp<Pipeline> GetOrCreate(
+            const GraphicsPipelineDescription& desc,
+            const std::function<sp<Pipeline>()>& create);
+
+        //The two halves of GetOrCreate, for callers creating pipelines
+        //in batches. hash is HashPipelineDescription(desc).
+        sp<Pipeline> Find(std::size_t hash, const GraphicsPipelineDescription& desc);
+        //Returns the pipeline to use, an identical one inserted meanwhile
+        //wins over created.
+        sp<Pipeline> Insert(
+            std::size_t hash, const GraphicsPipelineDescription& desc,
+            sp<Pipeline> created);
+
+        //Called by the pipeline once its last strong reference is gone
+        void Evict(const VulkanPipelineBase* pipeline, std::size_t hash);
+
+        Stats GetStats() const {
+            return { _hits.load(std::memory_order_relaxed), _misses.load(std::memory_order_relaxed) };
+        }
+    };
+
+    std::size_t HashPipelineDescription(const GraphicsPipelineDescription& desc);
+    bool IsSamePipelineDescription(
+        const GraphicsPipelineDescription& a, const GraphicsPipelineDescription& b);
+
+}
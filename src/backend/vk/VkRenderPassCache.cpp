@@ -0,0 +1,131 @@
+#include "VkRenderPassCache.hpp"
+
+#include <cassert>
+
+#include "VkCommon.hpp"
+
+namespace Veldrid {
+
+    static void _HashCombine(std::size_t& seed, std::size_t v) {
+        seed ^= v + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    }
+
+    bool _RenderPassKey::operator==(const _RenderPassKey& other) const {
+        if (hasDepth != other.hasDepth || attachments.size() != other.attachments.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < attachments.size(); i++) {
+            auto& a = attachments[i];
+            auto& b = other.attachments[i];
+            if (a.flags != b.flags
+                || a.format != b.format
+                || a.samples != b.samples
+                || a.loadOp != b.loadOp
+                || a.storeOp != b.storeOp
+                || a.stencilLoadOp != b.stencilLoadOp
+                || a.stencilStoreOp != b.stencilStoreOp
+                || a.initialLayout != b.initialLayout
+                || a.finalLayout != b.finalLayout
+            ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::size_t _RenderPassKeyHash::operator()(const _RenderPassKey& key) const {
+        std::size_t h = key.hasDepth;
+        for (auto& att : key.attachments) {
+            _HashCombine(h, att.flags);
+            _HashCombine(h, att.format);
+            _HashCombine(h, att.samples);
+            _HashCombine(h, att.loadOp);
+            _HashCombine(h, att.storeOp);
+            _HashCombine(h, att.stencilLoadOp);
+            _HashCombine(h, att.stencilStoreOp);
+            _HashCombine(h, att.initialLayout);
+            _HashCombine(h, att.finalLayout);
+        }
+        return h;
+    }
+
+    void _RenderPassCache::Init(VkDevice dev) {
+        _dev = dev;
+        _hits = 0;
+    }
+
+    void _RenderPassCache::DeInit() {
+        std::scoped_lock l{ _m_passes };
+        for (auto& [key, pass] : _passes) {
+            vkDestroyRenderPass(_dev, pass, nullptr);
+        }
+        _passes.clear();
+    }
+
+    VkRenderPass _RenderPassCache::_Create(const _RenderPassKey& key) const {
+        unsigned attachmentCount = key.attachments.size();
+        unsigned colorAttachmentCount = key.hasDepth ? attachmentCount - 1 : attachmentCount;
+        assert(!key.hasDepth || attachmentCount > 0);
+
+        std::vector<VkAttachmentReference> colorAttachmentRefs(colorAttachmentCount);
+        for (unsigned i = 0; i < colorAttachmentCount; i++) {
+            colorAttachmentRefs[i].attachment = i;
+            colorAttachmentRefs[i].layout = VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = colorAttachmentCount;
+        depthAttachmentRef.layout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS;
+        if (colorAttachmentCount > 0) {
+            subpass.colorAttachmentCount = colorAttachmentCount;
+            subpass.pColorAttachments = colorAttachmentRefs.data();
+        }
+        if (key.hasDepth) {
+            subpass.pDepthStencilAttachment = &depthAttachmentRef;
+        }
+
+        VkSubpassDependency subpassDependency{};
+        subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        subpassDependency.srcStageMask = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        subpassDependency.dstStageMask = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        subpassDependency.dstAccessMask
+            = VkAccessFlagBits::VK_ACCESS_COLOR_ATTACHMENT_READ_BIT
+            | VkAccessFlagBits::VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+        VkRenderPassCreateInfo renderPassCI{};
+        renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassCI.attachmentCount = attachmentCount;
+        renderPassCI.pAttachments = key.attachments.data();
+        renderPassCI.subpassCount = 1;
+        renderPassCI.pSubpasses = &subpass;
+        renderPassCI.dependencyCount = 1;
+        renderPassCI.pDependencies = &subpassDependency;
+
+        VkRenderPass renderPass;
+        VK_CHECK(vkCreateRenderPass(_dev, &renderPassCI, nullptr, &renderPass));
+        return renderPass;
+    }
+
+    VkRenderPass _RenderPassCache::Get(const _RenderPassKey& key) {
+        std::scoped_lock l{ _m_passes };
+        auto it = _passes.find(key);
+        if (it != _passes.end()) {
+            _hits.fetch_add(1, std::memory_order_relaxed);
+            return it->second;
+        }
+        //Creation is cheap next to a pipeline compile, keep it under
+        //the lock so a pass is never created twice.
+        auto pass = _Create(key);
+        _passes.emplace(key, pass);
+        return pass;
+    }
+
+    _RenderPassCache::Stats _RenderPassCache::GetStats() {
+        std::scoped_lock l{ _m_passes };
+        return { static_cast<std::uint32_t>(_passes.size()), _hits.load(std::memory_order_relaxed) };
+    }
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <volk.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Veldrid {
+
+    //Everything a single subpass render pass is created from. Color
+    //attachments come first, followed by the depth attachment if any.
+    struct _RenderPassKey {
+        std::vector<VkAttachmentDescription> attachments;
+        bool hasDepth = false;
+
+        bool operator==(const _RenderPassKey& other) const;
+    };
+
+    struct _RenderPassKeyHash {
+        std::size_t operator()(const _RenderPassKey& key) const;
+    };
+
+    //Device wide render passes shared by framebuffers and pipelines,
+    //created on first request and kept until the device is destroyed.
+    class _RenderPassCache {
+
+    public:
+        struct Stats {
+            std::uint32_t created;
+            std::uint32_t hits;
+        };
+
+    private:
+        VkDevice _dev;
+
+        std::unordered_map<_RenderPassKey, VkRenderPass, _RenderPassKeyHash> _passes;
+        std::mutex _m_passes;
+
+        std::atomic<std::uint32_t> _hits;
+
+        VkRenderPass _Create(const _RenderPassKey& key) const;
+
+    public:
+        //Must call Init
+        _RenderPassCache() : _hits(0) {}
+        ~_RenderPassCache() {}
+
+        void Init(VkDevice dev);
+        //No framebuffer or pipeline may use the passes anymore
+        void DeInit();
+
+        VkRenderPass Get(const _RenderPassKey& key);
+
+        Stats GetStats();
+    };
+
+}
@@ -0,0 +1,108 @@
+#include "VkResourceLayoutCache.hpp"
+
+#include <cassert>
+
+#include "veldrid/common/Common.hpp"
+
+#include "VulkanBindableResource.hpp"
+
+namespace Veldrid {
+
+    static void _HashCombine(std::size_t& seed, std::size_t v) {
+        seed ^= v + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    }
+
+    std::size_t HashResourceLayoutDescription(const ResourceLayout::Description& desc) {
+        std::size_t h = desc.elements.size();
+        for (auto& elem : desc.elements) {
+            _HashCombine(h, std::hash<std::string>{}(elem.name));
+            _HashCombine(h, static_cast<std::size_t>(elem.kind));
+            _HashCombine(h, elem.stages.value);
+            _HashCombine(h, elem.options.value);
+        }
+        return h;
+    }
+
+    bool IsSameResourceLayoutDescription(
+        const ResourceLayout::Description& a, const ResourceLayout::Description& b
+    ) {
+        if (a.elements.size() != b.elements.size()) return false;
+        for (std::size_t i = 0; i < a.elements.size(); i++) {
+            auto& x = a.elements[i];
+            auto& y = b.elements[i];
+            //Names are kept so GetDesc() stays exactly what was asked for
+            if (x.name != y.name
+                || x.kind != y.kind
+                || x.stages.value != y.stages.value
+                || x.options.value != y.options.value
+            ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void _ResourceLayoutCache::DeInit() {
+        assert(_entries.empty());
+    }
+
+    sp<ResourceLayout> _ResourceLayoutCache::GetOrCreate(
+        const ResourceLayout::Description& desc,
+        const std::function<sp<ResourceLayout>()>& create
+    ) {
+        auto hash = HashResourceLayoutDescription(desc);
+        std::vector<VulkanResourceLayout*> expired;
+
+        sp<ResourceLayout> res;
+        {
+            std::scoped_lock l{ _m_entries };
+            auto range = _entries.equal_range(hash);
+            for (auto it = range.first; it != range.second;) {
+                auto* layout = it->second.layout;
+                if (!IsSameResourceLayoutDescription(it->second.desc, desc)) {
+                    ++it;
+                    continue;
+                }
+                if (layout->try_ref()) {
+                    //Adopt the reference taken by try_ref
+                    res = sp<ResourceLayout>(layout);
+                    break;
+                }
+                //Being destroyed on another thread, its eviction will find nothing
+                expired.push_back(layout);
+                it = _entries.erase(it);
+            }
+
+            if (res == nullptr) {
+                res = create();
+                auto* vkLayout = PtrCast<VulkanResourceLayout>(res.get());
+                vkLayout->weak_ref();
+                vkLayout->_cache = this;
+                vkLayout->_cacheHash = hash;
+                _entries.emplace(hash, _Entry{ desc, vkLayout });
+            }
+        }
+        //Weak references are dropped outside the lock, the last one
+        //destroys the layout.
+        for (auto* l : expired) l->weak_unref();
+        return res;
+    }
+
+    void _ResourceLayoutCache::Evict(const VulkanResourceLayout* layout, std::size_t hash) {
+        bool found = false;
+        {
+            std::scoped_lock l{ _m_entries };
+            auto range = _entries.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second.layout == layout) {
+                    _entries.erase(it);
+                    found = true;
+                    break;
+                }
+            }
+        }
+        //Not the last weak reference, the layout holds its own
+        if (found) layout->weak_unref();
+    }
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "veldrid/common/RefCnt.hpp"
+#include "veldrid/BindableResource.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Veldrid {
+
+    class VulkanResourceLayout;
+
+    //Hands out the live layout created from an identical description.
+    //Entries only hold weak references like _PipelineDedupCache, a
+    //layout evicts itself when its last user releases it.
+    class _ResourceLayoutCache {
+
+        struct _Entry {
+            ResourceLayout::Description desc;
+            VulkanResourceLayout* layout;
+        };
+
+        std::unordered_multimap<std::size_t, _Entry> _entries;
+        std::mutex _m_entries;
+
+    public:
+        _ResourceLayoutCache() {}
+        ~_ResourceLayoutCache() {}
+
+        //Every cached layout holds the device, nothing is left by then
+        void DeInit();
+
+        //Set layouts are cheap to create, create runs under the lock
+        sp<ResourceLayout> GetOrCreate(
+            const ResourceLayout::Description& desc,
+            const std::function<sp<ResourceLayout>()>& create);
+
+        //Called by the layout once its last strong reference is gone
+        void Evict(const VulkanResourceLayout* layout, std::size_t hash);
+    };
+
+    std::size_t HashResourceLayoutDescription(const ResourceLayout::Description& desc);
+    bool IsSameResourceLayoutDescription(
+        const ResourceLayout::Description& a, const ResourceLayout::Description& b);
+
+}
@@ -0,0 +1,153 @@
+#include "VkResourceSetCache.hpp"
+
+#include <cassert>
+
+#include "veldrid/common/Common.hpp"
+#include "veldrid/Buffer.hpp"
+
+#include "VulkanBindableResource.hpp"
+
+namespace Veldrid {
+
+    static void _HashCombine(std::size_t& seed, std::size_t v) {
+        seed ^= v + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    }
+
+    static bool _IsBufferKind(ResourceLayout::Description::ElementDescription::ResourceKind kind) {
+        using _ResKind = ResourceLayout::Description::ElementDescription::ResourceKind;
+        return kind == _ResKind::UniformBuffer
+            || kind == _ResKind::StructuredBufferReadOnly
+            || kind == _ResKind::StructuredBufferReadWrite;
+    }
+
+    std::size_t HashResourceSetDescription(const ResourceSet::Description& desc) {
+        std::size_t h = std::hash<const void*>{}(desc.layout.get());
+        auto& elements = desc.layout->GetDesc().elements;
+        assert(desc.boundResources.size() == elements.size());
+        for (std::size_t i = 0; i < desc.boundResources.size(); i++) {
+            auto* res = desc.boundResources[i].get();
+            if (_IsBufferKind(elements[i].kind)) {
+                //Ranges are usually made on the fly, look through them
+                auto* range = PtrCast<BufferRange>(res);
+                _HashCombine(h, std::hash<const void*>{}(range->GetBufferObject()));
+                _HashCombine(h, range->GetOffsetInBytes());
+                _HashCombine(h, range->GetSizeInBytes());
+            } else {
+                _HashCombine(h, std::hash<const void*>{}(res));
+            }
+        }
+        return h;
+    }
+
+    bool IsSameResourceSetDescription(
+        const ResourceSet::Description& a, const ResourceSet::Description& b
+    ) {
+        if (a.layout.get() != b.layout.get()
+            || a.boundResources.size() != b.boundResources.size()
+        ) {
+            return false;
+        }
+        auto& elements = a.layout->GetDesc().elements;
+        for (std::size_t i = 0; i < a.boundResources.size(); i++) {
+            auto* x = a.boundResources[i].get();
+            auto* y = b.boundResources[i].get();
+            if (x == y) continue;
+            if (!_IsBufferKind(elements[i].kind)) return false;
+
+            auto* rx = PtrCast<BufferRange>(x);
+            auto* ry = PtrCast<BufferRange>(y);
+            if (rx->GetBufferObject() != ry->GetBufferObject()
+                || rx->GetOffsetInBytes() != ry->GetOffsetInBytes()
+                || rx->GetSizeInBytes() != ry->GetSizeInBytes()
+            ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void _ResourceSetCache::DeInit() {
+        assert(_entries.empty());
+    }
+
+    sp<ResourceSet> _ResourceSetCache::_Find(
+        std::size_t hash, const ResourceSet::Description& desc,
+        std::vector<VulkanResourceSet*>& expired
+    ) {
+        auto range = _entries.equal_range(hash);
+        for (auto it = range.first; it != range.second;) {
+            auto* set = it->second;
+            if (!IsSameResourceSetDescription(set->GetDesc(), desc)) {
+                ++it;
+                continue;
+            }
+            if (set->try_ref()) {
+                //Adopt the reference taken by try_ref
+                return sp<ResourceSet>(set);
+            }
+            //Being destroyed on another thread, its eviction will find nothing
+            expired.push_back(set);
+            it = _entries.erase(it);
+        }
+        return nullptr;
+    }
+
+    sp<ResourceSet> _ResourceSetCache::GetOrCreate(
+        const ResourceSet::Description& desc,
+        const std::function<sp<ResourceSet>()>& create
+    ) {
+        auto hash = HashResourceSetDescription(desc);
+        std::vector<VulkanResourceSet*> expired;
+
+        sp<ResourceSet> res;
+        {
+            std::scoped_lock l{ _m_entries };
+            res = _Find(hash, desc, expired);
+        }
+        if (res != nullptr) {
+            for (auto* s : expired) s->weak_unref();
+            _hits.fetch_add(1, std::memory_order_relaxed);
+            return res;
+        }
+
+        //Allocate and write the descriptors without holding the lock
+        auto created = create();
+        auto* vkSet = PtrCast<VulkanResourceSet>(created.get());
+        {
+            std::scoped_lock l{ _m_entries };
+            //Someone else created the same set meanwhile
+            res = _Find(hash, desc, expired);
+            if (res == nullptr) {
+                vkSet->weak_ref();
+                vkSet->_cache = this;
+                vkSet->_cacheHash = hash;
+                _entries.emplace(hash, vkSet);
+                res = std::move(created);
+            }
+        }
+        //Weak references are dropped outside the lock, the last one
+        //destroys the set.
+        for (auto* s : expired) s->weak_unref();
+
+        _misses.fetch_add(1, std::memory_order_relaxed);
+        return res;
+    }
+
+    void _ResourceSetCache::Evict(const VulkanResourceSet* set, std::size_t hash) {
+        bool found = false;
+        {
+            std::scoped_lock l{ _m_entries };
+            auto range = _entries.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == set) {
+                    _entries.erase(it);
+                    found = true;
+                    break;
+                }
+            }
+        }
+        //Not the last weak reference, the set holds its own
+        if (found) set->weak_unref();
+    }
+
+}
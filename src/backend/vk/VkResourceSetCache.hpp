@@ -0,0 +1,70 @@
+#pragma once
+
+#include "veldrid/common/RefCnt.hpp"
+#include "veldrid/BindableResource.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Veldrid {
+
+    class VulkanResourceSet;
+
+    //Hands out the live set with the same layout and bound resources
+    //instead of allocating and writing a new descriptor set. Entries only
+    //hold weak references, a set evicts itself when its last user releases
+    //it. A set keeps its resources alive, none can die before its entry.
+    class _ResourceSetCache {
+
+    public:
+        struct Stats {
+            std::uint32_t hits;
+            std::uint32_t misses;
+        };
+
+    private:
+        //The key is read from the set's own description, which stays
+        //valid while the entry holds its weak reference.
+        std::unordered_multimap<std::size_t, VulkanResourceSet*> _entries;
+        std::mutex _m_entries;
+
+        std::atomic<std::uint32_t> _hits, _misses;
+
+        //Live set matching desc, must hold the lock.
+        //Expired entries met on the way are dropped into expired.
+        sp<ResourceSet> _Find(
+            std::size_t hash, const ResourceSet::Description& desc,
+            std::vector<VulkanResourceSet*>& expired);
+
+    public:
+        _ResourceSetCache() : _hits(0), _misses(0) {}
+        ~_ResourceSetCache() {}
+
+        //Every cached set holds the device, nothing is left by then
+        void DeInit();
+
+        //create is called without holding the lock, identical descriptions
+        //created concurrently may write two sets, only one is kept.
+        sp<ResourceSet> GetOrCreate(
+            const ResourceSet::Description& desc,
+            const std::function<sp<ResourceSet>()>& create);
+
+        //Called by the set once its last strong reference is gone
+        void Evict(const VulkanResourceSet* set, std::size_t hash);
+
+        Stats GetStats() const {
+            return { _hits.load(std::memory_order_relaxed), _misses.load(std::memory_order_relaxed) };
+        }
+    };
+
+    //Buffer ranges compare by buffer, offset and size, other resources
+    //by identity. Layouts are shared by the layout cache, compared by identity.
+    std::size_t HashResourceSetDescription(const ResourceSet::Description& desc);
+    bool IsSameResourceSetDescription(
+        const ResourceSet::Description& a, const ResourceSet::Description& b);
+
+}
@@ -0,0 +1,148 @@
+#include "VkStagingBufferMgr.hpp"
+
+#include <cassert>
+
+#include "VkCommon.hpp"
+
+namespace Veldrid {
+
+    //Keep at most this many idle blocks around, the rest are freed.
+    static constexpr unsigned MAX_FREE_STAGING_BLOCKS = 16;
+
+    void _StagingBufferMgr::Init(VkDevice dev, VmaAllocator allocator, VkDeviceSize blockSize) {
+        _dev = dev;
+        _allocator = allocator;
+        _blockSize = blockSize;
+    }
+
+    void _StagingBufferMgr::DeInit() {
+        for (auto& batch : _inFlightBatches) {
+            for (auto& block : batch.blocks) {
+                _DestroyBlock(block);
+            }
+            vkDestroyFence(_dev, batch.fence, nullptr);
+        }
+        _inFlightBatches.clear();
+
+        for (auto& block : _freeBlocks) {
+            _DestroyBlock(block);
+        }
+        _freeBlocks.clear();
+
+        for (auto fence : _freeFences) {
+            vkDestroyFence(_dev, fence, nullptr);
+        }
+        _freeFences.clear();
+    }
+
+    _StagingBlock _StagingBufferMgr::_CreateBlock(VkDeviceSize size) {
+        VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT
+            | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+        allocInfo.requiredFlags =
+              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+            | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+        _StagingBlock block{};
+        VmaAllocationInfo allocResult{};
+        VK_CHECK(vmaCreateBuffer(
+            _allocator, &bufferInfo, &allocInfo,
+            &block.buffer, &block.allocation, &allocResult));
+
+        block.mappedData = static_cast<std::uint8_t*>(allocResult.pMappedData);
+        block.size = size;
+        block.usedSize = 0;
+        return block;
+    }
+
+    void _StagingBufferMgr::_DestroyBlock(const _StagingBlock& block) {
+        vmaDestroyBuffer(_allocator, block.buffer, block.allocation);
+    }
+
+    void _StagingBufferMgr::_ReturnBlock(_StagingBlock& block) {
+        //Oversized blocks are one-shot
+        if (block.size != _blockSize || _freeBlocks.size() >= MAX_FREE_STAGING_BLOCKS) {
+            _DestroyBlock(block);
+            return;
+        }
+        block.usedSize = 0;
+        _freeBlocks.push_back(block);
+    }
+
+    void _StagingBufferMgr::_ReclaimCompletedBatches() {
+        //Submissions on the same queue retire in order,
+        //stop at the first one still pending.
+        while (!_inFlightBatches.empty()) {
+            auto& batch = _inFlightBatches.front();
+            if (vkGetFenceStatus(_dev, batch.fence) != VK_SUCCESS) {
+                break;
+            }
+
+            for (auto& block : batch.blocks) {
+                _ReturnBlock(block);
+            }
+            VK_CHECK(vkResetFences(_dev, 1, &batch.fence));
+            _freeFences.push_back(batch.fence);
+            _inFlightBatches.pop_front();
+        }
+    }
+
+    _StagingBlock _StagingBufferMgr::AcquireBlock(VkDeviceSize minSize) {
+        if (minSize > _blockSize) {
+            return _CreateBlock(minSize);
+        }
+
+        {
+            std::scoped_lock l{ _m_blocks };
+            _ReclaimCompletedBatches();
+            if (!_freeBlocks.empty()) {
+                auto block = _freeBlocks.back();
+                _freeBlocks.pop_back();
+                return block;
+            }
+        }
+
+        return _CreateBlock(_blockSize);
+    }
+
+    void _StagingBufferMgr::ReleaseBlocks(std::vector<_StagingBlock>& blocks) {
+        if (blocks.empty()) return;
+
+        std::scoped_lock l{ _m_blocks };
+        for (auto& block : blocks) {
+            _ReturnBlock(block);
+        }
+        blocks.clear();
+    }
+
+    VkFence _StagingBufferMgr::AcquireFence() {
+        {
+            std::scoped_lock l{ _m_blocks };
+            _ReclaimCompletedBatches();
+            if (!_freeFences.empty()) {
+                auto fence = _freeFences.back();
+                _freeFences.pop_back();
+                return fence;
+            }
+        }
+
+        VkFenceCreateInfo fenceCI{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+        VkFence fence;
+        VK_CHECK(vkCreateFence(_dev, &fenceCI, nullptr, &fence));
+        return fence;
+    }
+
+    void _StagingBufferMgr::RetireBlocks(std::vector<_StagingBlock>& blocks, VkFence fence) {
+        assert(fence != VK_NULL_HANDLE);
+
+        std::scoped_lock l{ _m_blocks };
+        _inFlightBatches.push_back({ fence, std::move(blocks) });
+        blocks.clear();
+    }
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include "veldrid/common/Macros.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <mutex>
+
+namespace Veldrid {
+
+    //One persistently mapped, host visible chunk of upload memory.
+    //Command lists suballocate linearly from it.
+    struct _StagingBlock {
+        VkBuffer buffer;
+        VmaAllocation allocation;
+        std::uint8_t* mappedData;
+        VkDeviceSize size;
+        VkDeviceSize usedSize;
+    };
+
+    //Pool of staging blocks shared by all command lists of a device.
+    //Blocks used by a submission are only recycled after the fence
+    //tracking that submission is signaled.
+    class _StagingBufferMgr {
+
+        struct _InFlightBatch {
+            VkFence fence;
+            std::vector<_StagingBlock> blocks;
+        };
+
+    private:
+        VkDevice _dev;
+        VmaAllocator _allocator;
+        VkDeviceSize _blockSize;
+
+        std::vector<_StagingBlock> _freeBlocks;
+        std::deque<_InFlightBatch> _inFlightBatches;
+        std::vector<VkFence> _freeFences;
+
+        std::mutex _m_blocks;
+
+        _StagingBlock _CreateBlock(VkDeviceSize size);
+        void _DestroyBlock(const _StagingBlock& block);
+        //Recycle blocks whose submissions are completed, must hold the lock
+        void _ReclaimCompletedBatches();
+        void _ReturnBlock(_StagingBlock& block);
+
+    public:
+        //Must call Init
+        _StagingBufferMgr() {}
+        ~_StagingBufferMgr() {}
+
+        void Init(VkDevice dev, VmaAllocator allocator, VkDeviceSize blockSize);
+        //Device must be idle
+        void DeInit();
+
+        VkDeviceSize GetBlockSize() const { return _blockSize; }
+
+        //Get a clean block with at least minSize bytes available
+        _StagingBlock AcquireBlock(VkDeviceSize minSize);
+
+        //Return blocks that never made it into a submission
+        void ReleaseBlocks(std::vector<_StagingBlock>& blocks);
+
+        //Fence used to track a submission that references staging blocks
+        VkFence AcquireFence();
+
+        //Hand blocks over to the manager, recycled once fence is signaled
+        void RetireBlocks(std::vector<_StagingBlock>& blocks, VkFence fence);
+    };
+
+}
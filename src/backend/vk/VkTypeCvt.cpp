@@ -361,6 +361,17 @@ namespace Veldrid {
         return VkShaderStageFlagBits::VK_SHADER_STAGE_ALL;
     }
 
+    VkPipelineStageFlags VdToVkPipelineStages(Shader::Description::Stage stage) {
+        VkPipelineStageFlags flag = 0;
+        if (stage.vertex)                 flag |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+        if (stage.geometry)               flag |= VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+        if (stage.tessellationControl)    flag |= VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT;
+        if (stage.tessellationEvaluation) flag |= VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT;
+        if (stage.fragment)               flag |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        if (stage.compute)                flag |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        return flag;
+    }
+
      
     VkBorderColor VdToVkSamplerBorderColor(Sampler::Description::BorderColor borderColor)
     {
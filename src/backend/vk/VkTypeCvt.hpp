@@ -47,6 +47,9 @@ namespace Veldrid {
 
     VkShaderStageFlagBits VdToVkShaderStageSingle(
         Shader::Description::Stage stage);
+
+    VkPipelineStageFlags VdToVkPipelineStages(
+        Shader::Description::Stage stage);
      
     VkBorderColor VdToVkSamplerBorderColor(Sampler::Description::BorderColor borderColor);
 
@@ -2,43 +2,50 @@
 
 #include "veldrid/common/Common.hpp"
 
+#include <array>
 #include <vector>
 
 #include "VkTypeCvt.hpp"
 #include "VkCommon.hpp"
 #include "VulkanDevice.hpp"
 #include "VulkanTexture.hpp"
+#include "VkResourceLayoutCache.hpp"
+#include "VkResourceSetCache.hpp"
 
 namespace Veldrid
 {
-    VkDescriptorType VdToVkResourceKind(ResourceLayout::Description::ElementDescription::ResourceKind kind){
-        using _ResKind = ResourceLayout::Description::ElementDescription::ResourceKind;
-        switch (kind)
-        {
-        case _ResKind::UniformBuffer: return VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        case _ResKind::StructuredBufferReadOnly: return VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        case _ResKind::StructuredBufferReadWrite: return VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
-        case _ResKind::TextureReadOnly: return VkDescriptorType::VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-        case _ResKind::TextureReadWrite: return VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-        case _ResKind::Sampler: return VkDescriptorType::VK_DESCRIPTOR_TYPE_SAMPLER;
-        default:return VkDescriptorType::VK_DESCRIPTOR_TYPE_MAX_ENUM;
-        }
-    }
-
     VulkanResourceLayout::~VulkanResourceLayout(){
         auto vkDev = PtrCast<VulkanDevice>(dev.get());
+        if (_updateTemplate != VK_NULL_HANDLE) {
+            vkDestroyDescriptorUpdateTemplateKHR(vkDev->LogicalDev(), _updateTemplate, nullptr);
+        }
         vkDestroyDescriptorSetLayout(vkDev->LogicalDev(), _dsl, nullptr);
     }
     
+    void VulkanResourceLayout::weak_dispose() const {
+        if (_cache != nullptr) {
+            _cache->Evict(this, _cacheHash);
+        }
+    }
+
     sp<ResourceLayout> VulkanResourceLayout::Make(
         const sp<VulkanDevice>& dev,
         const Description& desc
+    ){
+        return dev->ResourceLayoutCache().GetOrCreate(desc, [&]() {
+            return _Create(dev, desc);
+        });
+    }
+
+    sp<ResourceLayout> VulkanResourceLayout::_Create(
+        const sp<VulkanDevice>& dev,
+        const Description& desc
     ){
         VkDescriptorSetLayoutCreateInfo dslCI{};
         dslCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 
         auto& elements = desc.elements;
-        std::vector<VkDescriptorType> _descriptorTypes {elements.size()};
+        std::vector<VkDescriptorType> descriptorTypes {elements.size()};
         std::vector<VkDescriptorSetLayoutBinding> bindings {elements.size()};
 
         std::uint32_t uniformBufferCount = 0;
@@ -62,7 +69,7 @@ namespace Veldrid
                 dynamicBufferCount += 1;
             }
 
-            _descriptorTypes[i] = descriptorType;
+            descriptorTypes[i] = descriptorType;
 
             switch (descriptorType)
             {
@@ -110,6 +117,28 @@ namespace Veldrid
         dsl->_dynamicBufferCount = dynamicBufferCount;
         dsl->_drcs = drcs;
 
+        if (dev->SupportsUpdateTemplate() && !elements.empty()) {
+            std::vector<VkDescriptorUpdateTemplateEntryKHR> entries(elements.size());
+            for (unsigned i = 0; i < elements.size(); i++) {
+                entries[i].dstBinding = i;
+                entries[i].dstArrayElement = 0;
+                entries[i].descriptorCount = 1;
+                entries[i].descriptorType = descriptorTypes[i];
+                entries[i].offset = i * sizeof(_DescriptorInfo);
+                entries[i].stride = sizeof(_DescriptorInfo);
+            }
+
+            VkDescriptorUpdateTemplateCreateInfoKHR templateCI{};
+            templateCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+            templateCI.descriptorUpdateEntryCount = static_cast<std::uint32_t>(entries.size());
+            templateCI.pDescriptorUpdateEntries = entries.data();
+            templateCI.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+            templateCI.descriptorSetLayout = rawDsl;
+            VK_CHECK(vkCreateDescriptorUpdateTemplateKHR(
+                dev->LogicalDev(), &templateCI, nullptr, &dsl->_updateTemplate));
+        }
+        dsl->_descriptorTypes = std::move(descriptorTypes);
+
         return sp<ResourceLayout>(dsl);
     }
 
@@ -118,36 +147,89 @@ namespace Veldrid
 
     }
 
+    void VulkanResourceSet::weak_dispose() const {
+        if (_cache != nullptr) {
+            _cache->Evict(this, _cacheHash);
+        }
+    }
+
     sp<ResourceSet> VulkanResourceSet::Make(
             const sp<VulkanDevice>& dev,
             const Description& desc
     ){
-        VulkanResourceLayout* vkLayout = reinterpret_cast<VulkanResourceLayout*>(desc.layout.get());
+        return dev->ResourceSetCache().GetOrCreate(desc, [&]() {
+            auto* vkLayout = PtrCast<VulkanResourceLayout>(desc.layout.get());
+            return _Create(dev, desc, dev->AllocateDescriptorSet(
+                vkLayout->GetHandle(), vkLayout->GetResourceCounts()));
+        });
+    }
 
-        VkDescriptorSetLayout dsl = vkLayout->GetHandle();
-        //_descriptorCounts = vkLayout.DescriptorResourceCounts;
-        auto descriptorAllocationToken = dev->AllocateDescriptorSet(dsl);
+    sp<ResourceSet> VulkanResourceSet::MakeTransient(
+            const sp<VulkanDevice>& dev,
+            const Description& desc,
+            VkDescriptorSet set
+    ){
+        //The pool is reset as a whole, the set holds no reference to it
+        return _Create(dev, desc, _DescriptorSet(nullptr, set));
+    }
+
+    sp<ResourceSet> VulkanResourceSet::_Create(
+            const sp<VulkanDevice>& dev,
+            const Description& desc,
+            _DescriptorSet&& descriptorAllocationToken
+    ){
+        VulkanResourceLayout* vkLayout = reinterpret_cast<VulkanResourceLayout*>(desc.layout.get());
 
         auto& boundResources = desc.boundResources;
         auto descriptorWriteCount = boundResources.size();
-        std::vector<VkWriteDescriptorSet> descriptorWrites(descriptorWriteCount);
-        std::vector<VkDescriptorBufferInfo> bufferInfos(descriptorWriteCount);
-        std::vector<VkDescriptorImageInfo> imageInfos(descriptorWriteCount);
-
         assert(descriptorWriteCount == vkLayout->GetDesc().elements.size());
 
+        //Packed in the order the update template reads them,
+        //typical sets fit on the stack.
+        constexpr std::size_t kInlineInfoCount = 16;
+        std::array<_DescriptorInfo, kInlineInfoCount> inlineInfos{};
+        std::vector<_DescriptorInfo> heapInfos;
+        _DescriptorInfo* infos = inlineInfos.data();
+        if (descriptorWriteCount > kInlineInfoCount) {
+            heapInfos.resize(descriptorWriteCount);
+            infos = heapInfos.data();
+        }
+
         //std::vector<sp<BindableResource>> _refCounts;
-        std::unordered_set<VulkanTexture*> texReadOnly, texRW;
+        std::vector<BufferUsage> bufUsages;
+        std::vector<TextureUsage> texUsages;
+        //Same resource bound several times is merged into one entry
+        auto addBufUsage = [&](VulkanBuffer* buf, VkPipelineStageFlags stage, VkAccessFlags access) {
+            for (auto& u : bufUsages) {
+                if (u.buffer == buf) { u.stage |= stage; u.access |= access; return; }
+            }
+            bufUsages.push_back({ buf, stage, access });
+        };
+        //Only the subresources seen by the view are tracked
+        auto addTexUsage = [&](VulkanTextureView* view, VkImageLayout layout, VkPipelineStageFlags stage, VkAccessFlags access) {
+            auto tex = PtrCast<VulkanTexture>(view->GetTarget().get());
+            auto& viewDesc = view->GetDesc();
+            auto faces = tex->GetDesc().usage.cubemap ? 6u : 1u;
+            _TexSubresRange range{
+                viewDesc.baseMipLevel, viewDesc.mipLevels,
+                viewDesc.baseArrayLayer * faces, viewDesc.arrayLayers * faces };
+            for (auto& u : texUsages) {
+                if (u.texture == tex && u.layout == layout
+                    && u.range.baseMipLevel == range.baseMipLevel && u.range.levelCount == range.levelCount
+                    && u.range.baseArrayLayer == range.baseArrayLayer && u.range.layerCount == range.layerCount
+                ) {
+                    u.stage |= stage; u.access |= access; return;
+                }
+            }
+            texUsages.push_back({ tex, range, layout, stage, access });
+        };
+
         for (int i = 0; i < descriptorWriteCount; i++)
         {
             auto& elem = vkLayout->GetDesc().elements[i];
             auto type = elem.kind;
-
-            descriptorWrites[i].sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[i].descriptorCount = 1;
-            descriptorWrites[i].descriptorType = VdToVkResourceKind(type);
-            descriptorWrites[i].dstBinding = i;
-            descriptorWrites[i].dstSet = descriptorAllocationToken.GetHandle();
+            auto stage = VdToVkPipelineStages(elem.stages);
+            if (stage == 0) stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
 
             using _ResKind = ResourceLayout::Description::ElementDescription::ResourceKind;
             switch(type){
@@ -156,71 +238,87 @@ namespace Veldrid
                 case _ResKind::StructuredBufferReadWrite:{
                     auto* range = PtrCast<BufferRange>(boundResources[i].get());
                     auto* rangedVkBuffer = reinterpret_cast<const VulkanBuffer*>(range->GetBufferObject());
-                    bufferInfos[i].buffer = rangedVkBuffer->GetHandle();
-                    bufferInfos[i].offset = range->GetOffsetInBytes();
-                    bufferInfos[i].range = range->GetSizeInBytes();
-                    descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+                    infos[i].buffer.buffer = rangedVkBuffer->GetHandle();
+                    infos[i].buffer.offset = range->GetOffsetInBytes();
+                    infos[i].buffer.range = range->GetSizeInBytes();
                     //_refCounts.push_back(boundResources[i]);
+                    addBufUsage(const_cast<VulkanBuffer*>(rangedVkBuffer), stage,
+                        type == _ResKind::StructuredBufferReadWrite
+                        ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+                        : (type == _ResKind::UniformBuffer 
+                            ? VK_ACCESS_UNIFORM_READ_BIT
+                            : VK_ACCESS_SHADER_READ_BIT)
+                    );
                 } break;
 
                 case _ResKind::TextureReadOnly:{
                     auto* vkTexView = PtrCast<VulkanTextureView>(boundResources[i].get());
-                    imageInfos[i].imageView = vkTexView->GetHandle();
-                    imageInfos[i].imageLayout = VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    descriptorWrites[i].pImageInfo = &imageInfos[i];
+                    infos[i].image.imageView = vkTexView->GetHandle();
+                    infos[i].image.imageLayout = VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-                    auto vkTex = PtrCast<VulkanTexture>(vkTexView->GetTarget().get());
-                    texReadOnly.insert(vkTex);
+                    addTexUsage(vkTexView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, stage, VK_ACCESS_SHADER_READ_BIT);
                     //_sampledTextures.Add(Util.AssertSubtype<Texture, VkTexture>(texView.Target));
                     //_refCounts.push_back(boundResources[i]);
                 }break;
 
                 case _ResKind::TextureReadWrite:{
                     auto* vkTexView = PtrCast<VulkanTextureView>(boundResources[i].get());
-                    imageInfos[i].imageView = vkTexView->GetHandle();
-                    imageInfos[i].imageLayout = VkImageLayout::VK_IMAGE_LAYOUT_GENERAL;
-                    descriptorWrites[i].pImageInfo = &imageInfos[i];
+                    infos[i].image.imageView = vkTexView->GetHandle();
+                    infos[i].image.imageLayout = VkImageLayout::VK_IMAGE_LAYOUT_GENERAL;
 
-                    auto vkTex = PtrCast<VulkanTexture>(vkTexView->GetTarget().get());
-                    texRW.insert(vkTex);
+                    addTexUsage(vkTexView, VK_IMAGE_LAYOUT_GENERAL, stage, 
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
                     //_sampledTextures.Add(Util.AssertSubtype<Texture, VkTexture>(texView.Target));
                     //_refCounts.push_back(boundResources[i]);
                 }break;
 
                 case _ResKind::Sampler:{
                     auto* sampler = PtrCast<VulkanSampler>(boundResources[i].get());
-                    imageInfos[i].sampler = sampler->GetHandle();
-                    descriptorWrites[i].pImageInfo = &imageInfos[i];
+                    infos[i].image.sampler = sampler->GetHandle();
                     //_refCounts.push_back(boundResources[i]);
                 }break;
             }
             
         }
 
-        vkUpdateDescriptorSets(dev->LogicalDev(), descriptorWriteCount, descriptorWrites.data(), 0, nullptr);
+        if (auto updateTemplate = vkLayout->GetUpdateTemplate(); updateTemplate != VK_NULL_HANDLE) {
+            vkUpdateDescriptorSetWithTemplateKHR(
+                dev->LogicalDev(), descriptorAllocationToken.GetHandle(), updateTemplate, infos);
+        } else if (descriptorWriteCount > 0) {
+            std::array<VkWriteDescriptorSet, kInlineInfoCount> inlineWrites{};
+            std::vector<VkWriteDescriptorSet> heapWrites;
+            VkWriteDescriptorSet* descriptorWrites = inlineWrites.data();
+            if (descriptorWriteCount > kInlineInfoCount) {
+                heapWrites.resize(descriptorWriteCount);
+                descriptorWrites = heapWrites.data();
+            }
+            for (unsigned i = 0; i < descriptorWriteCount; i++) {
+                auto type = vkLayout->GetDescriptorTypes()[i];
+                descriptorWrites[i].sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[i].descriptorCount = 1;
+                descriptorWrites[i].descriptorType = type;
+                descriptorWrites[i].dstBinding = i;
+                descriptorWrites[i].dstSet = descriptorAllocationToken.GetHandle();
+                if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                    || type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+                    || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                    || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+                ) {
+                    descriptorWrites[i].pBufferInfo = &infos[i].buffer;
+                } else {
+                    descriptorWrites[i].pImageInfo = &infos[i].image;
+                }
+            }
+            vkUpdateDescriptorSets(dev->LogicalDev(), descriptorWriteCount, descriptorWrites, 0, nullptr);
+        }
         
         auto descSet = new VulkanResourceSet(dev, std::move(descriptorAllocationToken), desc);
-        descSet->_texReadOnly = std::move(texReadOnly);
-        descSet->_texRW = std::move(texRW);
+        descSet->_bufUsages = std::move(bufUsages);
+        descSet->_texUsages = std::move(texUsages);
 
         return sp(descSet);
     }
 
-    void VulkanResourceSet::VisitElements(ElementVisitor visitor) {
-        VulkanResourceLayout* vkLayout = reinterpret_cast<VulkanResourceLayout*>(description.layout.get());
-
-        auto& boundResources = description.boundResources;
-        auto descriptorWriteCount = boundResources.size();
-        assert(descriptorWriteCount == vkLayout->GetDesc().elements.size());
-
-        for (int i = 0; i < descriptorWriteCount; i++)
-        {
-            auto& elem = vkLayout->GetDesc().elements[i];
-            auto type = elem.kind;
-        }
-
-    }
-
 } // namespace Veldrid
 
 
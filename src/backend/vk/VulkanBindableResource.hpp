@@ -4,18 +4,38 @@
 
 #include "veldrid/BindableResource.hpp"
 
-#include <unordered_set>
+#include <vector>
 
 #include "VkDescriptorPoolMgr.hpp"
 
 namespace Veldrid{
 
     class VulkanDevice;
+    class VulkanBuffer;
     class VulkanTexture;
 
+    class _ResourceLayoutCache;
+    class _ResourceSetCache;
+
+    //Descriptor of one element in the packed data written through a
+    //layout's update template, elements are laid out by binding.
+    union _DescriptorInfo{
+        VkDescriptorBufferInfo buffer;
+        VkDescriptorImageInfo image;
+    };
+
     class VulkanResourceLayout : public ResourceLayout{
+        friend class _ResourceLayoutCache;
+
+        //Every layout is shared through the device layout cache
+        _ResourceLayoutCache* _cache = nullptr;
+        std::size_t _cacheHash = 0;
 
         VkDescriptorSetLayout _dsl;
+        //Null if the device lacks VK_KHR_descriptor_update_template
+        VkDescriptorUpdateTemplateKHR _updateTemplate = VK_NULL_HANDLE;
+        //Type of each binding as created in _dsl
+        std::vector<VkDescriptorType> _descriptorTypes;
 
         std::uint32_t _dynamicBufferCount;
         DescriptorResourceCounts _drcs;
@@ -25,27 +45,60 @@ namespace Veldrid{
             const Description& desc
         ) : ResourceLayout(dev, desc){}
 
+        static sp<ResourceLayout> _Create(
+            const sp<VulkanDevice>& dev,
+            const Description& desc
+        );
+
+    protected:
+        //Leave the layout cache before anyone can find the dying layout
+        void weak_dispose() const override;
+
     public:
         ~VulkanResourceLayout();
 
+        //Returns the live layout with an identical description if any
         static sp<ResourceLayout> Make(
             const sp<VulkanDevice>& dev,
             const Description& desc
         );
 
         const VkDescriptorSetLayout& GetHandle() const {return _dsl;}
+        //Writes an array of _DescriptorInfo, one per element
+        VkDescriptorUpdateTemplateKHR GetUpdateTemplate() const {return _updateTemplate;}
+        const std::vector<VkDescriptorType>& GetDescriptorTypes() const {return _descriptorTypes;}
         std::uint32_t GetDynamicBufferCount() const {return _dynamicBufferCount;}
         const DescriptorResourceCounts& GetResourceCounts() const {return _drcs;}
     };
 
     class VulkanResourceSet : public ResourceSet{
+        friend class _ResourceSetCache;
+
     public:
-        using ElementVisitor = std::function<void(VulkanResourceLayout*)>;
+        //How the bound resources are accessed, built once in Make().
+        //Raw pointers are kept alive by the set's description.
+        struct BufferUsage {
+            VulkanBuffer* buffer;
+            VkPipelineStageFlags stage;
+            VkAccessFlags access;
+        };
+        struct TextureUsage {
+            VulkanTexture* texture;
+            _TexSubresRange range;
+            VkImageLayout layout;
+            VkPipelineStageFlags stage;
+            VkAccessFlags access;
+        };
+
     private:
+        //Sets are shared through the device set cache
+        _ResourceSetCache* _cache = nullptr;
+        std::size_t _cacheHash = 0;
 
         _DescriptorSet _descSet;
 
-        std::unordered_set<VulkanTexture*> _texReadOnly, _texRW;
+        std::vector<BufferUsage> _bufUsages;
+        std::vector<TextureUsage> _texUsages;
 
         VulkanResourceSet(
             const sp<GraphicsDevice>& dev,
@@ -57,18 +110,36 @@ namespace Veldrid{
         
         {}
 
+        static sp<ResourceSet> _Create(
+            const sp<VulkanDevice>& dev,
+            const Description& desc,
+            _DescriptorSet&& set
+        );
+
+    protected:
+        //Leave the set cache before anyone can find the dying set
+        void weak_dispose() const override;
+
     public:
         ~VulkanResourceSet();
 
+        //Returns the live set with the same layout and resources if any
         static sp<ResourceSet> Make(
             const sp<VulkanDevice>& dev,
             const Description& desc
         );
 
-        const VkDescriptorSet& GetHandle() const { return _descSet.GetHandle(); }
+        //Writes set, allocated from a command list's transient pools.
+        //Not shared through the set cache.
+        static sp<ResourceSet> MakeTransient(
+            const sp<VulkanDevice>& dev,
+            const Description& desc,
+            VkDescriptorSet set
+        );
 
+        const VkDescriptorSet& GetHandle() const { return _descSet.GetHandle(); }
 
-        void TransitionImageLayoutsIfNeeded(VkCommandBuffer cb);
-        void VisitElements(ElementVisitor visitor);
+        const std::vector<BufferUsage>& GetBufferUsages() const { return _bufUsages; }
+        const std::vector<TextureUsage>& GetTextureUsages() const { return _texUsages; }
     };
 }
\ No newline at end of file
@@ -3,6 +3,10 @@
 #include "veldrid/common/Common.hpp"
 #include "veldrid/Helpers.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
 #include "VkCommon.hpp"
 #include "VkTypeCvt.hpp"
 #include "VulkanDevice.hpp"
@@ -63,119 +67,429 @@ namespace Veldrid{
         //find anyone with a write access
     }
 
+    void _PtrIndexMap::_Grow() {
+        std::vector<Entry> oldEntries;
+        oldEntries.swap(_entries);
+        _entries.resize(std::max<std::size_t>(64, oldEntries.size() * 2), Entry{nullptr, 0, 0});
+        auto oldStamp = _stamp;
+        _stamp = 1;
+        _count = 0;
+        for (auto& e : oldEntries) {
+            if (e.stamp == oldStamp) Insert(e.key, e.value);
+        }
+    }
+
+    const std::uint32_t* _PtrIndexMap::Find(const void* key) const {
+        if (_entries.empty()) return nullptr;
+        std::size_t mask = _entries.size() - 1;
+        for (std::size_t i = _Hash(key) & mask;; i = (i + 1) & mask) {
+            auto& e = _entries[i];
+            if (e.stamp != _stamp) return nullptr;
+            if (e.key == key) return &e.value;
+        }
+    }
+
+    void _PtrIndexMap::Insert(const void* key, std::uint32_t value) {
+        //Keep load factor under 1/2
+        if ((_count + 1) * 2 > _entries.size()) _Grow();
+        std::size_t mask = _entries.size() - 1;
+        for (std::size_t i = _Hash(key) & mask;; i = (i + 1) & mask) {
+            auto& e = _entries[i];
+            if (e.stamp != _stamp) {
+                e = { key, value, _stamp };
+                _count++;
+                return;
+            }
+            if (e.key == key) {
+                e.value = value;
+                return;
+            }
+        }
+    }
+
+    void _PtrIndexMap::Clear() {
+        _count = 0;
+        if (++_stamp == 0) {
+            //Wrapped around, stale stamps could match again
+            for (auto& e : _entries) e.stamp = 0;
+            _stamp = 1;
+        }
+    }
+
+    static std::uint32_t _NextRegistryGeneration() {
+        static std::atomic<std::uint32_t> generation{ 0 };
+        std::uint32_t gen;
+        //0 is what untouched resources are tagged with
+        do { gen = ++generation; } while (gen == 0);
+        return gen;
+    }
+
+    _DevResRegistry::_DevResRegistry() {
+        _generation = _NextRegistryGeneration();
+    }
+
+    void _DevResRegistry::Reset() {
+        _generation = _NextRegistryGeneration();
+        _res.clear();
+        _bufSlots.clear();
+        _texSlots.clear();
+        _texTracks.clear();
+        _slotLookup.Clear();
+        _bufSyncs.clear();
+        _texSyncs.clear();
+    }
+
+    std::uint32_t _DevResRegistry::_GetBufSlot(VulkanBuffer* buf, bool& isNew) {
+        auto& tag = buf->GetTrackingTag().value;
+        auto v = tag.load(std::memory_order_relaxed);
+        if ((v >> 32) == _generation) {
+            isNew = false;
+            return (std::uint32_t)v;
+        }
+
+        //Never seen, or another command list retagged it
+        std::uint32_t idx;
+        if (auto* found = _slotLookup.Find(buf)) {
+            isNew = false;
+            idx = *found;
+        } else {
+            isNew = true;
+            idx = _bufSlots.size();
+            _bufSlots.push_back({ buf, {}, {}, true });
+            _slotLookup.Insert(buf, idx);
+        }
+        tag.store(((std::uint64_t)_generation << 32) | idx, std::memory_order_relaxed);
+        return idx;
+    }
+
+    std::uint32_t _DevResRegistry::_GetTexSlot(VulkanTexture* tex, bool& isNew) {
+        auto& tag = tex->GetTrackingTag().value;
+        auto v = tag.load(std::memory_order_relaxed);
+        if ((v >> 32) == _generation) {
+            isNew = false;
+            return (std::uint32_t)v;
+        }
+
+        std::uint32_t idx;
+        if (auto* found = _slotLookup.Find(tex)) {
+            isNew = false;
+            idx = *found;
+        } else {
+            isNew = true;
+            idx = _texSlots.size();
+            _texSlots.push_back({ tex, (std::uint32_t)_texTracks.size() });
+            _texTracks.resize(
+                _texTracks.size() + tex->GetDesc().mipLevels * tex->GetLayerCount(),
+                TexTrack{ {0, 0, VK_IMAGE_LAYOUT_UNDEFINED}, {0, 0, VK_IMAGE_LAYOUT_UNDEFINED}, true });
+            _slotLookup.Insert(tex, idx);
+        }
+        tag.store(((std::uint64_t)_generation << 32) | idx, std::memory_order_relaxed);
+        return idx;
+    }
+
     void _DevResRegistry::RegisterBufferUsage(
         const sp<Buffer>& buffer,
         VkPipelineStageFlags stage,
         VkAccessFlags access
     ) {
         auto vkBuf = PtrCast<VulkanBuffer>(buffer.get());
-        _res.insert(buffer);
-
-        //Find usages
-        auto res = _bufRefs.find(vkBuf);
-        if (res != _bufRefs.end()) {
-            //There is a access dependency
-            auto& [thisBuf, prevRef] = *res;
-            //And a potential hazard
-            if (_HasAccessHarzard(prevRef.access, access)) {
-                //Add one entry to sync infos
-                _bufSyncs.push_back({ vkBuf, prevRef,{ stage, access} });
-                //and clear old references
-                prevRef.stage = stage;
-                prevRef.access = access;
-            }
-            else {
-                //gather all read references
-                prevRef.stage |= stage;
-                prevRef.access |= access;
-            }
-            
+        //Hold a reference on first use only
+        if (_RegisterBufferUsage(vkBuf, stage, access)) {
+            _res.push_back(buffer);
+        }
+    }
+
+    void _DevResRegistry::RegisterBufferUsage(
+        VulkanBuffer* vkBuf,
+        VkPipelineStageFlags stage,
+        VkAccessFlags access
+    ) {
+        _RegisterBufferUsage(vkBuf, stage, access);
+    }
+
+    bool _DevResRegistry::_RegisterBufferUsage(
+        VulkanBuffer* vkBuf,
+        VkPipelineStageFlags stage,
+        VkAccessFlags access
+    ) {
+        bool isNew;
+        auto& slot = _bufSlots[_GetBufSlot(vkBuf, isNew)];
+        if (isNew) {
+            //This is a first time use, previous submissions are
+            //synchronized against it at submit time
+            slot.first = slot.last = { stage, access };
+            return true;
+        }
+
+        //There is a access dependency
+        //And a potential hazard
+        if (_HasAccessHarzard(slot.last.access, access)) {
+            //Add one entry to sync infos
+            _bufSyncs.push_back({ vkBuf, slot.last,{ stage, access} });
+            //and clear old references
+            slot.last = { stage, access };
+            slot.firstOpen = false;
         }
         else {
-            //This is a first time use
-            _bufRefs.insert({ vkBuf, {stage, access} });
+            //gather all read references
+            slot.last.stage |= stage;
+            slot.last.access |= access;
+            if (slot.firstOpen) {
+                slot.first.stage |= stage;
+                slot.first.access |= access;
+            }
         }
+        return false;
     }
 
     void _DevResRegistry::RegisterTexUsage(
         const sp<Texture>& tex,
         VkImageLayout requiredLayout,
         VkPipelineStageFlags stage,
-        VkAccessFlags access
+        VkAccessFlags access,
+        const _TexSubresRange& range
     ) {
         auto vkTex = PtrCast<VulkanTexture>(tex.get());
-        _res.insert(tex);
-
-        //Find usages
-        auto res = _texRefs.find(vkTex);
-        if (vkTex->GetLayout() != requiredLayout) {
-            //Transition needed if curr layout != required layout
-            //Always add barrier
-            TexRef* prevRef;
-            if (res != _texRefs.end()) {
-                //There is a access dependency
-                auto& [thisTex, _prevRef] = *res;
-                prevRef = &_prevRef;
-                
-            }
-            else {
-                auto&[ entryIt, _insertRes] = _texRefs.insert({ 
-                    vkTex, 
-                    {
-                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 
-                        0, 
-                        vkTex->GetLayout()
-                    } 
-                });
-                std::pair<VulkanTexture* const, TexRef> & entry = *entryIt;
-                prevRef = &entry.second;
+        if (_RegisterTexUsage(vkTex, requiredLayout, stage, access, range)) {
+            _res.push_back(tex);
+        }
+    }
+
+    void _DevResRegistry::RegisterTexUsage(
+        VulkanTexture* vkTex,
+        VkImageLayout requiredLayout,
+        VkPipelineStageFlags stage,
+        VkAccessFlags access,
+        const _TexSubresRange& range
+    ) {
+        _RegisterTexUsage(vkTex, requiredLayout, stage, access, range);
+    }
+
+    template<typename TexRefT>
+    static bool _IsSameTexRef(const TexRefT& a, const TexRefT& b) {
+        return a.stage == b.stage && a.access == b.access && a.layout == b.layout;
+    }
+
+    void _DevResRegistry::_AddTexSync(
+        VulkanTexture* tex, std::uint32_t mipLevel, std::uint32_t arrayLayer,
+        const TexRef& prevUsage, const TexRef& currUsage
+    ) {
+        if (!_texSyncs.empty()) {
+            auto& last = _texSyncs.back();
+            if (last.resource == tex
+                && last.range.baseMipLevel == mipLevel
+                && last.range.levelCount == 1
+                && last.range.baseArrayLayer + last.range.layerCount == arrayLayer
+                && _IsSameTexRef(last.prevUsage, prevUsage)
+                && _IsSameTexRef(last.currUsage, currUsage)
+            ) {
+                last.range.layerCount++;
+                return;
             }
+        }
+        _texSyncs.push_back({ tex, { mipLevel, 1, arrayLayer, 1 }, prevUsage, currUsage });
+    }
 
-            //Add one entry to sync infos
-            _texSyncs.push_back({ vkTex, *prevRef,{ stage, access, requiredLayout} });
-            prevRef->stage = stage;
-            prevRef->access = access;
-            prevRef->layout = requiredLayout;
-            vkTex->SetLayout(requiredLayout);
+    void _DevResRegistry::_MergeTexSyncMips(std::size_t rowBegin) {
+        //Only a mip that collapsed into a single entry can extend the previous one
+        if (rowBegin == 0 || _texSyncs.size() != rowBegin + 1) return;
+
+        auto& prev = _texSyncs[rowBegin - 1];
+        auto& curr = _texSyncs[rowBegin];
+        if (prev.resource == curr.resource
+            && prev.range.baseMipLevel + prev.range.levelCount == curr.range.baseMipLevel
+            && prev.range.baseArrayLayer == curr.range.baseArrayLayer
+            && prev.range.layerCount == curr.range.layerCount
+            && _IsSameTexRef(prev.prevUsage, curr.prevUsage)
+            && _IsSameTexRef(prev.currUsage, curr.currUsage)
+        ) {
+            prev.range.levelCount++;
+            _texSyncs.pop_back();
         }
-        else {
-            //Add barrier when there is a access hazard
-            if (res != _texRefs.end()) {
-                auto& [thisTex, prevRef] = *res;
-                if (_HasAccessHarzard(prevRef.access, access)) {
-                    _texSyncs.push_back({ vkTex, prevRef,{ stage, access, requiredLayout} });
-                    prevRef.stage = stage;
-                    prevRef.access = access;
+    }
+
+    bool _DevResRegistry::_RegisterTexUsage(
+        VulkanTexture* vkTex,
+        VkImageLayout requiredLayout,
+        VkPipelineStageFlags stage,
+        VkAccessFlags access,
+        const _TexSubresRange& range
+    ) {
+        bool isNew;
+        auto& slot = _texSlots[_GetTexSlot(vkTex, isNew)];
+        auto r = vkTex->ResolveRange(range);
+        auto mipLevels = vkTex->GetDesc().mipLevels;
+        TexRef currRef{ stage, access, requiredLayout };
+
+        for (auto mip = r.baseMipLevel; mip < r.baseMipLevel + r.levelCount; mip++) {
+            auto rowBegin = _texSyncs.size();
+            for (auto layer = r.baseArrayLayer; layer < r.baseArrayLayer + r.layerCount; layer++) {
+                auto& track = _texTracks[slot.firstTrack + layer * mipLevels + mip];
+
+                if (track.first.stage == 0) {
+                    //This is a first time use of the subresource, assume
+                    //it is already in the required layout. Transition from
+                    //the submitted layout is done at submit time.
+                    track.first = track.last = currRef;
+                }
+                else if (track.last.layout != requiredLayout
+                    || _HasAccessHarzard(track.last.access, access)
+                ) {
+                    //Add barrier when layout changes or there is a access hazard
+                    _AddTexSync(vkTex, mip, layer, track.last, currRef);
+                    track.last = currRef;
+                    track.firstOpen = false;
                 }
                 else {
                     //There is a access dependency
-                    prevRef.stage |= stage;
-                    prevRef.access |= access;
+                    track.last.stage |= stage;
+                    track.last.access |= access;
+                    if (track.firstOpen) {
+                        track.first.stage |= stage;
+                        track.first.access |= access;
+                    }
                 }
             }
-            else {
-                //This is a first time use
-                _texRefs.insert({ vkTex, {stage, access, requiredLayout} });
+            _MergeTexSyncMips(rowBegin);
+        }
+
+        return isNew;
+    }
+
+    static VkImageAspectFlags _GetAspectMask(const Texture::Description& desc) {
+        if (desc.usage.depthStencil) {
+            return Helpers::FormatHelpers::IsStencilFormat(desc.format)
+                ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT
+                : VK_IMAGE_ASPECT_DEPTH_BIT;
+        }
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+
+    void _DevResRegistry::ResolveSubmittedState(_SubmitFixup& fixup) {
+        for (auto& slot : _bufSlots) {
+            auto* vkBuf = slot.resource;
+            BufRef prev{ vkBuf->GetSubmittedStage(), vkBuf->GetSubmittedAccess() };
+
+            //A barrier inside the recording only waits for its own stages,
+            //earlier work in other stages needs an explicit dependency.
+            bool needBarrier = _HasAccessHarzard(prev.access, slot.first.access)
+                || (!slot.firstOpen && (prev.stage & ~(slot.first.stage | VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)) != 0);
+            if (needBarrier) {
+                fixup.srcStages |= prev.stage;
+                fixup.dstStages |= slot.first.stage;
+                auto& barrier = fixup.bufBarriers.emplace_back();
+                barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+                barrier.srcAccessMask = prev.access;
+                barrier.dstAccessMask = slot.first.access;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer = vkBuf->GetHandle();
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+            }
+
+            if (needBarrier || !slot.firstOpen) {
+                vkBuf->SetSubmittedState(slot.last.stage, slot.last.access);
+            } else {
+                //Only reads so far, later writes have to wait for all of them
+                vkBuf->SetSubmittedState(prev.stage | slot.last.stage, prev.access | slot.last.access);
+            }
+        }
+
+        for (auto& slot : _texSlots) {
+            auto* vkTex = slot.resource;
+            auto& desc = vkTex->GetDesc();
+            auto mipLevels = desc.mipLevels;
+            auto layerCount = vkTex->GetLayerCount();
+            auto aspectMask = _GetAspectMask(desc);
+
+            for (std::uint32_t mip = 0; mip < mipLevels; mip++) {
+                for (std::uint32_t layer = 0; layer < layerCount; layer++) {
+                    auto& track = _texTracks[slot.firstTrack + layer * mipLevels + mip];
+                    if (track.first.stage == 0) continue;
+
+                    auto prev = vkTex->GetState(mip, layer);
+                    bool needBarrier = prev.layout != track.first.layout
+                        || _HasAccessHarzard(prev.access, track.first.access)
+                        || (!track.firstOpen && (prev.stage & ~(track.first.stage | VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)) != 0);
+
+                    if (needBarrier) {
+                        fixup.srcStages |= prev.stage;
+                        fixup.dstStages |= track.first.stage;
+
+                        //Extend the previous barrier over adjacent layers
+                        bool merged = false;
+                        if (!fixup.imgBarriers.empty()) {
+                            auto& last = fixup.imgBarriers.back();
+                            auto& lastRange = last.subresourceRange;
+                            if (last.image == vkTex->GetHandle()
+                                && lastRange.baseMipLevel == mip
+                                && lastRange.baseArrayLayer + lastRange.layerCount == layer
+                                && last.oldLayout == prev.layout
+                                && last.newLayout == track.first.layout
+                                && last.srcAccessMask == prev.access
+                                && last.dstAccessMask == track.first.access
+                            ) {
+                                lastRange.layerCount++;
+                                merged = true;
+                            }
+                        }
+                        if (!merged) {
+                            auto& barrier = fixup.imgBarriers.emplace_back();
+                            barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+                            barrier.oldLayout = prev.layout;
+                            barrier.newLayout = track.first.layout;
+                            barrier.srcAccessMask = prev.access;
+                            barrier.dstAccessMask = track.first.access;
+                            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                            barrier.image = vkTex->GetHandle();
+                            barrier.subresourceRange = { aspectMask, mip, 1, layer, 1 };
+                        }
+                    }
+
+                    _TexSubresRange subres{ mip, 1, layer, 1 };
+                    if (needBarrier || !track.firstOpen) {
+                        vkTex->SetState(subres, { track.last.layout, track.last.access, track.last.stage });
+                    } else {
+                        vkTex->SetState(subres, {
+                            track.last.layout,
+                            prev.access | track.last.access,
+                            prev.stage | track.last.stage });
+                    }
+                }
             }
         }
     }
 
-    void _DevResRegistry::ModifyTexUsage(
-        const sp<Texture>& tex,
-        VkImageLayout layout,
-        VkPipelineStageFlags stage,
-        VkAccessFlags access
-    ) {
-        auto vkTex = PtrCast<VulkanTexture>(tex.get());
-        
-        //Find usages
-        auto res = _texRefs.find(vkTex);
-        assert(res != _texRefs.end());
+    void _DevResRegistry::MergeUsages(const _DevResRegistry& other) {
+        for (auto& slot : other._bufSlots) {
+            _RegisterBufferUsage(slot.resource, slot.first.stage, slot.first.access);
+            if (!slot.firstOpen) {
+                _RegisterBufferUsage(slot.resource, slot.last.stage, slot.last.access);
+            }
+        }
 
-        auto& ref = (*res).second;
-        ref.layout = layout;
-        ref.access = access;
-        ref.stage = stage;
+        for (auto& slot : other._texSlots) {
+            auto* vkTex = slot.resource;
+            auto mipLevels = vkTex->GetDesc().mipLevels;
+            auto layerCount = vkTex->GetLayerCount();
+
+            for (std::uint32_t mip = 0; mip < mipLevels; mip++) {
+                for (std::uint32_t layer = 0; layer < layerCount; layer++) {
+                    auto& track = other._texTracks[slot.firstTrack + layer * mipLevels + mip];
+                    if (track.first.stage == 0) continue;
+
+                    _TexSubresRange subres{ mip, 1, layer, 1 };
+                    _RegisterTexUsage(vkTex,
+                        track.first.layout, track.first.stage, track.first.access, subres);
+                    if (!track.firstOpen) {
+                        _RegisterTexUsage(vkTex,
+                            track.last.layout, track.last.stage, track.last.access, subres);
+                    }
+                }
+            }
+        }
     }
 
 
@@ -189,12 +503,12 @@ namespace Veldrid{
         VkPipelineStageFlags srcStageFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
         VkPipelineStageFlags dstStageFlags = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
 
-        std::vector<VkBufferMemoryBarrier> bufBarriers;
+        _bufBarriers.clear();
         for (auto& [thisBuf, prevRef, currRef] : _bufSyncs) {
             srcStageFlags |= prevRef.stage;
             dstStageFlags |= currRef.stage;
-            bufBarriers.push_back({VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER});
-            auto& barrier = bufBarriers.back();
+            auto& barrier = _bufBarriers.emplace_back();
+            barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
 
             barrier.srcAccessMask = prevRef.access;
             barrier.dstAccessMask = currRef.access;
@@ -206,13 +520,13 @@ namespace Veldrid{
             barrier.size = thisBuf->GetDesc().sizeInBytes;
         }
 
-        std::vector<VkImageMemoryBarrier> imgBarriers;
-        for (auto& [thisTex, prevRef, currRef] : _texSyncs) {
+        _imgBarriers.clear();
+        for (auto& [thisTex, range, prevRef, currRef] : _texSyncs) {
             srcStageFlags |= prevRef.stage;
             dstStageFlags |= currRef.stage;
-            imgBarriers.push_back({ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER });
+            auto& barrier = _imgBarriers.emplace_back();
+            barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
             auto& desc = thisTex->GetDesc();
-            auto& barrier = imgBarriers.back();
 
             barrier.oldLayout = prevRef.layout;
             barrier.newLayout = currRef.layout;
@@ -221,33 +535,22 @@ namespace Veldrid{
             barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
             barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
             barrier.image = thisTex->GetHandle();
-            auto& aspectMask = barrier.subresourceRange.aspectMask;
-            if (desc.usage.depthStencil) {
-                aspectMask = Helpers::FormatHelpers::IsStencilFormat(desc.format)
-                    ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT
-                    : VK_IMAGE_ASPECT_DEPTH_BIT;
-            }
-            else {
-                aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            }
-            barrier.subresourceRange.baseMipLevel = 0;
-            barrier.subresourceRange.levelCount = desc.mipLevels;
-            barrier.subresourceRange.baseArrayLayer = 0;
-            barrier.subresourceRange.layerCount = desc.arrayLayers;
+            barrier.subresourceRange.aspectMask = _GetAspectMask(desc);
+            barrier.subresourceRange.baseMipLevel = range.baseMipLevel;
+            barrier.subresourceRange.levelCount = range.levelCount;
+            barrier.subresourceRange.baseArrayLayer = range.baseArrayLayer;
+            barrier.subresourceRange.layerCount = range.layerCount;
 
         }
 
-        //VkMemoryBarrier{};
-        //VkBufferMemoryBarrier{};
-        //VkImageMemoryBarrier{};
         vkCmdPipelineBarrier(
             cb,
             srcStageFlags,
             dstStageFlags,
             0,
             0, nullptr,
-            bufBarriers.size(), bufBarriers.data(),
-            imgBarriers.size(), imgBarriers.data());
+            _bufBarriers.size(), _bufBarriers.data(),
+            _imgBarriers.size(), _imgBarriers.data());
         
         _bufSyncs.clear();
         _texSyncs.clear();
@@ -257,17 +560,20 @@ namespace Veldrid{
 
 
     #define CHK_RENDERPASS_BEGUN() DEBUGCODE(assert(_currentRenderPass != nullptr))
-    #define CHK_RENDERPASS_ENDED() DEBUGCODE(assert(_currentRenderPass != nullptr))
-    #define CHK_PIPELINE_SET() DEBUGCODE(assert(_currentRenderPass != nullptr))
+    #define CHK_RENDERPASS_ENDED() DEBUGCODE(assert(_currentRenderPass == nullptr))
+    #define CHK_PIPELINE_SET() DEBUGCODE(assert(_currentPipeline != nullptr))
 
-    sp<CommandList> VulkanCommandList::Make(const sp<VulkanDevice>& dev){
+    sp<CommandList> VulkanCommandList::Make(
+        const sp<VulkanDevice>& dev,
+        const CommandList::Description& desc
+    ){
         auto* vkDev = PtrCast<VulkanDevice>(dev.get());
 
         auto cmdPool = vkDev->GetCmdPool();
         auto vkCmdBuf = cmdPool->AllocateBuffer();
 
         sp<GraphicsDevice> _dev(dev);
-        auto cmdBuf = new VulkanCommandList(_dev);
+        auto cmdBuf = new VulkanCommandList(_dev, desc);
         cmdBuf->_cmdBuf = vkCmdBuf;
         cmdBuf->_cmdPool = std::move(cmdPool);
 
@@ -275,24 +581,212 @@ namespace Veldrid{
     }
 
     VulkanCommandList::~VulkanCommandList(){
-        _cmdPool->FreeBuffer(_cmdBuf);
+        _ReleaseUploads();
+        //Secondaries get their buffer on first Begin
+        if (_cmdPool != nullptr) {
+            _cmdPool->FreeBuffer(_cmdBuf);
+        }
+    }
+
+    void VulkanCommandList::TakeStagingBlocks(std::vector<_StagingBlock>& out) {
+        //Replays copy from the same blocks, freed on the next Reset
+        if (description.isReusable) return;
+        out.insert(out.end(), _stagingBlocks.begin(), _stagingBlocks.end());
+        _stagingBlocks.clear();
+    }
+
+    void VulkanCommandList::TakeTransientDescriptorPools(std::vector<_TransientDescriptorPool>& out) {
+        //Replays bind the same sets, freed on the next Reset
+        if (description.isReusable) return;
+        out.insert(out.end(), _transientPools.begin(), _transientPools.end());
+        _transientPools.clear();
+    }
+
+    std::uint8_t* VulkanCommandList::_AllocateStaging(
+        VkDeviceSize size, VkBuffer& outBuffer, VkDeviceSize& outOffset
+    ) {
+        constexpr VkDeviceSize alignment = 16;
+
+        if (!_stagingBlocks.empty()) {
+            auto& block = _stagingBlocks.back();
+            auto offset = (block.usedSize + alignment - 1) & ~(alignment - 1);
+            if (offset + size <= block.size) {
+                block.usedSize = offset + size;
+                outBuffer = block.buffer;
+                outOffset = offset;
+                return block.mappedData + offset;
+            }
+        }
+
+        auto* vkDev = PtrCast<VulkanDevice>(dev.get());
+        _stagingBlocks.push_back(vkDev->AllocateStagingBlock(size));
+        auto& block = _stagingBlocks.back();
+        block.usedSize = size;
+        outBuffer = block.buffer;
+        outOffset = 0;
+        return block.mappedData;
     }
      
+    void VulkanCommandList::_ReleaseUploads() {
+        auto* vkDev = PtrCast<VulkanDevice>(dev.get());
+        if (_isSubmitted) {
+            //Only reusable lists keep them across submissions,
+            //replays may still be running.
+            vkDev->RetireSubmittedUploads(_stagingBlocks, _transientPools);
+            _isSubmitted = false;
+        } else {
+            //Never submitted, nothing on the GPU references them
+            vkDev->FreeStagingBlocks(_stagingBlocks);
+            vkDev->FreeTransientDescriptorPools(_transientPools);
+        }
+    }
+
+    void VulkanCommandList::_ResetTracking() {
+        _ReleaseUploads();
+
+        _currentPipeline = nullptr;
+        _currentRenderPass = nullptr;
+        _rndPasses.clear();
+        _devRes.clear();
+        _miscResReg.clear();
+        _ResetStateCache();
+        _resReg.Reset();
+    }
+
+    void VulkanCommandList::Reset(){
+        _ResetTracking();
+
+        //Keep the memory, the buffer is most likely recorded again.
+        //The pool belongs to its thread, others leave it to the
+        //implicit reset of the next Begin.
+        if (_cmdPool != nullptr && _cmdPool->boundID == std::this_thread::get_id()) {
+            vkResetCommandBuffer(_cmdBuf, 0);
+        }
+    }
+
     void VulkanCommandList::Begin(){
+        //vkBeginCommandBuffer resets the buffer implicitly
+        _ResetTracking();
+
+        if (_isSecondary) {
+            _BeginSecondary();
+            return;
+        }
         
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (description.isReusable) {
+            //Replayed every frame, possibly while the previous frame
+            //is still executing
+            beginInfo.flags = VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+        } else {
+            beginInfo.flags = VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        }
+        vkBeginCommandBuffer(_cmdBuf, &beginInfo);
+    }
+    void VulkanCommandList::_BeginSecondary() {
+        auto* vkDev = PtrCast<VulkanDevice>(dev.get());
+
+        //Each recording thread allocates from its own pool, no locking
+        //is needed while workers record in parallel.
+        auto cmdPool = vkDev->GetCmdPool();
+        if (cmdPool.get() != _cmdPool.get()) {
+            //Handed back to the recording thread of the old pool
+            if (_cmdPool != nullptr) {
+                _cmdPool->FreeBuffer(_cmdBuf);
+            }
+            _cmdBuf = cmdPool->AllocateBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+            _cmdPool = std::move(cmdPool);
+        }
+
+        //Render passes of one framebuffer only differ in load/store ops
+        //and are compatible, any of them can be inherited.
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = _inheritedFb->GetRenderPassNoClear_Load();
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = _inheritedFb->GetHandle();
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        //Replayed along with a reusable primary
+        beginInfo.flags |= description.isReusable
+            ? VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT
+            : VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
         vkBeginCommandBuffer(_cmdBuf, &beginInfo);
 
+        //The inherited pass is running for the whole recording
+        _rndPasses.emplace_back();
+        _currentRenderPass = &_rndPasses.back();
+        _currentRenderPass->fb = _inheritedFb;
+        _currentRenderPass->clearColorTargets.resize(
+            _inheritedFb->GetDesc().colorTargets.size(), {}
+        );
+        _currentRenderPass->isActive = true;
     }
+
     void VulkanCommandList::End(){
+        if (_isSecondary) {
+            //Clears without any draw still have to reach the attachments
+            _FlushPendingClears();
+            _currentRenderPass = nullptr;
+            vkEndCommandBuffer(_cmdBuf);
+            return;
+        }
+
+        CHK_RENDERPASS_ENDED();
+        _EndActiveRenderPass();
         vkEndCommandBuffer(_cmdBuf);
     }
 
+    void VulkanCommandList::_InvalidateBoundState() {
+        _currentPipeline = nullptr;
+        _graphicsSets = {};
+        _computeSets = {};
+        _vertexBindings.Reset();
+        _indexBinding = {};
+        _viewports.Reset();
+        _scissors.Reset();
+    }
+
+    void VulkanCommandList::_ResetStateCache() {
+        _InvalidateBoundState();
+        _stateCacheStats = {};
+    }
+
+    void VulkanCommandList::_FlushDynamicStates() {
+        _vertexBindings.Flush([&](std::uint32_t first, std::uint32_t count, const _VertexBinding* bindings) {
+            VkBuffer buffers[16];
+            VkDeviceSize offsets[16];
+            //Chunk the run to keep everything on the stack
+            for (std::uint32_t i = 0; i < count; i += 16) {
+                std::uint32_t chunk = std::min<std::uint32_t>(count - i, 16);
+                for (std::uint32_t j = 0; j < chunk; j++) {
+                    buffers[j] = bindings[i + j].buffer;
+                    offsets[j] = bindings[i + j].offset;
+                }
+                vkCmdBindVertexBuffers(_cmdBuf, first + i, chunk, buffers, offsets);
+                _stateCacheStats.coalescedVertexBuffers += chunk - 1;
+            }
+        });
+
+        _viewports.Flush([&](std::uint32_t first, std::uint32_t count, const VkViewport* viewports) {
+            vkCmdSetViewport(_cmdBuf, first, count, viewports);
+        });
+
+        _scissors.Flush([&](std::uint32_t first, std::uint32_t count, const VkRect2D* scissors) {
+            vkCmdSetScissor(_cmdBuf, first, count, scissors);
+        });
+    }
+
     void VulkanCommandList::SetPipeline(const sp<Pipeline>& pipeline){
         VulkanPipelineBase* vkPipeline = PtrCast<VulkanPipelineBase>(pipeline.get());
-        assert(vkPipeline != _currentPipeline);
+        if (vkPipeline == _currentPipeline) {
+            _stateCacheStats.elidedPipelines++;
+            return;
+        }
         _miscResReg.insert(pipeline);
         bool isComputePipeline = vkPipeline->IsComputePipeline();
                 
@@ -306,59 +800,79 @@ namespace Veldrid{
         }
 
         //ensure resource set counts
+        auto& bound = _SetsOf(isComputePipeline);
         auto setCnt = vkPipeline->GetResourceSetCount();
-        if (setCnt > _resourceSets.size()) {
-            _resourceSets.resize(setCnt, {});
+        if (setCnt > bound.sets.size()) {
+            bound.sets.resize(setCnt, {});
+        }
+
+        //Sets bound with a different pipeline layout are disturbed,
+        //the other bind point keeps its own
+        if (bound.layout != VK_NULL_HANDLE
+            && bound.layout != vkPipeline->GetLayout()
+        ) {
+            for (auto& set : bound.sets) {
+                if (set.IsValid()) set.isNewlyChanged = true;
+            }
         }
+        bound.layout = vkPipeline->GetLayout();
 
         //Mark current pipeline
         _currentPipeline = vkPipeline;
     }
 
-    void VulkanCommandList::BeginRenderPass(const sp<Framebuffer>& fb){
-        CHK_RENDERPASS_ENDED();
-        //Record render pass
-        _rndPasses.emplace_back();
-        _currentRenderPass = &_rndPasses.back();
-
-        VulkanFramebufferBase* vkfb = PtrCast<VulkanFramebufferBase>(fb.get());
-        _currentRenderPass->fb = RefRawPtr(vkfb);
-
-        _currentRenderPass->clearColorTargets.resize(
-            vkfb->GetDesc().colorTargets.size(), {}
-        );
-
+    void VulkanCommandList::_RegisterAttachmentUsage(VulkanFramebufferBase* vkfb) {
         vkfb->VisitAttachments([&](
             const sp<VulkanTexture>& vkTarget,
-            VulkanFramebufferBase::VisitedAttachmentType type) {
+            VulkanFramebufferBase::VisitedAttachmentType type,
+            const _TexSubresRange& range) {
 
                 switch (type)
                 {
                 case Veldrid::VulkanFramebufferBase::VisitedAttachmentType::ColorAttachment: {
                     _resReg.RegisterTexUsage(vkTarget,
                         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        VK_ACCESS_SHADER_WRITE_BIT
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        range
                     );
                 }break;
                 case Veldrid::VulkanFramebufferBase::VisitedAttachmentType::DepthAttachment: {
                     _resReg.RegisterTexUsage(vkTarget,
                         VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        VK_ACCESS_SHADER_WRITE_BIT
+                        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        range
                     );
                 }break;
                 case Veldrid::VulkanFramebufferBase::VisitedAttachmentType::DepthStencilAttachment: {
                     _resReg.RegisterTexUsage(vkTarget,
                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        VK_ACCESS_SHADER_WRITE_BIT
+                        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        range
                     );
                 }break;
                 }
             }
         );
 
+    }
+
+    void VulkanCommandList::BeginRenderPass(const sp<Framebuffer>& fb){
+        CHK_RENDERPASS_ENDED();
+        //Record render pass
+        _rndPasses.emplace_back();
+        _currentRenderPass = &_rndPasses.back();
+
+        VulkanFramebufferBase* vkfb = PtrCast<VulkanFramebufferBase>(fb.get());
+        _currentRenderPass->fb = RefRawPtr(vkfb);
+
+        _currentRenderPass->clearColorTargets.resize(
+            vkfb->GetDesc().colorTargets.size(), {}
+        );
+
+        _RegisterAttachmentUsage(vkfb);
         _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
 
         //Init attachment containers
@@ -479,8 +993,36 @@ namespace Veldrid{
     }
     void VulkanCommandList::EndRenderPass(){
         CHK_RENDERPASS_BEGUN();
-        vkCmdEndRenderPass(_cmdBuf);
-        DEBUGCODE(_currentRenderPass = nullptr);
+        //The pass of a secondary belongs to its primary
+        assert(!_isSecondary);
+        //Clears without any draw still have to reach the attachments
+        if (_currentRenderPass->HasPendingClears()) {
+            _EnsureRenderPassActive();
+            _FlushPendingClears();
+        }
+        _EndActiveRenderPass();
+
+        //Render passes leave color targets in attachment layout,
+        //presented images are moved to present layout once the pass
+        //has really ended.
+        auto* vkfb = _currentRenderPass->fb.get();
+        if (vkfb->IsPresented()) {
+            vkfb->VisitAttachments([&](
+                const sp<VulkanTexture>& vkTarget,
+                VulkanFramebufferBase::VisitedAttachmentType type,
+                const _TexSubresRange& range) {
+                    if (type != VulkanFramebufferBase::VisitedAttachmentType::ColorAttachment) return;
+                    _resReg.RegisterTexUsage(vkTarget,
+                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        0,
+                        range
+                    );
+                }
+            );
+            _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
+        }
+        _currentRenderPass = nullptr;
 
 
         //_currentFramebuffer.TransitionToIntermediateLayout(_cb);
@@ -501,6 +1043,59 @@ namespace Veldrid{
         //    null);
     }
 
+    std::vector<sp<CommandList>> VulkanCommandList::ForkSecondaries(std::uint32_t count) {
+        CHK_RENDERPASS_BEGUN();
+        assert(!_isSecondary);
+
+        std::vector<sp<CommandList>> secondaries;
+        secondaries.reserve(count);
+        for (std::uint32_t i = 0; i < count; i++) {
+            //Secondaries of a reusable list are replayed with it
+            auto cmdList = new VulkanCommandList(dev, description);
+            cmdList->_isSecondary = true;
+            cmdList->_cmdBuf = VK_NULL_HANDLE;
+            cmdList->_inheritedFb = _currentRenderPass->fb;
+            secondaries.emplace_back(cmdList);
+        }
+        return secondaries;
+    }
+
+    void VulkanCommandList::JoinSecondaries(const std::vector<sp<CommandList>>& secondaries) {
+        CHK_RENDERPASS_BEGUN();
+        assert(!_isSecondary);
+        if (secondaries.empty()) return;
+
+        _secondaryCmdBufs.clear();
+        for (auto& cmdList : secondaries) {
+            auto* vkCmdList = PtrCast<VulkanCommandList>(cmdList.get());
+            assert(vkCmdList->_isSecondary);
+            assert(vkCmdList->_inheritedFb.get() == _currentRenderPass->fb.get());
+
+            //Synchronize what the secondary uses before the pass resumes
+            _resReg.MergeUsages(vkCmdList->_resReg);
+            //The secondary holds the resources it used
+            _miscResReg.insert(cmdList);
+            //Its transient sets live as long as this submission
+            _transientPools.insert(_transientPools.end(),
+                vkCmdList->_transientPools.begin(), vkCmdList->_transientPools.end());
+            vkCmdList->_transientPools.clear();
+            _secondaryCmdBufs.push_back(vkCmdList->GetHandle());
+        }
+        _FlushBarriers();
+
+        //Partial clears are recorded inline ahead of the secondaries
+        if (_currentRenderPass->HasPendingClears() && !_currentRenderPass->CanFoldClears()) {
+            _EnsureRenderPassActive(VK_SUBPASS_CONTENTS_INLINE);
+            _FlushPendingClears();
+        }
+        _EnsureRenderPassActive(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+        vkCmdExecuteCommands(_cmdBuf, _secondaryCmdBufs.size(), _secondaryCmdBufs.data());
+
+        //Bound state is undefined after executing secondaries
+        _InvalidateBoundState();
+    }
+
     
     void VulkanCommandList::SetVertexBuffer(
         std::uint32_t index, const sp<Buffer>& buffer, std::uint32_t offset
@@ -509,10 +1104,12 @@ namespace Veldrid{
             VkPipelineStageFlagBits::VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
             VkAccessFlagBits::VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
         );
-        _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
+        _FlushBarriers();
         VulkanBuffer* vkBuffer = PtrCast<VulkanBuffer>(buffer.get());
-        std::uint64_t offset64 = offset;
-        vkCmdBindVertexBuffers(_cmdBuf, index, 1, &(vkBuffer->GetHandle()), &offset64);
+        //Bound lazily before next draw, adjacent slots in one call
+        if (!_vertexBindings.Set(index, { vkBuffer->GetHandle(), offset })) {
+            _stateCacheStats.elidedVertexBuffers++;
+        }
     }
 
     void VulkanCommandList::SetIndexBuffer(
@@ -522,28 +1119,68 @@ namespace Veldrid{
             VkPipelineStageFlagBits::VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
             VkAccessFlagBits::VK_ACCESS_INDEX_READ_BIT
         );
-        _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
+        _FlushBarriers();
         VulkanBuffer* vkBuffer = PtrCast<VulkanBuffer>(buffer.get());
-        vkCmdBindIndexBuffer(_cmdBuf, vkBuffer->GetHandle(), offset, VdToVkIndexFormat(format));
+        _IndexBinding binding{ vkBuffer->GetHandle(), offset, VdToVkIndexFormat(format) };
+        if (binding.buffer == _indexBinding.buffer
+            && binding.offset == _indexBinding.offset
+            && binding.type == _indexBinding.type
+        ) {
+            _stateCacheStats.elidedIndexBuffers++;
+            return;
+        }
+        _indexBinding = binding;
+        vkCmdBindIndexBuffer(_cmdBuf, binding.buffer, binding.offset, binding.type);
     }
 
     
-    void VulkanCommandList::SetGraphicsResourceSet(
-        std::uint32_t slot, 
-        const sp<ResourceSet>& rs, 
-        const std::vector<std::uint32_t>& dynamicOffsets
+    void VulkanCommandList::SetPushConstants(
+        std::uint32_t offset, std::uint32_t size, const void* data
     ){
         CHK_PIPELINE_SET();
-        assert(slot < _resourceSets.size());
-        assert(!_currentPipeline->IsComputePipeline());
+        assert(offset % 4 == 0 && size % 4 == 0);
+
+        auto stages = _currentPipeline->GetPushConstantStages(offset, size);
+        //Not declared in the pipeline description, the range can't be written
+        assert(stages != 0);
+        if (stages == 0) return;
+
+        //Allowed inside and outside render passes, recorded right away
+        vkCmdPushConstants(_cmdBuf, _currentPipeline->GetLayout(), stages, offset, size, data);
+    }
 
+    void VulkanCommandList::_SetResourceSet(
+        _BindPointSets& bound,
+        std::uint32_t slot,
+        const sp<ResourceSet>& rs,
+        const std::vector<std::uint32_t>& dynamicOffsets
+    ){
         auto vkrs = PtrCast<VulkanResourceSet>(rs.get());
 
-        auto& entry = _resourceSets[slot];
+        auto& entry = bound.sets[slot];
+        if (entry.resSet.get() == vkrs && entry.offsets == dynamicOffsets) {
+            //Already bound, skip the descriptor set bind
+            entry.needsUsageRegister = true;
+            _stateCacheStats.elidedResourceSets++;
+            return;
+        }
         entry.isNewlyChanged = true;
         entry.resSet = RefRawPtr(vkrs);
         entry.offsets = dynamicOffsets;
     }
+
+    void VulkanCommandList::SetGraphicsResourceSet(
+        std::uint32_t slot, 
+        const sp<ResourceSet>& rs, 
+        const std::vector<std::uint32_t>& dynamicOffsets
+    ){
+        CHK_PIPELINE_SET();
+        assert(!_currentPipeline->IsComputePipeline());
+        auto& bound = _SetsOf(false);
+        assert(slot < bound.sets.size());
+
+        _SetResourceSet(bound, slot, rs, dynamicOffsets);
+    }
         
     void VulkanCommandList::SetComputeResourceSet(
         std::uint32_t slot, 
@@ -551,15 +1188,21 @@ namespace Veldrid{
         const std::vector<std::uint32_t>& dynamicOffsets
     ){
         CHK_PIPELINE_SET();
-        assert(slot < _resourceSets.size());
         assert(_currentPipeline->IsComputePipeline());
+        auto& bound = _SetsOf(true);
+        assert(slot < bound.sets.size());
 
-        auto vkrs = PtrCast<VulkanResourceSet>(rs.get());
+        _SetResourceSet(bound, slot, rs, dynamicOffsets);
+    }
 
-        auto& entry = _resourceSets[slot];
-        entry.isNewlyChanged = true;
-        entry.resSet = RefRawPtr(vkrs);
-        entry.offsets = dynamicOffsets;
+    sp<ResourceSet> VulkanCommandList::CreateTransientResourceSet(const ResourceSet::Description& desc) {
+        auto* vkDev = PtrCast<VulkanDevice>(dev.get());
+        auto* vkLayout = PtrCast<VulkanResourceLayout>(desc.layout.get());
+
+        auto set = vkDev->AllocateTransientDescriptorSet(
+            _transientPools, vkLayout->GetHandle(), vkLayout->GetResourceCounts());
+        if (set == VK_NULL_HANDLE) return nullptr;
+        return VulkanResourceSet::MakeTransient(RefRawPtr(vkDev), desc, set);
     }
 
     
@@ -671,7 +1314,10 @@ namespace Veldrid{
             vkViewport.minDepth = viewport.minDepth;
             vkViewport.maxDepth = viewport.maxDepth;
             
-            vkCmdSetViewport(_cmdBuf, index, 1, &vkViewport);
+            //Recorded before next draw
+            if (!_viewports.Set(index, vkViewport)) {
+                _stateCacheStats.elidedViewports++;
+            }
         }
     }
     void VulkanCommandList::SetFullViewport(std::uint32_t index) {
@@ -698,11 +1344,9 @@ namespace Veldrid{
         if (index == 0 || gd->GetFeatures().multipleViewports) {
 
             VkRect2D scissor{(int)x, (int)y, (int)width, (int)height};
-            //if (_scissorRects[index] != scissor)
-            //{
-            //    _scissorRects[index] = scissor;
-                vkCmdSetScissor(_cmdBuf, index, 1, &scissor);
-            //}
+            if (!_scissors.Set(index, scissor)) {
+                _stateCacheStats.elidedScissors++;
+            }
         }
     }
     void VulkanCommandList::SetFullScissorRect(std::uint32_t index){
@@ -723,72 +1367,24 @@ namespace Veldrid{
     }
 
     void VulkanCommandList::_RegisterResourceSetUsage(VkPipelineBindPoint bindPoint) {
-        VkPipelineStageFlags accessStage = 0;
-        switch (bindPoint)
-        {
-        case VK_PIPELINE_BIND_POINT_GRAPHICS:
-            accessStage = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
-            break;
-        case VK_PIPELINE_BIND_POINT_COMPUTE:
-            accessStage = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-            break;
-        case VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR:
-            accessStage = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
-            break;
-        default:
-            break;
-        }
-       
-        for (auto& set : _resourceSets) {
-            if (!set.isNewlyChanged) continue;
+        for (auto& set : _SetsOf(bindPoint).sets) {
+            if (!set.isNewlyChanged && !set.needsUsageRegister) continue;
+            set.needsUsageRegister = false;
 
             assert(set.resSet != nullptr); // all sets should be set already
-            auto& desc = set.resSet->GetDesc();
-            VulkanResourceLayout* vkLayout = PtrCast<VulkanResourceLayout>(desc.layout.get());
-            for (unsigned i = 0; i < desc.boundResources.size(); i++) {
-                auto& elem = vkLayout->GetDesc().elements[i];
-                auto& res = desc.boundResources[i];
-                auto type = elem.kind;
-                using _ResKind = ResourceLayout::Description::ElementDescription::ResourceKind;
-                switch (type) {
-                case _ResKind::UniformBuffer:
-                case _ResKind::StructuredBufferReadOnly: {
-                    auto* range = PtrCast<BufferRange>(res.get());
-                    auto* rangedVkBuffer = reinterpret_cast<VulkanBuffer*>(range->GetBufferObject());
-                    _resReg.RegisterBufferUsage(RefRawPtr(rangedVkBuffer), accessStage, VK_ACCESS_SHADER_READ_BIT);
-                } break;
-                case _ResKind::StructuredBufferReadWrite: {
-                    auto* range = PtrCast<BufferRange>(res.get());
-                    auto* rangedVkBuffer = reinterpret_cast<VulkanBuffer*>(range->GetBufferObject());
-                    _resReg.RegisterBufferUsage(RefRawPtr(rangedVkBuffer), accessStage,
-                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
-                } break;
-
-                case _ResKind::TextureReadOnly: {
-                    auto* vkTexView = PtrCast<VulkanTextureView>(res.get());
-                    auto vkTex = PtrCast<VulkanTexture>(vkTexView->GetTarget().get());
-                    _resReg.RegisterTexUsage(
-                        RefRawPtr(vkTex),
-                        VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                        accessStage, VK_ACCESS_SHADER_READ_BIT);
-                }break;
-
-                case _ResKind::TextureReadWrite: {
-                    auto* vkTexView = PtrCast<VulkanTextureView>(res.get());
-                    auto vkTex = PtrCast<VulkanTexture>(vkTexView->GetTarget().get());
-                    _resReg.RegisterTexUsage(
-                        RefRawPtr(vkTex),
-                        VkImageLayout::VK_IMAGE_LAYOUT_GENERAL,
-                        accessStage,
-                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
-                    );
-                }break;
-                default:break;
-                }
+            //The set keeps its resources alive, hold the set once per bind
+            if (set.isNewlyChanged) {
+                _miscResReg.insert(set.resSet);
+            }
+            for (auto& usage : set.resSet->GetBufferUsages()) {
+                _resReg.RegisterBufferUsage(usage.buffer, usage.stage, usage.access);
+            }
+            for (auto& usage : set.resSet->GetTextureUsages()) {
+                _resReg.RegisterTexUsage(usage.texture, usage.layout, usage.stage, usage.access, usage.range);
             }
         }
 
-        _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
+        _FlushBarriers();
     }
 
     void VulkanCommandList::_FlushNewResourceSets(
@@ -796,6 +1392,7 @@ namespace Veldrid{
     ) {
         auto pipeline = _currentPipeline;
         auto resourceSetCount = pipeline->GetResourceSetCount();
+        auto& boundSets = _SetsOf(bindPoint).sets;
 
         std::vector<VkDescriptorSet> descriptorSets;
         descriptorSets.reserve(resourceSetCount);
@@ -807,23 +1404,19 @@ namespace Veldrid{
         for (unsigned currentSlot = 0; currentSlot < resourceSetCount; currentSlot++)
         {
             bool batchEnded 
-                =  !_resourceSets[currentSlot].isNewlyChanged
+                =  !boundSets[currentSlot].isNewlyChanged
                 || currentSlot == resourceSetCount - 1;
 
-            if (_resourceSets[currentSlot].isNewlyChanged)
+            if (boundSets[currentSlot].isNewlyChanged)
             {
                 //Flip the flag, since this set has been read
-                _resourceSets[currentSlot].isNewlyChanged = false;
+                boundSets[currentSlot].isNewlyChanged = false;
                 // Increment ref count on first use of a set.
-                _miscResReg.insert(_resourceSets[currentSlot].resSet);
 
-                VulkanResourceSet* vkSet = _resourceSets[currentSlot].resSet.get();
-                auto& desc = vkSet->GetDesc();
-                VulkanResourceLayout* vkLayout = PtrCast<VulkanResourceLayout>(desc.layout.get());
-                
+                VulkanResourceSet* vkSet = boundSets[currentSlot].resSet.get();
                 descriptorSets.push_back(vkSet->GetHandle());
 
-                auto& curSetOffsets = _resourceSets[currentSlot].offsets;
+                auto& curSetOffsets = boundSets[currentSlot].offsets;
                 //for (unsigned i = 0; i < curSetOffsets.size(); i++)
                 //{
                 //    dynamicOffsets[currentBatchDynamicOffsetCount] = curSetOffsets.Get(i);
@@ -856,99 +1449,146 @@ namespace Veldrid{
         }
     }
 
-    void VulkanCommandList::PreDrawCommand(){
-        //Run some checks
-        //TODO:Handle renderpass end after begun but no draw command
+    void VulkanCommandList::_EnsureRenderPassActive(VkSubpassContents contents) {
         CHK_RENDERPASS_BEGUN();
-        //We have a pipeline
-        assert(_currentPipeline != nullptr);
-        //And the pipeline is a graphics one
-        assert(!_currentPipeline->IsComputePipeline());
-
-        //Register resource sets
-        _RegisterResourceSetUsage(VK_PIPELINE_BIND_POINT_GRAPHICS);
+        if (_currentRenderPass->isActive) {
+            if (_currentRenderPass->contents == contents) return;
+            _EndActiveRenderPass();
+        }
 
-        //Begin renderpass
         VulkanFramebufferBase* vkfb = _currentRenderPass->fb.get();
-        _currentRenderPass->fb = RefRawPtr(vkfb);
 
+        //Attachments might have been touched by transfer commands
+        //since the pass was suspended.
+        if (_currentRenderPass->isSuspended) {
+            _RegisterAttachmentUsage(vkfb);
+            _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
+        }
+
+        auto& desc = vkfb->GetDesc();
         VkRenderPassBeginInfo renderPassBI{};
         renderPassBI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassBI.renderArea = VkRect2D{ {0, 0}, {vkfb->GetDesc().GetWidth(), vkfb->GetDesc().GetHeight()} };
+        renderPassBI.renderArea = VkRect2D{ {0, 0}, {desc.GetWidth(), desc.GetHeight()} };
         renderPassBI.framebuffer = vkfb->GetHandle();
 
-        renderPassBI.renderPass = vkfb->GetRenderPassNoClear_Load();
-        vkCmdBeginRenderPass(_cmdBuf, &renderPassBI, VkSubpassContents::VK_SUBPASS_CONTENTS_INLINE);
+        //Fold clears into loadOp when every attachment has one
+        std::vector<VkClearValue> clearValues;
+        if (_currentRenderPass->CanFoldClears()) {
+            clearValues.resize(_currentRenderPass->clearColorTargets.size());
+            for (unsigned i = 0; i < clearValues.size(); i++) {
+                clearValues[i].color = _currentRenderPass->clearColorTargets[i].value();
+                _currentRenderPass->clearColorTargets[i].reset();
+            }
+            if (desc.HasDepthTarget()) {
+                clearValues.emplace_back();
+                clearValues.back().depthStencil = _currentRenderPass->clearDSTarget.value();
+                _currentRenderPass->clearDSTarget.reset();
+            }
+            renderPassBI.renderPass = vkfb->GetRenderPassClear();
+            renderPassBI.clearValueCount = clearValues.size();
+            renderPassBI.pClearValues = clearValues.data();
+        } else {
+            renderPassBI.renderPass = vkfb->GetRenderPassNoClear_Load();
+        }
+
+        vkCmdBeginRenderPass(_cmdBuf, &renderPassBI, contents);
+        _currentRenderPass->isActive = true;
+        _currentRenderPass->contents = contents;
+    }
+
+    void VulkanCommandList::_EndActiveRenderPass() {
+        if (_currentRenderPass == nullptr || !_currentRenderPass->isActive) return;
+        //Transfers and dispatches can't be recorded into a secondary
+        assert(!_isSecondary);
+
+        vkCmdEndRenderPass(_cmdBuf);
+        _currentRenderPass->isActive = false;
+        _currentRenderPass->isSuspended = true;
+    }
+
+    void VulkanCommandList::_FlushBarriers() {
+        if (!_resReg.HasPendingBarriers()) return;
+
+        //A secondary can't leave the inherited pass. The state it expects
+        //on entry is synchronized by the primary when joined, a hazard
+        //between two of its own commands can't be. The command is not
+        //recorded, such work has to be split across secondaries or
+        //recorded by the primary.
+        if (_isSecondary) {
+            throw std::runtime_error(
+                "secondary command list needs a barrier between its own commands!");
+        }
+
+        //Barriers are not allowed inside a render pass
+        _EndActiveRenderPass();
+        _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
+    }
+
+    void VulkanCommandList::_FlushPendingClears() {
+        assert(_currentRenderPass != nullptr && _currentRenderPass->isActive);
+        assert(_currentRenderPass->contents == VK_SUBPASS_CONTENTS_INLINE);
 
-        //Clear values?        
+        auto& fb = _currentRenderPass->fb;
         std::vector<VkClearAttachment> clearAttachments;
         for (unsigned i = 0; i < _currentRenderPass->clearColorTargets.size(); i++) {
-            if (_currentRenderPass->clearColorTargets[i].has_value()) {
+            auto& clearColor = _currentRenderPass->clearColorTargets[i];
+            if (clearColor.has_value()) {
                 clearAttachments.push_back({});
                 VkClearAttachment& clearAttachment = clearAttachments.back();
-                clearAttachment.clearValue.color = _currentRenderPass->clearColorTargets[i].value();
-                ////if (_activeRenderPass != VkRenderPass.Null)
-                //{
-                //    auto& fb = _currentRenderPass->fb;
-                    clearAttachment.colorAttachment = i;
-                    clearAttachment.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
-                //
-                    
-                //
-                //    vkCmdClearAttachments(_cmdBuf, 1, &clearAttachment, 1, &clearRect);
-                //}
-                //else
-                //{
-                //    // Queue up the clear value for the next RenderPass.
-                //    _clearValues[index] = clearValue;
-                //    _validColorClearValues[index] = true;
-                //}
+                clearAttachment.clearValue.color = clearColor.value();
+                clearAttachment.colorAttachment = i;
+                clearAttachment.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT;
+                clearColor.reset();
             }
         }
         if (_currentRenderPass->clearDSTarget.has_value()) {
             clearAttachments.push_back({});
             VkClearAttachment& clearAttachment = clearAttachments.back();
             clearAttachment.clearValue.depthStencil = _currentRenderPass->clearDSTarget.value();
-            auto& fb = _currentRenderPass->fb;
-            
             clearAttachment.aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_DEPTH_BIT;
             if(Helpers::FormatHelpers::IsStencilFormat(
                 fb->GetDesc().depthTarget.target->GetDesc().format
             )){
                 clearAttachment.aspectMask |= VkImageAspectFlagBits::VK_IMAGE_ASPECT_STENCIL_BIT;
-            }     
-           
+            }
+            _currentRenderPass->clearDSTarget.reset();
         }
 
         if (!clearAttachments.empty()) {
             VkClearRect clearRect{};
             clearRect.baseArrayLayer = 0;
             clearRect.layerCount = 1;
-            clearRect.rect = { 0, 0, vkfb->GetDesc().GetWidth(), vkfb->GetDesc().GetHeight()};
+            clearRect.rect = { 0, 0, fb->GetDesc().GetWidth(), fb->GetDesc().GetHeight()};
             vkCmdClearAttachments(
                 _cmdBuf, 
                 clearAttachments.size(), clearAttachments.data(),
                 1, &clearRect
             );
         }
+    }
+
+    void VulkanCommandList::PreDrawCommand(){
+        //Run some checks
+        CHK_RENDERPASS_BEGUN();
+        //We have a pipeline
+        assert(_currentPipeline != nullptr);
+        //And the pipeline is a graphics one
+        assert(!_currentPipeline->IsComputePipeline());
+
+        //Register resource sets, this may suspend the render pass
+        //if a barrier is required.
+        _RegisterResourceSetUsage(VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+        //Begin renderpass only if it is not already running
+        _EnsureRenderPassActive();
+
+        _FlushDynamicStates();
+
+        //Partial clears are done inside the pass
+        _FlushPendingClears();
 
         //Bind resource sets
         _FlushNewResourceSets(VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS);
-        
-        //Begin render pass
-
-        //Might have image transition commands?
-        //    TransitionImages(_preDrawSampledImages, VkImageLayout.ShaderReadOnlyOptimal);
-        //    _preDrawSampledImages.Clear();
-        //
-        //    EnsureRenderPassActive();
-        //
-        //    FlushNewResourceSets(
-        //        _currentGraphicsResourceSets,
-        //        _graphicsResourceSetsChanged,
-        //        _currentGraphicsPipeline.ResourceSetCount,
-        //        VkPipelineBindPoint.Graphics,
-        //        _currentGraphicsPipeline.PipelineLayout);
     }
 
     void VulkanCommandList::Draw(
@@ -999,8 +1639,8 @@ namespace Veldrid{
     
     void VulkanCommandList::PreDispatchCommand() {
         //Run some checks
-        //TODO:Handle renderpass end after begun but no draw command
-        CHK_RENDERPASS_ENDED();
+        //Dispatches can't be recorded inside a render pass
+        _EndActiveRenderPass();
         //We have a pipeline
         assert(_currentPipeline != nullptr);
         //And the pipeline is a compute one
@@ -1051,11 +1691,24 @@ namespace Veldrid{
     };
 
     void VulkanCommandList::ResolveTexture(const sp<Texture>& source, const sp<Texture>& destination) {
+        _EndActiveRenderPass();
         
+        _resReg.RegisterTexUsage(source,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT,
+            { 0, 1, 0, 1 }
+        );
+        _resReg.RegisterTexUsage(destination,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            { 0, 1, 0, 1 }
+        );
+        _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
+
         VulkanTexture* vkSource = PtrCast<VulkanTexture>(source.get());
-        _devRes.insert(source);
         VulkanTexture* vkDestination = PtrCast<VulkanTexture>(destination.get());
-        _devRes.insert(destination);
 
         VkImageAspectFlags aspectFlags = (source->GetDesc().usage.depthStencil)
             ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT
@@ -1073,10 +1726,6 @@ namespace Veldrid{
         region.dstSubresource.mipLevel = 0;
         region.dstSubresource.aspectMask = aspectFlags;
         
-        //TODO:Implement full image layout tracking and transition systems
-        //vkSource.TransitionImageLayout(_cmdBuf, 0, 1, 0, 1, VkImageLayout.TransferSrcOptimal);
-        //vkDestination.TransitionImageLayout(_cmdBuf, 0, 1, 0, 1, VkImageLayout.TransferDstOptimal);
-
         vkCmdResolveImage(
             _cmdBuf,
             vkSource->GetHandle(),
@@ -1085,11 +1734,6 @@ namespace Veldrid{
             VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             1,
             &region);
-
-        if (vkDestination->GetDesc().usage.sampled)
-        {
-            //vkDestination.TransitionImageLayout(_cmdBuf, 0, 1, 0, 1, VkImageLayout.ShaderReadOnlyOptimal);
-        }
     }
 
     void VulkanCommandList::UpdateBuffer(
@@ -1098,10 +1742,40 @@ namespace Veldrid{
         void* source,
         std::uint32_t sizeInBytes
     ) {
-        //VkBuffer stagingBuffer = GetStagingBuffer(sizeInBytes);
-        //    _gd.UpdateBuffer(stagingBuffer, 0, source, sizeInBytes);
-        //    CopyBuffer(stagingBuffer, 0, buffer, bufferOffsetInBytes, sizeInBytes);
-        
+        //Nothing to copy, keep the render pass going
+        if (sizeInBytes == 0) return;
+        _EndActiveRenderPass();
+
+        _resReg.RegisterBufferUsage(buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT
+        );
+        _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
+
+        auto* dstVkBuffer = PtrCast<VulkanBuffer>(buffer.get());
+
+        //Small payloads are inlined into the command buffer,
+        //subject to vkCmdUpdateBuffer's size & alignment rules.
+        constexpr std::uint32_t maxInlineUpdateSize = 65536;
+        if (sizeInBytes <= maxInlineUpdateSize
+            && (sizeInBytes % 4) == 0
+            && (bufferOffsetInBytes % 4) == 0
+        ) {
+            vkCmdUpdateBuffer(_cmdBuf, dstVkBuffer->GetHandle(), bufferOffsetInBytes, sizeInBytes, source);
+            return;
+        }
+
+        VkBuffer stagingBuffer;
+        VkDeviceSize stagingOffset;
+        auto* mapped = _AllocateStaging(sizeInBytes, stagingBuffer, stagingOffset);
+        memcpy(mapped, source, sizeInBytes);
+
+        VkBufferCopy region{};
+        region.srcOffset = stagingOffset;
+        region.dstOffset = bufferOffsetInBytes;
+        region.size = sizeInBytes;
+
+        vkCmdCopyBuffer(_cmdBuf, stagingBuffer, dstVkBuffer->GetHandle(), 1, &region);
     }
 
 
@@ -1119,7 +1793,7 @@ namespace Veldrid{
         std::uint32_t width, std::uint32_t height, std::uint32_t depth,
         std::uint32_t layerCount
     ){
-        CHK_RENDERPASS_ENDED();
+        _EndActiveRenderPass();
 
         _resReg.RegisterBufferUsage(source,
             VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -1129,7 +1803,8 @@ namespace Veldrid{
         _resReg.RegisterTexUsage(destination,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_ACCESS_TRANSFER_WRITE_BIT
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            { dstMipLevel, 1, dstBaseArrayLayer, layerCount }
         );
 
         _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
@@ -1248,12 +1923,13 @@ namespace Veldrid{
         std::uint32_t width, std::uint32_t height, std::uint32_t depth,
         std::uint32_t layerCount
     ) {
-        CHK_RENDERPASS_ENDED();
+        _EndActiveRenderPass();
 
         _resReg.RegisterTexUsage(source,
             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
             VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_ACCESS_TRANSFER_READ_BIT
+            VK_ACCESS_TRANSFER_READ_BIT,
+            { srcMipLevel, 1, srcBaseArrayLayer, layerCount }
         );
         _resReg.RegisterBufferUsage(destination,
             VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -1341,7 +2017,7 @@ namespace Veldrid{
         const sp<Buffer>& destination, std::uint32_t destinationOffset, 
         std::uint32_t sizeInBytes
     ){
-        CHK_RENDERPASS_ENDED();
+        _EndActiveRenderPass();
         _resReg.RegisterBufferUsage(source,
             VK_PIPELINE_STAGE_TRANSFER_BIT,
             VK_ACCESS_TRANSFER_READ_BIT
@@ -1350,6 +2026,7 @@ namespace Veldrid{
             VK_PIPELINE_STAGE_TRANSFER_BIT,
             VK_ACCESS_TRANSFER_WRITE_BIT
         );
+        _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
 
         auto* srcVkBuffer = PtrCast<VulkanBuffer>(source.get());
         auto* dstVkBuffer = PtrCast<VulkanBuffer>(destination.get());
@@ -1387,17 +2064,19 @@ namespace Veldrid{
         std::uint32_t width, std::uint32_t height, std::uint32_t depth,
         std::uint32_t layerCount
     ){
-        CHK_RENDERPASS_ENDED();
+        _EndActiveRenderPass();
 
         _resReg.RegisterTexUsage(source,
             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
             VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_ACCESS_TRANSFER_READ_BIT
+            VK_ACCESS_TRANSFER_READ_BIT,
+            { srcMipLevel, 1, srcBaseArrayLayer, layerCount }
         );
         _resReg.RegisterTexUsage(destination,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_ACCESS_TRANSFER_WRITE_BIT
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            { dstMipLevel, 1, dstBaseArrayLayer, layerCount }
         );
 
         _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
@@ -1474,23 +2153,11 @@ namespace Veldrid{
     }
 
     void VulkanCommandList::GenerateMipmaps(const sp<Texture>& texture){
-        CHK_RENDERPASS_ENDED();
+        _EndActiveRenderPass();
         auto vkDev = PtrCast<VulkanDevice>(dev.get());
         auto vkTex = PtrCast<VulkanTexture>(texture.get());
-        _devRes.insert(texture);
-
-        _resReg.RegisterTexUsage(texture,
-            VK_IMAGE_LAYOUT_GENERAL,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_ACCESS_TRANSFER_READ_BIT
-        );
 
-        _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
-
-        auto layerCount = vkTex->GetDesc().arrayLayers;
-        if (vkTex->GetDesc().usage.cubemap) {
-            layerCount *= 6;
-        }
+        auto layerCount = vkTex->GetLayerCount();
 
         VkImageBlit region;
 
@@ -1510,8 +2177,21 @@ namespace Veldrid{
                 
             
         for (unsigned level = 1; level < vkTex->GetDesc().mipLevels; level++) {
-            //vkTex.TransitionImageLayoutNonmatching(_cb, level - 1, 1, 0, layerCount, VkImageLayout.TransferSrcOptimal);
-            //vkTex.TransitionImageLayoutNonmatching(_cb, level, 1, 0, layerCount, VkImageLayout.TransferDstOptimal);
+            //Only the two mips involved are transitioned, previous
+            //destination becomes the next source.
+            _resReg.RegisterTexUsage(texture,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_READ_BIT,
+                { level - 1, 1, 0, layerCount }
+            );
+            _resReg.RegisterTexUsage(texture,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+                { level, 1, 0, layerCount }
+            );
+            _resReg.InsertPipelineBarrierIfNecessary(_cmdBuf);
 
             VkImage deviceImage = vkTex->GetHandle();
             auto mipWidth = std::max(width >> 1, 1U);
@@ -1533,30 +2213,10 @@ namespace Veldrid{
             region.dstSubresource.layerCount = layerCount;
             region.dstSubresource.mipLevel = level;
 
-            //if (!_filters.TryGetValue(format, out VkFilter filter))
-            if (level > 1) {
-                //Beyond first transition, barrier needed
-                VkImageMemoryBarrier memBarrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
-                memBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                memBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                memBarrier.image = deviceImage;
-                memBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-                memBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-                memBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                memBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-                vkCmdPipelineBarrier(_cmdBuf,
-                    VK_PIPELINE_STAGE_TRANSFER_BIT,
-                    VK_PIPELINE_STAGE_TRANSFER_BIT,
-                    0,
-                    0, nullptr,
-                    0, nullptr,
-                    1, &memBarrier
-                );
-            }
             vkCmdBlitImage(
                 _cmdBuf,
-                deviceImage, VkImageLayout::VK_IMAGE_LAYOUT_GENERAL,
-                deviceImage, VkImageLayout::VK_IMAGE_LAYOUT_GENERAL,
+                deviceImage, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                deviceImage, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 1, &region,
                 filter);
 
@@ -1564,17 +2224,6 @@ namespace Veldrid{
             height = mipHeight;
             depth = mipDepth;
         }
-
-        //if ((vkTex.Usage & TextureUsage.Sampled) != 0)
-        //{
-        //    vkTex.TransitionImageLayoutNonmatching(_cb, 0, vkTex.MipLevels, 0, layerCount, VkImageLayout.ShaderReadOnlyOptimal);
-        //}
-        _resReg.ModifyTexUsage(
-            texture,
-            VK_IMAGE_LAYOUT_GENERAL,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_ACCESS_TRANSFER_WRITE_BIT
-        );
     }
 
     void VulkanCommandList::PushDebugGroup(const std::string& name) {};
@@ -6,20 +6,21 @@
 #include "veldrid/CommandList.hpp"
 
 #include <vector>
+#include <cstring>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "VulkanPipeline.hpp"
 #include "VulkanBindableResource.hpp"
 #include "VulkanFramebuffer.hpp"
+#include "VkStagingBufferMgr.hpp"
+#include "VkFixupCmdMgr.hpp"
 
-//TODO: a system to track image layouts inside a command buffer and
-//insert image layout transition commands when necessary. also each
-//VulkanTexture should record its last known layout(changed by tracking
-// system during a command buffer commit).
-
-//Because the unordered nature of command buffer execute order, multiple
-// command buffer referencing the same texture
+//Resource states are tracked per command list while recording, each
+//list assumes the state it needs on first use and records what it
+//leaves behind. VulkanDevice::SubmitCommand resolves these against the
+//state left by previous submissions and prepends fixup barriers, so
+//lists can be recorded in parallel and submitted in any order.
 
 namespace Veldrid
 {
@@ -28,6 +29,32 @@ namespace Veldrid
     class VulkanTexture;
     struct _CmdPoolContainer;
 
+    //Open addressing pointer -> index map. Clearing only bumps a stamp,
+    //so the storage is reused across recordings without reallocation.
+    class _PtrIndexMap {
+        struct Entry {
+            const void* key;
+            std::uint32_t value;
+            std::uint32_t stamp;
+        };
+
+        std::vector<Entry> _entries;
+        std::uint32_t _stamp = 1;
+        std::uint32_t _count = 0;
+
+        static std::size_t _Hash(const void* key) {
+            auto v = reinterpret_cast<std::uintptr_t>(key);
+            return (v >> 4) ^ (v >> 13);
+        }
+
+        void _Grow();
+
+    public:
+        const std::uint32_t* Find(const void* key) const;
+        void Insert(const void* key, std::uint32_t value);
+        void Clear();
+    };
+
     //Register data access and insert pipeline where necessary
     class _DevResRegistry {
 
@@ -46,10 +73,38 @@ namespace Veldrid
             VkImageLayout layout;
         };
 
+        //first: state the recording expects on entry, resolved against
+        //  the previous submissions by VulkanDevice::SubmitCommand.
+        //last: state the recording leaves the resource in.
+        //firstOpen: no barrier recorded yet, accesses still merge into first.
+        struct BufSlot {
+            VulkanBuffer* resource;
+            BufRef first, last;
+            bool firstOpen;
+        };
 
-        std::unordered_set<sp<DeviceResource>> _res;
-        std::unordered_map<VulkanBuffer*, BufRef> _bufRefs;
-        std::unordered_map<VulkanTexture*, TexRef> _texRefs;
+        //Texture state is tracked per subresource, tracks of a slot are
+        //stored contiguously in _texTracks (layer major).
+        //A track with stage 0 was not touched in this recording yet.
+        struct TexTrack {
+            TexRef first, last;
+            bool firstOpen;
+        };
+
+        struct TexSlot {
+            VulkanTexture* resource;
+            std::uint32_t firstTrack;
+        };
+
+        //Unique per recording, resources tagged with another generation
+        //are looked up in _slotLookup instead.
+        std::uint32_t _generation;
+
+        std::vector<sp<DeviceResource>> _res;
+        std::vector<BufSlot> _bufSlots;
+        std::vector<TexSlot> _texSlots;
+        std::vector<TexTrack> _texTracks;
+        _PtrIndexMap _slotLookup;
 
         struct BufSyncInfo{
             VulkanBuffer* resource;
@@ -58,13 +113,41 @@ namespace Veldrid
 
         struct TexSyncInfo {
             VulkanTexture* resource;
+            _TexSubresRange range;
             TexRef prevUsage, currUsage;
         };
 
         std::vector<BufSyncInfo> _bufSyncs;
         std::vector<TexSyncInfo> _texSyncs;
 
+        //Scratch storage reused by every barrier
+        std::vector<VkBufferMemoryBarrier> _bufBarriers;
+        std::vector<VkImageMemoryBarrier> _imgBarriers;
+
+        //Returns slot index, isNew is set when the resource is first
+        //used in this recording.
+        std::uint32_t _GetBufSlot(VulkanBuffer* buf, bool& isNew);
+        std::uint32_t _GetTexSlot(VulkanTexture* tex, bool& isNew);
+
+        //Returns true on first use
+        bool _RegisterBufferUsage(VulkanBuffer* buffer, VkPipelineStageFlags stage, VkAccessFlags access);
+        bool _RegisterTexUsage(
+            VulkanTexture* tex, VkImageLayout requiredLayout,
+            VkPipelineStageFlags stage, VkAccessFlags access,
+            const _TexSubresRange& range);
+
+        //Queue a transition of one subresource, merged with the
+        //previous entry when the ranges are adjacent.
+        void _AddTexSync(
+            VulkanTexture* tex, std::uint32_t mipLevel, std::uint32_t arrayLayer,
+            const TexRef& prevUsage, const TexRef& currUsage);
+        void _MergeTexSyncMips(std::size_t rowBegin);
+
     public:
+        _DevResRegistry();
+
+        //Drop all tracked state, capacity is kept
+        void Reset();
 
         void RegisterBufferUsage(
             const sp<Buffer>& buffer,
@@ -76,40 +159,156 @@ namespace Veldrid
             const sp<Texture>& tex,
             VkImageLayout requiredLayout,
             VkPipelineStageFlags stage,
-            VkAccessFlags access
+            VkAccessFlags access,
+            const _TexSubresRange& range = {}
         );
 
-        void ModifyTexUsage(
-            const sp<Texture>& tex,
-            VkImageLayout layout,
+        //Resource lifetime is managed by the caller, e.g. a resource
+        //set already held by the command list.
+        void RegisterBufferUsage(
+            VulkanBuffer* buffer,
             VkPipelineStageFlags stage,
             VkAccessFlags access
         );
 
+        void RegisterTexUsage(
+            VulkanTexture* tex,
+            VkImageLayout requiredLayout,
+            VkPipelineStageFlags stage,
+            VkAccessFlags access,
+            const _TexSubresRange& range = {}
+        );
+
         bool InsertPipelineBarrierIfNecessary(
             VkCommandBuffer cb
         );
 
+        bool HasPendingBarriers() const {
+            return !_bufSyncs.empty() || !_texSyncs.empty();
+        }
+
+        //Register everything tracked by other as if it was used here,
+        //entry state first, then the state it was left in.
+        //Resource lifetime is managed by the caller.
+        void MergeUsages(const _DevResRegistry& other);
+
+        //Append barriers bringing resources from the state left by
+        //previous submissions to the state expected by this recording,
+        //then store this recording's final state as submitted state.
+        //Must be called in submission order.
+        void ResolveSubmittedState(_SubmitFixup& fixup);
+
+    };
+
+    //Last recorded value of an indexed dynamic state (viewports, vertex
+    //bindings...), changed slots are flushed in contiguous runs.
+    template<typename T>
+    struct _ShadowArray {
+        std::vector<T> values;
+        std::vector<bool> valid;
+        std::vector<bool> dirty;
+        bool anyDirty = false;
+
+        //Returns false if the value is the same as the last one set
+        bool Set(std::uint32_t index, const T& value) {
+            if (index >= values.size()) {
+                values.resize(index + 1, T{});
+                valid.resize(index + 1, false);
+                dirty.resize(index + 1, false);
+            }
+            if (valid[index] && memcmp(&values[index], &value, sizeof(T)) == 0) {
+                return false;
+            }
+            values[index] = value;
+            valid[index] = true;
+            dirty[index] = true;
+            anyDirty = true;
+            return true;
+        }
+
+        //emit(firstIndex, count, const T* values)
+        template<typename Fn>
+        void Flush(Fn&& emit) {
+            if (!anyDirty) return;
+            std::uint32_t i = 0, n = values.size();
+            while (i < n) {
+                if (!dirty[i]) { i++; continue; }
+                std::uint32_t first = i;
+                while (i < n && dirty[i]) { dirty[i] = false; i++; }
+                emit(first, i - first, &values[first]);
+            }
+            anyDirty = false;
+        }
+
+        void Reset() {
+            values.clear(); valid.clear(); dirty.clear();
+            anyDirty = false;
+        }
     };
 
     //class VulkanPipeline;
 
     class VulkanCommandList : public CommandList{
+    public:
+        //Number of state changes dropped because they were redundant
+        struct StateCacheStats {
+            std::uint32_t elidedPipelines;
+            std::uint32_t elidedVertexBuffers;
+            std::uint32_t elidedIndexBuffers;
+            std::uint32_t elidedViewports;
+            std::uint32_t elidedScissors;
+            std::uint32_t elidedResourceSets;
+            //vkCmdBindVertexBuffers calls saved by merging adjacent slots
+            std::uint32_t coalescedVertexBuffers;
+        };
+
+    private:
 
         VkCommandBuffer _cmdBuf;
         sp<_CmdPoolContainer> _cmdPool;
 
         struct _ResSetHolder{
             bool isNewlyChanged;
+            //Set again while already bound: no rebind, but usage is
+            //registered again for barriers.
+            bool needsUsageRegister;
             sp<VulkanResourceSet> resSet;
             std::vector<std::uint32_t> offsets;
 
 
             bool IsValid() const {return resSet != nullptr;}
         };
-        std::vector<_ResSetHolder> _resourceSets;
+        //Graphics and compute sets are bound separately by Vulkan
+        struct _BindPointSets{
+            std::vector<_ResSetHolder> sets;
+            //Layout of the last pipeline bound at this point
+            VkPipelineLayout layout = VK_NULL_HANDLE;
+        };
+        _BindPointSets _graphicsSets, _computeSets;
         VulkanPipelineBase* _currentPipeline;
 
+        _BindPointSets& _SetsOf(bool isCompute) {
+            return isCompute ? _computeSets : _graphicsSets;
+        }
+        _BindPointSets& _SetsOf(VkPipelineBindPoint bindPoint) {
+            return _SetsOf(bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE);
+        }
+
+        struct _VertexBinding {
+            VkBuffer buffer;
+            VkDeviceSize offset;
+        };
+        struct _IndexBinding {
+            VkBuffer buffer;
+            VkDeviceSize offset;
+            VkIndexType type;
+        };
+        _ShadowArray<_VertexBinding> _vertexBindings;
+        _IndexBinding _indexBinding;
+        _ShadowArray<VkViewport> _viewports;
+        _ShadowArray<VkRect2D> _scissors;
+        StateCacheStats _stateCacheStats;
+
         struct _RenderPassInfo{
             //Pipeline resources
             sp<VulkanFramebufferBase> fb;
@@ -117,6 +316,34 @@ namespace Veldrid
             std::vector<std::optional<VkClearColorValue>> clearColorTargets;
             std::optional<VkClearDepthStencilValue> clearDSTarget;
 
+            //vkCmdBeginRenderPass is recorded and not yet ended
+            bool isActive = false;
+            //Has been ended by a transfer/dispatch/barrier, later
+            //draws resume it with loadOp = LOAD
+            bool isSuspended = false;
+            //How the running pass was begun, inline commands and
+            //secondary command buffers can't be mixed
+            VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+
+            bool HasPendingClears() const {
+                if (clearDSTarget.has_value()) return true;
+                for (auto& c : clearColorTargets) {
+                    if (c.has_value()) return true;
+                }
+                return false;
+            }
+
+            //Every attachment has a clear, they all fit in loadOp
+            bool CanFoldClears() const {
+                auto& desc = fb->GetDesc();
+                if (!desc.HasColorTarget() && !desc.HasDepthTarget()) return false;
+                if (desc.HasDepthTarget() && !clearDSTarget.has_value()) return false;
+                for (auto& c : clearColorTargets) {
+                    if (!c.has_value()) return false;
+                }
+                return true;
+            }
+
             //bool IsComputePass() const {
             //    return pipeline->IsComputePipeline();
             //}
@@ -132,22 +359,71 @@ namespace Veldrid
         _DevResRegistry _resReg;
         std::unordered_set<sp<DeviceResource>> _miscResReg;
 
+        //Upload memory used by UpdateBuffer, the last one is being filled.
+        std::vector<_StagingBlock> _stagingBlocks;
+        //Pools of CreateTransientResourceSet, the last one is being filled.
+        std::vector<_TransientDescriptorPool> _transientPools;
+        //Submitted since the last recording, the GPU may still replay
+        //a reusable list and read its uploads and transient sets.
+        bool _isSubmitted = false;
+
+        //Secondary lists record inside the render pass of the primary
+        //they were forked from. The command buffer is allocated from the
+        //pool of the thread calling Begin.
+        bool _isSecondary = false;
+        sp<VulkanFramebufferBase> _inheritedFb;
+        //Scratch for JoinSecondaries
+        std::vector<VkCommandBuffer> _secondaryCmdBufs;
+
         //sp<VulkanPipelineBase> _currentPipeline;
         //std::vector<sp<VulkanResourceSet>> _currentResourceSets;
 
         //renderpasses
         //std::set<sp<VulkanFramebuffer>> _currRenderPassFBs;
 
-        VulkanCommandList(const sp<GraphicsDevice>& dev) : CommandList(dev){}
+        VulkanCommandList(
+            const sp<GraphicsDevice>& dev,
+            const Description& desc = {}
+        ) : CommandList(dev, desc){}
 
     public:
         ~VulkanCommandList();
 
-        static sp<CommandList> Make(const sp<VulkanDevice>& dev);
+        static sp<CommandList> Make(
+            const sp<VulkanDevice>& dev,
+            const CommandList::Description& desc);
         const VkCommandBuffer& GetHandle() const { return _cmdBuf; }
+
+        const StateCacheStats& GetStateCacheStats() const { return _stateCacheStats; }
+
+        //Move staging blocks out for submission tracking,
+        //reusable lists keep them for later submissions.
+        void TakeStagingBlocks(std::vector<_StagingBlock>& out);
+        //Same for the pools of transient resource sets
+        void TakeTransientDescriptorPools(std::vector<_TransientDescriptorPool>& out);
+        void MarkSubmitted() { _isSubmitted = true; }
+
+        //Barriers to run before this list, see _DevResRegistry::ResolveSubmittedState
+        void ResolveSubmittedState(_SubmitFixup& fixup) { _resReg.ResolveSubmittedState(fixup); }
+
+        bool IsSecondary() const { return _isSecondary; }
+
+    private:
+        //Suballocate upload memory, returns mapped pointer
+        std::uint8_t* _AllocateStaging(
+            VkDeviceSize size, VkBuffer& outBuffer, VkDeviceSize& outOffset);
+
+        //Drop everything recorded, keeps capacity
+        void _ResetTracking();
+        //Give back uploads and transient pools left with the list
+        void _ReleaseUploads();
+        void _BeginSecondary();
+
+    public:
         
         virtual void Begin() override;
         virtual void End() override;
+        virtual void Reset() override;
 
         virtual void SetPipeline(const sp<Pipeline>&) override;
 
@@ -157,6 +433,9 @@ namespace Veldrid
         virtual void SetIndexBuffer(
             const sp<Buffer>& buffer, IndexFormat format, std::uint32_t offset = 0) override;
 
+        virtual void SetPushConstants(
+            std::uint32_t offset, std::uint32_t size, const void* data) override;
+
         
         virtual void SetGraphicsResourceSet(
             std::uint32_t slot, 
@@ -167,10 +446,14 @@ namespace Veldrid
             std::uint32_t slot, 
             const sp<ResourceSet>& rs, 
             const std::vector<std::uint32_t>& dynamicOffsets) override;
+        virtual sp<ResourceSet> CreateTransientResourceSet(const ResourceSet::Description& desc) override;
 
         virtual void BeginRenderPass(const sp<Framebuffer>& fb) override;
         virtual void EndRenderPass() override;
 
+        virtual std::vector<sp<CommandList>> ForkSecondaries(std::uint32_t count) override;
+        virtual void JoinSecondaries(const std::vector<sp<CommandList>>& secondaries) override;
+
         virtual void ClearColorTarget(
             std::uint32_t slot, 
             float r, float g, float b, float a) override;
@@ -189,6 +472,28 @@ namespace Veldrid
         virtual void SetFullScissorRect(std::uint32_t index) override;
         virtual void SetFullScissorRects() override;
 
+        void _RegisterAttachmentUsage(VulkanFramebufferBase* vkfb);
+        //Lazily begin the render pass, pending clears become loadOp = CLEAR.
+        //A pass running with other contents is restarted.
+        void _EnsureRenderPassActive(
+            VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+        //End the render pass only if it's actually recording
+        void _EndActiveRenderPass();
+        void _FlushPendingClears();
+        //Emit pending barriers, suspending the render pass if needed
+        void _FlushBarriers();
+
+        void _ResetStateCache();
+        //Forget bound pipeline, sets and dynamic states, stats are kept
+        void _InvalidateBoundState();
+        void _SetResourceSet(
+            _BindPointSets& bound,
+            std::uint32_t slot,
+            const sp<ResourceSet>& rs,
+            const std::vector<std::uint32_t>& dynamicOffsets);
+        //Record dirty vertex bindings, viewports and scissors
+        void _FlushDynamicStates();
+
         void _RegisterResourceSetUsage(VkPipelineBindPoint bindPoint);
         void _FlushNewResourceSets(VkPipelineBindPoint bindPoint);
         void PreDrawCommand();
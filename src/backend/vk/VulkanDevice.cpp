@@ -420,6 +420,14 @@ namespace Veldrid {
         if(_isOwnSurface){
             vkDestroySurfaceKHR(_ctx->GetHandle(), _surface, nullptr);
         }
+        _fixupCmdMgr.DeInit();
+        _pipelineDedup.DeInit();
+        _setCache.DeInit();
+        _layoutCache.DeInit();
+        _pipelineCacheMgr.DeInit();
+        _renderPassCache.DeInit();
+        //Staging blocks are allocated from VMA
+        _stagingMgr.DeInit();
         vmaDestroyAllocator(_allocator);
 
         //Uninit managers
@@ -571,6 +579,10 @@ namespace Veldrid {
         if (dev->_ctx->GetFeatures().hasDrvProp2Ext) {
             dev->_features.supportsDrvPropQuery = _AddExtIfPresent(VkDevExtNames::VK_KHR_DRIVER_PROPS);
         }
+        dev->_features.supportsCreationFeedback = _AddExtIfPresent(VkDevExtNames::VK_EXT_PIPELINE_CREATION_FEEDBACK);
+        if (!options.disableDescriptorUpdateTemplates) {
+            dev->_features.supportsUpdateTemplate = _AddExtIfPresent(VkDevExtNames::VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE);
+        }
 
         createInfo.enabledExtensionCount = static_cast<uint32_t>(devExtensions.size());
         createInfo.ppEnabledExtensionNames = devExtensions.data();
@@ -585,6 +597,12 @@ namespace Veldrid {
         //poolInfo.flags = 0; // Optional
         //VK_CHECK(vkCreateCommandPool(dev->_dev, &poolInfo, nullptr, &dev->_cmdPool));
         dev->_cmdPoolMgr.Init(dev->_dev, devInfo.graphicsQueueFamily);
+        dev->_fixupCmdMgr.Init(dev->_dev, devInfo.graphicsQueueFamily);
+        dev->_pipelineCacheMgr.Init(
+            dev->_dev, dev->_phyDev.handle,
+            dev->_features.supportsCreationFeedback, options.pipelineCachePath,
+            options.pipelineCacheData, options.pipelineCacheDataSize);
+        dev->_renderPassCache.Init(dev->_dev);
         dev->_descPoolMgr.Init(dev->_dev, 1000);
 
         //Get queues
@@ -630,6 +648,8 @@ namespace Veldrid {
         allocatorInfo.pVulkanFunctions = &fn;
 
         vmaCreateAllocator(&allocatorInfo, &dev->_allocator);
+        //4MB upload blocks for CommandList::UpdateBuffer
+        dev->_stagingMgr.Init(dev->_dev, dev->_allocator, 4 * 1024 * 1024);
 
         //dev->_isValid = true;
 
@@ -700,11 +720,32 @@ namespace Veldrid {
             auto* vkS = PtrCast<VulkanSemaphore>(s); vkSignalSems.push_back(vkS->GetHandle());
         }
 
+        std::scoped_lock l{ _m_submit };
+
         std::vector<VkCommandBuffer> vkCmdBufs; vkCmdBufs.reserve(cmd.size());
+        std::vector<VkCommandBuffer> fixupCmdBufs;
+        std::vector<_StagingBlock> stagingBlocks;
+        std::vector<_TransientDescriptorPool> transientPools;
         for (auto* c : cmd) {
             assert(c != nullptr);
             auto* vkCmd = PtrCast<VulkanCommandList>(c);
+            //Secondaries only run through JoinSecondaries of a primary
+            assert(!vkCmd->IsSecondary());
+
+            //Bring resources into the state this list expects,
+            //right after the lists submitted before it.
+            _submitFixup.Clear();
+            vkCmd->ResolveSubmittedState(_submitFixup);
+            if (!_submitFixup.Empty()) {
+                auto fixupCb = _fixupCmdMgr.Record(_submitFixup);
+                vkCmdBufs.push_back(fixupCb);
+                fixupCmdBufs.push_back(fixupCb);
+            }
+
             vkCmdBufs.push_back(vkCmd->GetHandle());
+            vkCmd->MarkSubmitted();
+            vkCmd->TakeStagingBlocks(stagingBlocks);
+            vkCmd->TakeTransientDescriptorPools(transientPools);
         }
         VkSubmitInfo info{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
         info.signalSemaphoreCount = vkSignalSems.size();
@@ -722,9 +763,76 @@ namespace Veldrid {
             vkFence = _vkFence->GetHandle();
         }
 
+        //Staging blocks, fixup buffers and transient descriptor pools need
+        //fences we own, user fences may be reset and reused before we get
+        //to poll them.
+        VkFence stagingFence = VK_NULL_HANDLE;
+        if (!stagingBlocks.empty()) {
+            stagingFence = _stagingMgr.AcquireFence();
+        }
+        VkFence fixupFence = VK_NULL_HANDLE;
+        if (!fixupCmdBufs.empty()) {
+            fixupFence = _fixupCmdMgr.AcquireFence();
+        }
+        VkFence descFence = VK_NULL_HANDLE;
+        if (!transientPools.empty()) {
+            descFence = _descPoolMgr.AcquireFence();
+        }
+
+        //One of our fences can ride on the submission if the caller gave none
+        VkFence* ownFenceOnSubmit = nullptr;
+        if (vkFence == VK_NULL_HANDLE) {
+            if (stagingFence != VK_NULL_HANDLE) ownFenceOnSubmit = &stagingFence;
+            else if (fixupFence != VK_NULL_HANDLE) ownFenceOnSubmit = &fixupFence;
+            else if (descFence != VK_NULL_HANDLE) ownFenceOnSubmit = &descFence;
+            if (ownFenceOnSubmit) vkFence = *ownFenceOnSubmit;
+        }
+
         VK_CHECK(vkQueueSubmit(
             _queueGraphics, 1, &info, vkFence
         ));
+
+        //An empty submission signals the fence once all
+        //previously submitted work is done.
+        if (stagingFence != VK_NULL_HANDLE) {
+            if (ownFenceOnSubmit != &stagingFence) {
+                VK_CHECK(vkQueueSubmit(_queueGraphics, 0, nullptr, stagingFence));
+            }
+            _stagingMgr.RetireBlocks(stagingBlocks, stagingFence);
+        }
+        if (fixupFence != VK_NULL_HANDLE) {
+            if (ownFenceOnSubmit != &fixupFence) {
+                VK_CHECK(vkQueueSubmit(_queueGraphics, 0, nullptr, fixupFence));
+            }
+            _fixupCmdMgr.RetireCmdBufs(fixupCmdBufs, fixupFence);
+        }
+        if (descFence != VK_NULL_HANDLE) {
+            if (ownFenceOnSubmit != &descFence) {
+                VK_CHECK(vkQueueSubmit(_queueGraphics, 0, nullptr, descFence));
+            }
+            _descPoolMgr.RetireTransientPools(transientPools, descFence);
+        }
+    }
+
+    void VulkanDevice::RetireSubmittedUploads(
+        std::vector<_StagingBlock>& blocks,
+        std::vector<_TransientDescriptorPool>& pools
+    ) {
+        if (blocks.empty() && pools.empty()) return;
+
+        //Replays of the list are the latest submissions referencing them,
+        //an empty submission signals once they are done.
+        std::scoped_lock l{ _m_submit };
+        if (!blocks.empty()) {
+            auto fence = _stagingMgr.AcquireFence();
+            VK_CHECK(vkQueueSubmit(_queueGraphics, 0, nullptr, fence));
+            _stagingMgr.RetireBlocks(blocks, fence);
+        }
+        if (!pools.empty()) {
+            auto fence = _descPoolMgr.AcquireFence();
+            VK_CHECK(vkQueueSubmit(_queueGraphics, 0, nullptr, fence));
+            _descPoolMgr.RetireTransientPools(pools, fence);
+        }
     }
 
     SwapChain::State VulkanDevice::PresentToSwapChain(
@@ -779,8 +887,10 @@ namespace Veldrid {
     //}
 
     //sp<_CmdPoolContainer> VulkanDevice::GetCmdPool() { return _cmdPoolMgr.GetOnePool(); }
-    _DescriptorSet VulkanDevice::AllocateDescriptorSet(VkDescriptorSetLayout layout){
-        return _descPoolMgr.Allocate(layout);
+    _DescriptorSet VulkanDevice::AllocateDescriptorSet(
+        VkDescriptorSetLayout layout, const DescriptorResourceCounts& counts
+    ){
+        return _descPoolMgr.Allocate(layout, counts);
     }
 
     sp<Buffer> VulkanBuffer::Make(
@@ -932,14 +1042,15 @@ namespace Veldrid {
         return sp(sem);
     }
 
-    VkCommandBuffer _CmdPoolContainer::AllocateBuffer(){
+    VkCommandBuffer _CmdPoolContainer::AllocateBuffer(VkCommandBufferLevel level){
         assert(std::this_thread::get_id() == boundID);
+        FreeDeferredBuffers();
 
         VkCommandBufferAllocateInfo cbufInfo{};
         cbufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         cbufInfo.commandPool = pool;
         cbufInfo.commandBufferCount = 1;
-        cbufInfo.level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cbufInfo.level = level;
         VkCommandBuffer cbuf;
         VK_CHECK(vkAllocateCommandBuffers(mgr->_dev, &cbufInfo, &cbuf));
         return cbuf;
@@ -947,10 +1058,24 @@ namespace Veldrid {
     }
 
     void _CmdPoolContainer::FreeBuffer(VkCommandBuffer buf) {
+        if (std::this_thread::get_id() != boundID) {
+            std::scoped_lock _lock{ m_deferred };
+            deferredFrees.push_back(buf);
+            return;
+        }
         vkFreeCommandBuffers(mgr->_dev, pool, 1, &buf);
     }
+
+    void _CmdPoolContainer::FreeDeferredBuffers() {
+        std::scoped_lock _lock{ m_deferred };
+        if (deferredFrees.empty()) return;
+        vkFreeCommandBuffers(mgr->_dev, pool, deferredFrees.size(), deferredFrees.data());
+        deferredFrees.clear();
+    }
     
     void _CmdPoolMgr::_ReleaseCmdPoolHolder(_CmdPoolContainer* holder) {
+        //Last reference is gone, nobody else can touch the pool
+        holder->FreeDeferredBuffers();
         std::scoped_lock _lock{ _m_cmdPool };
         vkResetCommandPool(_dev, holder->pool, 0);
         _threadBoundCmdPools.erase(holder->boundID);
@@ -974,7 +1099,9 @@ namespace Veldrid {
                 //Create a new command pool
                 VkCommandPoolCreateInfo cmdPoolCI{};
                 cmdPoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-                cmdPoolCI.flags = VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                //Command lists are re-recorded individually
+                cmdPoolCI.flags = VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+                    | VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
                 cmdPoolCI.queueFamilyIndex = _queueFamily;
 
                 VK_CHECK(vkCreateCommandPool(_dev, &cmdPoolCI, nullptr, &raw_pool));
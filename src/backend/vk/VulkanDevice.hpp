@@ -14,8 +14,17 @@
 #include <map>
 #include <thread>
 #include <mutex>
+#include <vector>
 
+#include "VkCommon.hpp"
 #include "VkDescriptorPoolMgr.hpp"
+#include "VkStagingBufferMgr.hpp"
+#include "VkFixupCmdMgr.hpp"
+#include "VkPipelineCacheMgr.hpp"
+#include "VkPipelineDedupCache.hpp"
+#include "VkRenderPassCache.hpp"
+#include "VkResourceLayoutCache.hpp"
+#include "VkResourceSetCache.hpp"
 #include "VulkanResourceFactory.hpp"
 
 class _VkCtx;
@@ -80,12 +89,20 @@ namespace Veldrid
         _CmdPoolMgr* mgr;
         std::thread::id boundID;
 
+        //Buffers freed by other threads, the pool is only touched by
+        //its own thread which releases them on its next allocation.
+        std::mutex m_deferred;
+        std::vector<VkCommandBuffer> deferredFrees;
+
         ~_CmdPoolContainer() {
             mgr->_ReleaseCmdPoolHolder(this);
         }
 
-        VkCommandBuffer AllocateBuffer();
+        VkCommandBuffer AllocateBuffer(
+            VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        //Can be called from any thread
         void FreeBuffer(VkCommandBuffer buf);
+        void FreeDeferredBuffers();
     };
 
     class VulkanDevice : public GraphicsDevice {
@@ -104,6 +121,8 @@ namespace Veldrid
 
                 std::uint32_t supportsMaintenance1 : 1;
                 std::uint32_t supportsDrvPropQuery : 1;
+                std::uint32_t supportsCreationFeedback : 1;
+                std::uint32_t supportsUpdateTemplate : 1;
 
             };
             std::uint32_t value;
@@ -118,6 +137,18 @@ namespace Veldrid
         VmaAllocator _allocator;
         _CmdPoolMgr _cmdPoolMgr;
         _DescriptorPoolMgr _descPoolMgr;
+        _StagingBufferMgr _stagingMgr;
+        _FixupCmdMgr _fixupCmdMgr;
+        _PipelineCacheMgr _pipelineCacheMgr;
+        _PipelineDedupCache _pipelineDedup;
+        _RenderPassCache _renderPassCache;
+        _ResourceLayoutCache _layoutCache;
+        _ResourceSetCache _setCache;
+
+        //Serializes submissions, resources' submitted state and
+        //fixup recording depend on submission order.
+        std::mutex _m_submit;
+        _SubmitFixup _submitFixup;
 
         VkQueue _queueGraphics, _queueCopy, _queueCompute;
 
@@ -164,13 +195,41 @@ namespace Veldrid
 
         //TODO: temporary querier
         bool SupportsFlippedYDirection() const {return _features.supportsMaintenance1;}
+        bool SupportsUpdateTemplate() const {return _features.supportsUpdateTemplate;}
 
     private:
 
 
     public:
         sp<_CmdPoolContainer> GetCmdPool() { return _cmdPoolMgr.GetOnePool(); }
-        _DescriptorSet AllocateDescriptorSet(VkDescriptorSetLayout layout);
+        _DescriptorSet AllocateDescriptorSet(
+            VkDescriptorSetLayout layout, const DescriptorResourceCounts& counts);
+        VkDescriptorSet AllocateTransientDescriptorSet(
+            std::vector<_TransientDescriptorPool>& pools,
+            VkDescriptorSetLayout layout, const DescriptorResourceCounts& counts
+        ) { return _descPoolMgr.AllocateTransient(pools, layout, counts); }
+        void FreeTransientDescriptorPools(std::vector<_TransientDescriptorPool>& pools) { _descPoolMgr.ReleaseTransientPools(pools); }
+        _DescriptorPoolMgr::Stats GetDescriptorPoolStats() { return _descPoolMgr.GetStats(); }
+        _StagingBlock AllocateStagingBlock(VkDeviceSize minSize) { return _stagingMgr.AcquireBlock(minSize); }
+        void FreeStagingBlocks(std::vector<_StagingBlock>& blocks) { _stagingMgr.ReleaseBlocks(blocks); }
+        //Uploads and transient pools of a reusable list, recycled once
+        //every submission made so far has completed.
+        void RetireSubmittedUploads(
+            std::vector<_StagingBlock>& blocks,
+            std::vector<_TransientDescriptorPool>& pools);
+        _PipelineCacheMgr& PipelineCache() { return _pipelineCacheMgr; }
+        _PipelineDedupCache& PipelineDedup() { return _pipelineDedup; }
+        _PipelineDedupCache::Stats GetPipelineDedupStats() const { return _pipelineDedup.GetStats(); }
+        VkRenderPass GetRenderPass(const _RenderPassKey& key) { return _renderPassCache.Get(key); }
+        _RenderPassCache::Stats GetRenderPassCacheStats() { return _renderPassCache.GetStats(); }
+        _ResourceLayoutCache& ResourceLayoutCache() { return _layoutCache; }
+        _ResourceSetCache& ResourceSetCache() { return _setCache; }
+        _ResourceSetCache::Stats GetResourceSetCacheStats() const { return _setCache.GetStats(); }
+
+        //Persist the pipeline cache now instead of on destruction,
+        //returns false if no path was given or writing failed.
+        bool SavePipelineCache() { return _pipelineCacheMgr.Save(); }
+        _PipelineCacheMgr::Stats GetPipelineCacheStats() const { return _pipelineCacheMgr.GetStats(); }
     //Interface
     public:
 
@@ -193,6 +252,12 @@ namespace Veldrid
         VkBuffer _buffer;
         VmaAllocation _allocation;
 
+        _ResTrackingTag _trackingTag;
+
+        //Last access by submitted command lists
+        VkPipelineStageFlags _submittedStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkAccessFlags _submittedAccess = 0;
+
         //VkBufferUsageFlags _usages;
         //VmaMemoryUsage _allocationType;
 
@@ -221,6 +286,13 @@ namespace Veldrid
         );
 
         const VkBuffer& GetHandle() const {return _buffer;}
+        _ResTrackingTag& GetTrackingTag() { return _trackingTag; }
+
+        VkPipelineStageFlags GetSubmittedStage() const { return _submittedStage; }
+        VkAccessFlags GetSubmittedAccess() const { return _submittedAccess; }
+        void SetSubmittedState(VkPipelineStageFlags stage, VkAccessFlags access) {
+            _submittedStage = stage; _submittedAccess = access;
+        }
 
         virtual void* MapToCPU();
 
@@ -18,19 +18,16 @@ namespace Veldrid
     void VulkanFramebufferBase::CreateCompatibleRenderPasses(
         VulkanDevice* vkDev,
         const Description& desc,
-        bool isPresented,
         VkRenderPass& noClearInit,
         VkRenderPass& noClearLoad,
         VkRenderPass& clear
     ){
-
-        VkRenderPassCreateInfo renderPassCI{};
-        renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-
-        std::vector<VkAttachmentDescription> attachments{};
+        //Passes come from the device cache, framebuffers with the same
+        //formats and usages share them.
+        _RenderPassKey key{};
+        auto& attachments = key.attachments;
 
         unsigned colorAttachmentCount = desc.colorTargets.size();
-        std::vector<VkAttachmentReference> colorAttachmentRefs{};
         for (int i = 0; i < colorAttachmentCount; i++)
         {
             auto vkColorTex = PtrCast<VulkanTexture>(desc.colorTargets[i].target.get());
@@ -45,24 +42,19 @@ namespace Veldrid
             colorAttachmentDesc.initialLayout = (texDesc.usage.sampled)
                     ? VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
                     : VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            colorAttachmentDesc.finalLayout = isPresented
-                ? VkImageLayout::VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-                : VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            //Presented targets stay in attachment layout too, a suspended
+            //pass resumes from it. EndRenderPass moves them to present.
+            colorAttachmentDesc.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
             attachments.push_back(colorAttachmentDesc);
-
-            VkAttachmentReference colorAttachmentRef {};
-            colorAttachmentRef.attachment = i;
-            colorAttachmentRef.layout = VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            colorAttachmentRefs.push_back(colorAttachmentRef);
         }
 
-        VkAttachmentReference depthAttachmentRef{};
+        bool hasStencil = false;
         if (desc.HasDepthTarget())
         {
             VkAttachmentDescription depthAttachmentDesc{};
             auto vkDepthTex = PtrCast<VulkanTexture>(desc.depthTarget.target.get());
             auto& texDesc = vkDepthTex->GetDesc();
-            bool hasStencil = Helpers::FormatHelpers::IsStencilFormat(texDesc.format);
+            hasStencil = Helpers::FormatHelpers::IsStencilFormat(texDesc.format);
             depthAttachmentDesc.format = VdToVkPixelFormat(texDesc.format);
             depthAttachmentDesc.samples = VdToVkSampleCount(texDesc.sampleCount);
             depthAttachmentDesc.loadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_LOAD;
@@ -75,42 +67,11 @@ namespace Veldrid
                 ? VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
                 : VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
             depthAttachmentDesc.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-            depthAttachmentRef.attachment = colorAttachmentCount;
-            depthAttachmentRef.layout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
             attachments.push_back(depthAttachmentDesc);
-
-        }
-
-        VkSubpassDescription subpass{};
-        subpass.pipelineBindPoint = VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS;
-        if (desc.HasColorTarget())
-        {
-            subpass.colorAttachmentCount = colorAttachmentCount;
-            subpass.pColorAttachments = colorAttachmentRefs.data();
+            key.hasDepth = true;
         }
 
-        if (desc.HasDepthTarget())
-        {
-            subpass.pDepthStencilAttachment = &depthAttachmentRef;
-        }
-
-        VkSubpassDependency subpassDependency {};
-        subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        subpassDependency.srcStageMask = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpassDependency.dstStageMask = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpassDependency.dstAccessMask 
-            = VkAccessFlagBits::VK_ACCESS_COLOR_ATTACHMENT_READ_BIT 
-            | VkAccessFlagBits::VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-        renderPassCI.attachmentCount = attachments.size();
-        renderPassCI.pAttachments = attachments.data();
-        renderPassCI.subpassCount = 1;
-        renderPassCI.pSubpasses = &subpass;
-        renderPassCI.dependencyCount = 1;
-        renderPassCI.pDependencies = &subpassDependency;
-
-        VK_CHECK(vkCreateRenderPass(vkDev->LogicalDev(), &renderPassCI, nullptr, &noClearInit));
+        noClearInit = vkDev->GetRenderPass(key);
 
         for (int i = 0; i < colorAttachmentCount; i++)
         {
@@ -122,7 +83,6 @@ namespace Veldrid
             //The last attachment is depth attachment
             attachments[colorAttachmentCount].loadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_LOAD;
             attachments[colorAttachmentCount].initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-            bool hasStencil = Helpers::FormatHelpers::IsStencilFormat(desc.depthTarget.target->GetDesc().format);
             if (hasStencil)
             {
                 attachments[colorAttachmentCount].stencilLoadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_LOAD;
@@ -130,7 +90,7 @@ namespace Veldrid
 
         }
 
-        VK_CHECK(vkCreateRenderPass(vkDev->LogicalDev(), &renderPassCI, nullptr, &noClearLoad));
+        noClearLoad = vkDev->GetRenderPass(key);
 
 
         // Load version
@@ -145,14 +105,13 @@ namespace Veldrid
         {
             attachments[colorAttachmentCount].loadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
             attachments[colorAttachmentCount].initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED;
-            bool hasStencil = Helpers::FormatHelpers::IsStencilFormat(desc.depthTarget.target->GetDesc().format);
             if (hasStencil)
             {
                 attachments[colorAttachmentCount].stencilLoadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
             }
         }
        
-        VK_CHECK(vkCreateRenderPass(vkDev->LogicalDev(), &renderPassCI, nullptr, &clear));
+        clear = vkDev->GetRenderPass(key);
 
     }
 
@@ -166,10 +125,6 @@ namespace Veldrid
         auto vkDev = PtrCast<VulkanDevice>(dev.get());
         vkDestroyFramebuffer(vkDev->LogicalDev(), _fb, nullptr);
 
-        vkDestroyRenderPass(vkDev->LogicalDev(), renderPassNoClear, nullptr);
-        vkDestroyRenderPass(vkDev->LogicalDev(), renderPassNoClearLoad, nullptr);
-        vkDestroyRenderPass(vkDev->LogicalDev(), renderPassClear, nullptr);
-
         for (VkImageView view : _attachmentViews)
         {
             vkDestroyImageView(vkDev->LogicalDev(), view, nullptr);
@@ -278,40 +233,13 @@ namespace Veldrid
     }
 
 
-    void VulkanFramebuffer::TransitionToAttachmentLayout(VkCommandBuffer cb) {
-        //TODO: Need to support compute shader pipeline stage?
-        for (auto& colorDesc : description.colorTargets)
-        {
-            VulkanTexture* vkColorTarget = PtrCast<VulkanTexture>(colorDesc.target.get());
-            vkColorTarget->TransitionImageLayout(cb,
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                VK_ACCESS_SHADER_WRITE_BIT,
-                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
-                );
-        }
-
-        // Depth
-        if (description.HasDepthTarget())
-        {
-            VulkanTexture* vkDepthTarget = PtrCast<VulkanTexture>(description.depthTarget.target.get());
-            bool hasStencil = Helpers::FormatHelpers::IsStencilFormat(vkDepthTarget->GetDesc().format);
-
-            vkDepthTarget->TransitionImageLayout(cb,
-                hasStencil
-                    ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-                    : VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-                VK_ACCESS_SHADER_WRITE_BIT,
-                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
-                );
-        }
-    }
-
     void VulkanFramebuffer::VisitAttachments(AttachmentVisitor visitor) {
         //TODO: Need to support compute shader pipeline stage?
         for (auto& colorDesc : description.colorTargets)
         {
             sp<VulkanTexture> vkColorTarget = SPCast<VulkanTexture>(colorDesc.target);
-            visitor(vkColorTarget, VisitedAttachmentType::ColorAttachment);
+            visitor(vkColorTarget, VisitedAttachmentType::ColorAttachment,
+                { colorDesc.mipLevel, 1, colorDesc.arrayLayer, 1 });
         }
 
         // Depth
@@ -323,7 +251,8 @@ namespace Veldrid
                 ? VisitedAttachmentType::DepthStencilAttachment
                 : VisitedAttachmentType::DepthAttachment;
 
-            visitor(vkDepthTarget, type);
+            visitor(vkDepthTarget, type,
+                { description.depthTarget.mipLevel, 1, description.depthTarget.arrayLayer, 1 });
         }
     }
 
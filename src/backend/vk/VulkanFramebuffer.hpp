@@ -7,6 +7,8 @@
 #include <vector>
 #include <functional>
 
+#include "VkCommon.hpp"
+
 namespace Veldrid
 {
     class VulkanDevice;
@@ -17,7 +19,8 @@ namespace Veldrid
         enum class VisitedAttachmentType {
             ColorAttachment, DepthAttachment, DepthStencilAttachment
         };
-        using AttachmentVisitor = std::function<void(const sp<VulkanTexture>&, VisitedAttachmentType)>;
+        using AttachmentVisitor = std::function<void(
+            const sp<VulkanTexture>&, VisitedAttachmentType, const _TexSubresRange&)>;
 
     protected:
         
@@ -36,7 +39,6 @@ namespace Veldrid
         static void CreateCompatibleRenderPasses(
             VulkanDevice* vkDev,
             const Description& desc,
-            bool isPresented,
             VkRenderPass& noClearInit,
             VkRenderPass& noClearLoad,
             VkRenderPass& clear
@@ -51,7 +53,8 @@ namespace Veldrid
         virtual VkRenderPass GetRenderPassNoClear_Load() const = 0;
         virtual VkRenderPass GetRenderPassClear() const = 0;
 
-        virtual void TransitionToAttachmentLayout(VkCommandBuffer cb) = 0;
+        //Color targets are handed to the presentation engine
+        virtual bool IsPresented() const = 0;
 
         virtual void VisitAttachments(AttachmentVisitor visitor) = 0;
 
@@ -63,6 +66,7 @@ namespace Veldrid
         VkRenderPass renderPassNoClear;
         VkRenderPass renderPassNoClearLoad;
         VkRenderPass renderPassClear;
+        bool _isPresented;
 
         std::vector<VkImageView> _attachmentViews;
 
@@ -75,10 +79,11 @@ namespace Veldrid
         ) 
             : VulkanFramebufferBase(dev)
             , description(desc)
+            , _isPresented(isPresented)
         { 
 
             CreateCompatibleRenderPasses(
-                reinterpret_cast<VulkanDevice*>(dev.get()), description, isPresented,
+                reinterpret_cast<VulkanDevice*>(dev.get()), description,
                 renderPassNoClear, renderPassNoClearLoad, renderPassClear
             );
         }
@@ -98,9 +103,9 @@ namespace Veldrid
         virtual VkRenderPass GetRenderPassNoClear_Load() const {return renderPassNoClearLoad;}
         virtual VkRenderPass GetRenderPassClear() const {return renderPassClear;}
 
-        virtual const Description& GetDesc() const {return description;}
+        virtual bool IsPresented() const override {return _isPresented;}
 
-        virtual void TransitionToAttachmentLayout(VkCommandBuffer cb) override;
+        virtual const Description& GetDesc() const {return description;}
 
         virtual void VisitAttachments(AttachmentVisitor visitor);
 
@@ -3,6 +3,7 @@
 #include "veldrid/common/Common.hpp"
 #include "veldrid/Helpers.hpp"
 
+#include <memory>
 #include <vector>
 #include <set>
 
@@ -11,26 +12,44 @@
 #include "VulkanDevice.hpp"
 #include "VulkanShader.hpp"
 #include "VulkanBindableResource.hpp"
+#include "VkPipelineDedupCache.hpp"
 
 namespace Veldrid{
 
+    static std::vector<VkPushConstantRange> _CvtPushConstantRanges(
+        const std::vector<PushConstantRange>& ranges
+    ){
+        std::vector<VkPushConstantRange> vkRanges(ranges.size());
+        for (unsigned i = 0; i < ranges.size(); i++) {
+            assert(ranges[i].offset % 4 == 0 && ranges[i].size % 4 == 0);
+            vkRanges[i].stageFlags = VdToVkShaderStages(ranges[i].stages);
+            vkRanges[i].offset = ranges[i].offset;
+            vkRanges[i].size = ranges[i].size;
+        }
+        return vkRanges;
+    }
+
+    VkShaderStageFlags VulkanPipelineBase::GetPushConstantStages(
+        std::uint32_t offset, std::uint32_t size
+    ) const {
+        VkShaderStageFlags stages = 0;
+        for (auto& range : _pushConstantRanges) {
+            if (range.offset < offset + size && offset < range.offset + range.size) {
+                stages |= range.stageFlags;
+            }
+        }
+        return stages;
+    }
+
     VkRenderPass CreateFakeRenderPassForCompat(
         VulkanDevice* dev,
         const OutputDescription& outputDesc,
         VkSampleCountFlagBits sampleCnt
     ){
-
-        bool hasColorAttachment = !outputDesc.colorAttachment.empty();
-        bool hasDepthAttachment = outputDesc.depthAttachment.has_value();
-
-        VkRenderPassCreateInfo renderPassCI{};
-        renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-
-        std::vector<VkAttachmentDescription> attachments{};
-        unsigned colorAttachmentCount = outputDesc.colorAttachment.size();
-
-
-        std::vector<VkAttachmentReference> colorAttachmentRefs{colorAttachmentCount};
+        //Only formats and sample counts matter for compatibility, pipelines
+        //with the same outputs share one pass from the device cache.
+        _RenderPassKey key{};
+        auto& attachments = key.attachments;
 
         for (unsigned i = 0; i < outputDesc.colorAttachment.size(); i++)
         {
@@ -44,13 +63,9 @@ namespace Veldrid{
             colorAttachmentDesc.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED;
             colorAttachmentDesc.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
             attachments.push_back(colorAttachmentDesc);
-
-            colorAttachmentRefs[i].attachment = i;
-            colorAttachmentRefs[i].layout = VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
         }
 
-        VkAttachmentReference depthAttachmentRef{};
-        if (hasDepthAttachment)
+        if (outputDesc.depthAttachment.has_value())
         {
             VkAttachmentDescription depthAttachmentDesc{};
             PixelFormat depthFormat = outputDesc.depthAttachment.value().format;
@@ -66,41 +81,10 @@ namespace Veldrid{
             depthAttachmentDesc.initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED;
             depthAttachmentDesc.finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
             attachments.push_back(depthAttachmentDesc);
-
-            depthAttachmentRef.attachment = colorAttachmentCount;
-            depthAttachmentRef.layout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-        }
-
-        VkSubpassDescription subpass{};
-        subpass.pipelineBindPoint = VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS;
-        if(hasColorAttachment){
-            subpass.colorAttachmentCount = colorAttachmentCount;
-            subpass.pColorAttachments = colorAttachmentRefs.data();
-        }
-        
-        if (hasDepthAttachment)
-        {
-            subpass.pDepthStencilAttachment = &depthAttachmentRef;
+            key.hasDepth = true;
         }
 
-        VkSubpassDependency subpassDependency{};
-        subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        subpassDependency.srcStageMask = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpassDependency.dstStageMask = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpassDependency.dstAccessMask 
-            = VkAccessFlagBits::VK_ACCESS_COLOR_ATTACHMENT_READ_BIT 
-            | VkAccessFlagBits::VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-        renderPassCI.attachmentCount = attachments.size();
-        renderPassCI.pAttachments = attachments.data();
-        renderPassCI.subpassCount = 1;
-        renderPassCI.pSubpasses = &subpass;
-        renderPassCI.dependencyCount = 1;
-        renderPassCI.pDependencies = &subpassDependency;
-
-        VkRenderPass renderPass;
-        VK_CHECK(vkCreateRenderPass(dev->LogicalDev(), &renderPassCI, nullptr, &renderPass));
-        return renderPass;
+        return dev->GetRenderPass(key);
     }
 
 
@@ -110,17 +94,18 @@ namespace Veldrid{
         vkDestroyPipeline(vkDev->LogicalDev(), _devicePipeline, nullptr);
     }
 
+    void VulkanPipelineBase::weak_dispose() const {
+        if (_dedupCache != nullptr) {
+            _dedupCache->Evict(this, _dedupHash);
+        }
+    }
+
     VulkanComputePipeline::~VulkanComputePipeline(){
 
     }
 
     VulkanGraphicsPipeline::~VulkanGraphicsPipeline(){
-
-        auto vkDev = _Dev();
-        if (!IsComputePipeline())
-        {
-            vkDestroyRenderPass(vkDev->LogicalDev(), _renderPass, nullptr);
-        }
+        //_renderPass is owned by the device render pass cache
     }
 
     void _CreateStandardPipeline(
@@ -262,27 +247,117 @@ namespace Veldrid{
         return;
     }
 
-    sp<Pipeline> VulkanGraphicsPipeline::Make(
-        const sp<VulkanDevice>& dev,
-        const GraphicsPipelineDescription& desc
-    )
-    {
+    //Packed specialization constants, outlives the create infos
+    //pointing at it.
+    struct _SpecializationData {
+        VkSpecializationInfo info{};
+        std::vector<std::uint8_t> data;
+        std::vector<VkSpecializationMapEntry> mapEntries;
+
+        void Fill(const SpecializationConstant* const* specs, std::size_t count) {
+            info = {};
+            if (count == 0) return;
 
-        VkGraphicsPipelineCreateInfo pipelineCI{};
+            unsigned specDataSize = 0;
+            for (std::size_t i = 0; i < count; i++) {
+                specDataSize += GetSpecializationConstantSize(specs[i]->type);
+            }
+            data.resize(specDataSize);
+            mapEntries.resize(count);
+            unsigned specOffset = 0;
+            for (std::size_t i = 0; i < count; i++)
+            {
+                auto specData = specs[i]->data;
+                auto srcData = (std::uint8_t*)&specData;
+                auto dataSize = GetSpecializationConstantSize(specs[i]->type);
+                memcpy(data.data() + specOffset, srcData, dataSize);
+                mapEntries[i].constantID = specs[i]->id;
+                mapEntries[i].offset = specOffset;
+                mapEntries[i].size = dataSize;
+                specOffset += dataSize;
+            }
+            info.dataSize = specDataSize;
+            info.pData = data.data();
+            info.mapEntryCount = count;
+            info.pMapEntries = mapEntries.data();
+        }
+    };
+
+    static VkPipelineLayout _CreatePipelineLayout(
+        VulkanDevice* dev,
+        const std::vector<sp<ResourceLayout>>& resourceLayouts,
+        const std::vector<VkPushConstantRange>& pushConstantRanges
+    ){
+        VkPipelineLayoutCreateInfo pipelineLayoutCI {};
+        pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCI.setLayoutCount = resourceLayouts.size();
+        std::vector<VkDescriptorSetLayout> dsls (resourceLayouts.size());
+        for (int i = 0; i < resourceLayouts.size(); i++)
+        {
+            dsls[i] = PtrCast<VulkanResourceLayout>(resourceLayouts[i].get())->GetHandle();
+        }
+        pipelineLayoutCI.pSetLayouts = dsls.data();
+        pipelineLayoutCI.pushConstantRangeCount = pushConstantRanges.size();
+        pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
+
+        VkPipelineLayout pipelineLayout;
+        VK_CHECK(vkCreatePipelineLayout(dev->LogicalDev(), &pipelineLayoutCI, nullptr, &pipelineLayout));
+        return pipelineLayout;
+    }
+
+    static std::uint32_t _CountDynamicOffsets(const std::vector<sp<ResourceLayout>>& resourceLayouts) {
+        std::uint32_t dynamicOffsetsCount = 0;
+        for(auto& layout : resourceLayouts)
+        {
+            auto vkLayout = PtrCast<VulkanResourceLayout>(layout.get());
+            dynamicOffsetsCount += vkLayout->GetDynamicBufferCount();
+        }
+        return dynamicOffsetsCount;
+    }
+
+    //Everything a VkGraphicsPipelineCreateInfo points to, so several of
+    //them can be handed to a single vkCreateGraphicsPipelines call.
+    //pipelineCI points into the struct, it must not move once filled.
+    struct _GraphicsPipelineCI {
+        VkGraphicsPipelineCreateInfo pipelineCI;
+        VkPipelineColorBlendStateCreateInfo blendStateCI;
+        std::vector<VkPipelineColorBlendAttachmentState> attachments;
+        VkPipelineRasterizationStateCreateInfo rsCI;
+        VkDynamicState dynamicStates[2];
+        VkPipelineDynamicStateCreateInfo dynamicStateCI;
+        VkPipelineDepthStencilStateCreateInfo dssCI;
+        VkPipelineMultisampleStateCreateInfo multisampleCI;
+        VkPipelineInputAssemblyStateCreateInfo inputAssemblyCI;
+        VkPipelineVertexInputStateCreateInfo vertexInputCI;
+        std::vector<VkVertexInputBindingDescription> bindingDescs;
+        std::vector<VkVertexInputAttributeDescription> attributeDescs;
+        std::vector<const SpecializationConstant*> specs;
+        _SpecializationData specialization;
+        std::vector<VkPipelineShaderStageCreateInfo> stageCIs;
+        VkPipelineViewportStateCreateInfo viewportStateCI;
+        std::vector<VkPushConstantRange> pushConstantRanges;
+        _PipelineCacheMgr::Feedback feedback;
+
+        _GraphicsPipelineCI() = default;
+        _GraphicsPipelineCI(const _GraphicsPipelineCI&) = delete;
+        _GraphicsPipelineCI& operator=(const _GraphicsPipelineCI&) = delete;
+
+        //Also creates the pipeline layout, owned by the caller
+        void Fill(VulkanDevice* dev, const GraphicsPipelineDescription& desc);
+    };
+
+    void _GraphicsPipelineCI::Fill(
+        VulkanDevice* dev,
+        const GraphicsPipelineDescription& desc
+    ){
+        pipelineCI = {};
         pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 
-        //*************************************************
-        //*************************************************
-        //*************************************************
-        // From Standard creation info ***Makes it work!***
-        //*************************************************
-        //*************************************************
-        //*************************************************
         // Blend State
-        VkPipelineColorBlendStateCreateInfo blendStateCI{};
+        blendStateCI = {};
         blendStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
         auto attachmentsCount = desc.blendState.attachments.size();
-        std::vector<VkPipelineColorBlendAttachmentState> attachments(attachmentsCount);
+        attachments.assign(attachmentsCount, {});
         for (int i = 0; i < attachmentsCount; i++)
         {
             auto vdDesc = desc.blendState.attachments[i];
@@ -310,7 +385,7 @@ namespace Veldrid{
         
         // Rasterizer State
         auto& rsDesc = desc.rasterizerState;
-        VkPipelineRasterizationStateCreateInfo rsCI{};
+        rsCI = {};
         rsCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
         rsCI.cullMode = VdToVkCullMode(rsDesc.cullMode);
         rsCI.polygonMode = VdToVkPolygonMode(rsDesc.fillMode);
@@ -322,9 +397,8 @@ namespace Veldrid{
         pipelineCI.pRasterizationState = &rsCI;
 
         // Dynamic State
-        VkPipelineDynamicStateCreateInfo dynamicStateCI{};
+        dynamicStateCI = {};
         dynamicStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        VkDynamicState dynamicStates[2];
         dynamicStates[0] = VkDynamicState::VK_DYNAMIC_STATE_VIEWPORT;
         dynamicStates[1] = VkDynamicState::VK_DYNAMIC_STATE_SCISSOR;
         dynamicStateCI.dynamicStateCount = 2;
@@ -334,7 +408,7 @@ namespace Veldrid{
 
         // Depth Stencil State
         auto& vdDssDesc = desc.depthStencilState;
-        VkPipelineDepthStencilStateCreateInfo dssCI{};
+        dssCI = {};
         dssCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
         dssCI.depthWriteEnable = vdDssDesc.depthWriteEnabled;
         dssCI.depthTestEnable = vdDssDesc.depthTestEnabled;
@@ -360,7 +434,7 @@ namespace Veldrid{
         pipelineCI.pDepthStencilState = &dssCI;
 
         // Multisample
-        VkPipelineMultisampleStateCreateInfo multisampleCI{};
+        multisampleCI = {};
         multisampleCI.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         VkSampleCountFlagBits vkSampleCount = VdToVkSampleCount(desc.outputs.sampleCount);
         multisampleCI.rasterizationSamples = vkSampleCount;
@@ -368,14 +442,14 @@ namespace Veldrid{
         pipelineCI.pMultisampleState = &multisampleCI;
 
         // Input Assembly
-        VkPipelineInputAssemblyStateCreateInfo inputAssemblyCI{};
+        inputAssemblyCI = {};
         inputAssemblyCI.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         inputAssemblyCI.topology = VdToVkPrimitiveTopology(desc.primitiveTopology);
         inputAssemblyCI.primitiveRestartEnable = VK_FALSE;
         pipelineCI.pInputAssemblyState = &inputAssemblyCI;
 
         // Vertex Input State
-        VkPipelineVertexInputStateCreateInfo vertexInputCI{};
+        vertexInputCI = {};
         vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
         auto& inputDescriptions = desc.shaderSet.vertexLayouts;
@@ -385,8 +459,8 @@ namespace Veldrid{
         {
             attributeCount += inputDescriptions[i].elements.size();
         }
-        std::vector<VkVertexInputBindingDescription> bindingDescs(bindingCount);
-        std::vector<VkVertexInputAttributeDescription> attributeDescs(attributeCount);
+        bindingDescs.assign(bindingCount, {});
+        attributeDescs.assign(attributeCount, {});
 
         int targetIndex = 0;
         int targetLocation = 0;
@@ -426,39 +500,13 @@ namespace Veldrid{
         pipelineCI.pVertexInputState = &vertexInputCI;
 
         // Shader Stage
-
-        VkSpecializationInfo specializationInfo{};
         auto& specDescs = desc.shaderSet.specializations;
-        if (!specDescs.empty())
-        {
-            unsigned specDataSize = 0;
-            for (auto& spec : specDescs) {
-                specDataSize += GetSpecializationConstantSize(spec.type);
-            }
-            std::vector<std::uint8_t> fullSpecData(specDataSize);
-            int specializationCount = specDescs.size();
-            std::vector<VkSpecializationMapEntry> mapEntries(specializationCount);
-            unsigned specOffset = 0;
-            for (int i = 0; i < specializationCount; i++)
-            {
-                auto data = specDescs[i].data;
-                auto srcData = (byte*)&data;
-                auto dataSize = GetSpecializationConstantSize(specDescs[i].type);
-                //Unsafe.CopyBlock(fullSpecData + specOffset, srcData, dataSize);
-                memcpy(fullSpecData.data() + specOffset, srcData, dataSize);
-                mapEntries[i].constantID = specDescs[i].id;
-                mapEntries[i].offset = specOffset;
-                mapEntries[i].size = dataSize;
-                specOffset += dataSize;
-            }
-            specializationInfo.dataSize = specDataSize;
-            specializationInfo.pData = fullSpecData.data();
-            specializationInfo.mapEntryCount = specializationCount;
-            specializationInfo.pMapEntries = mapEntries.data();
-        }
+        specs.clear();
+        for (auto& spec : specDescs) specs.push_back(&spec);
+        specialization.Fill(specs.data(), specs.size());
 
         auto& shaders = desc.shaderSet.shaders;
-        std::vector<VkPipelineShaderStageCreateInfo> stageCIs(shaders.size());
+        stageCIs.assign(shaders.size(), {});
         for (unsigned i = 0; i < shaders.size(); i++){
             auto& shader = shaders[i];
             auto vkShader = reinterpret_cast<VulkanShader*>(shader.get());
@@ -468,7 +516,7 @@ namespace Veldrid{
             stageCI.stage = VdToVkShaderStageSingle(shader->GetDesc().stage);
             // stageCI.pName = CommonStrings.main; // Meh
             stageCI.pName = shader->GetDesc().entryPoint.c_str(); // TODO: DONT ALLOCATE HERE
-            stageCI.pSpecializationInfo = &specializationInfo;
+            stageCI.pSpecializationInfo = &specialization.info;
         }
 
         pipelineCI.stageCount = stageCIs.size();
@@ -477,7 +525,7 @@ namespace Veldrid{
         // ViewportState
         // Vulkan spec specifies that there must be 1 viewport no matter
         // dynamic viewport state enabled or not...
-        VkPipelineViewportStateCreateInfo viewportStateCI{};
+        viewportStateCI = {};
         viewportStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportStateCI.viewportCount = 1;
         viewportStateCI.scissorCount = 1;
@@ -485,144 +533,151 @@ namespace Veldrid{
         pipelineCI.pViewportState = &viewportStateCI;
 
         // Pipeline Layout
-        auto& resourceLayouts = desc.resourceLayouts;
-        VkPipelineLayoutCreateInfo pipelineLayoutCI {};
-        pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutCI.setLayoutCount = resourceLayouts.size();
-        std::vector<VkDescriptorSetLayout> dsls (resourceLayouts.size());
-        for (int i = 0; i < resourceLayouts.size(); i++)
-        {
-            dsls[i] = PtrCast<VulkanResourceLayout>(resourceLayouts[i].get())->GetHandle();
-        }
-        pipelineLayoutCI.pSetLayouts = dsls.data();
-        
-        VkPipelineLayout pipelineLayout;
-        VK_CHECK(vkCreatePipelineLayout(dev->LogicalDev(), &pipelineLayoutCI, nullptr, &pipelineLayout));
-        pipelineCI.layout = pipelineLayout;
+        pushConstantRanges = _CvtPushConstantRanges(desc.pushConstantRanges);
+        pipelineCI.layout = _CreatePipelineLayout(dev, desc.resourceLayouts, pushConstantRanges);
         
         // Create fake RenderPass for compatibility.
-        auto& outputDesc = desc.outputs;
-        
-        //auto compatRenderPass = CreateFakeRenderPassForCompat(dev.get(), outputDesc, VK_SAMPLE_COUNT_1_BIT);
-        auto compatRenderPass = CreateFakeRenderPassForCompat(dev.get(), outputDesc, vkSampleCount);
-        
-        pipelineCI.renderPass = compatRenderPass;
+        pipelineCI.renderPass = CreateFakeRenderPassForCompat(dev, desc.outputs, vkSampleCount);
         
-        VkPipeline devicePipeline;
-        VK_CHECK(vkCreateGraphicsPipelines(dev->LogicalDev(), VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &devicePipeline));
-
-        //auto vkVertShader = reinterpret_cast<VulkanShader*>(shaders[0].get());
-        //auto vkFragShader = reinterpret_cast<VulkanShader*>(shaders[1].get());
+        pipelineCI.pNext = dev->PipelineCache().AttachFeedback(
+            feedback, pipelineCI.stageCount, pipelineCI.pNext);
+    }
 
-        //_CreateStandardPipeline(dev->LogicalDev(),
-        //    vkVertShader->GetHandle(), vkFragShader->GetHandle(),
-        //    640,480, compatRenderPass, 
-        //    pipelineLayout, devicePipeline
-        //    );
+    sp<Pipeline> VulkanGraphicsPipeline::Make(
+        const sp<VulkanDevice>& dev,
+        const GraphicsPipelineDescription& desc
+    )
+    {
+        return MakeBatch(dev, &desc, 1).front();
+    }
 
-        std::uint32_t resourceSetCount = desc.resourceLayouts.size();
-        std::uint32_t dynamicOffsetsCount = 0;
-        for(auto& layout : desc.resourceLayouts)
-        {
-            auto vkLayout = PtrCast<VulkanResourceLayout>(layout.get());
-            dynamicOffsetsCount += vkLayout->GetDynamicBufferCount();
+    std::vector<sp<Pipeline>> VulkanGraphicsPipeline::MakeBatch(
+        const sp<VulkanDevice>& dev,
+        const GraphicsPipelineDescription* descs,
+        std::size_t count
+    )
+    {
+        //Create infos point into their own storage, keep them in place
+        std::vector<std::unique_ptr<_GraphicsPipelineCI>> cis(count);
+        std::vector<VkGraphicsPipelineCreateInfo> pipelineCIs(count);
+        for (std::size_t i = 0; i < count; i++) {
+            cis[i] = std::make_unique<_GraphicsPipelineCI>();
+            cis[i]->Fill(dev.get(), descs[i]);
+            pipelineCIs[i] = cis[i]->pipelineCI;
         }
 
-        auto rawPipe = new VulkanGraphicsPipeline(dev);
-        rawPipe->_devicePipeline = devicePipeline;
-        rawPipe->_pipelineLayout = pipelineLayout;
-        rawPipe->_renderPass = compatRenderPass;
-        rawPipe->scissorTestEnabled = rsDesc.scissorTestEnabled;
-        rawPipe->resourceSetCount = resourceSetCount;
-        rawPipe->dynamicOffsetsCount = dynamicOffsetsCount;
-
-        return sp(rawPipe);
+        //One call lets the driver compile the whole batch at once
+        auto& pipelineCache = dev->PipelineCache();
+        std::vector<VkPipeline> devicePipelines(count);
+        VK_CHECK(vkCreateGraphicsPipelines(
+            dev->LogicalDev(), pipelineCache.GetHandle(),
+            count, pipelineCIs.data(), nullptr, devicePipelines.data()));
+
+        std::vector<sp<Pipeline>> pipelines;
+        pipelines.reserve(count);
+        for (std::size_t i = 0; i < count; i++) {
+            auto& ci = *cis[i];
+            auto& desc = descs[i];
+            pipelineCache.RecordCreation(ci.feedback);
+
+            auto rawPipe = new VulkanGraphicsPipeline(dev);
+            rawPipe->_devicePipeline = devicePipelines[i];
+            rawPipe->_pipelineLayout = ci.pipelineCI.layout;
+            rawPipe->_renderPass = ci.pipelineCI.renderPass;
+            rawPipe->scissorTestEnabled = desc.rasterizerState.scissorTestEnabled;
+            rawPipe->resourceSetCount = desc.resourceLayouts.size();
+            rawPipe->dynamicOffsetsCount = _CountDynamicOffsets(desc.resourceLayouts);
+            rawPipe->_pushConstantRanges = std::move(ci.pushConstantRanges);
+            pipelines.push_back(sp(rawPipe));
+        }
+        return pipelines;
     }
 
+    //Compute counterpart of _GraphicsPipelineCI
+    struct _ComputePipelineCI {
+        VkComputePipelineCreateInfo pipelineCI;
+        _SpecializationData specialization;
+        std::vector<VkPushConstantRange> pushConstantRanges;
+        _PipelineCacheMgr::Feedback feedback;
 
+        _ComputePipelineCI() = default;
+        _ComputePipelineCI(const _ComputePipelineCI&) = delete;
+        _ComputePipelineCI& operator=(const _ComputePipelineCI&) = delete;
 
-    sp<Pipeline> VulkanComputePipeline::Make(
-        const sp<VulkanDevice>& dev,
+        //Also creates the pipeline layout, owned by the caller
+        void Fill(VulkanDevice* dev, const ComputePipelineDescription& desc);
+    };
+
+    void _ComputePipelineCI::Fill(
+        VulkanDevice* dev,
         const ComputePipelineDescription& desc
     ){
-        VkComputePipelineCreateInfo pipelineCI {};
+        pipelineCI = {};
+        pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
 
         // Pipeline Layout
-        auto& resourceLayouts = desc.resourceLayouts;
-        VkPipelineLayoutCreateInfo pipelineLayoutCI{};
-        pipelineLayoutCI.setLayoutCount = resourceLayouts.size();
-        std::vector<VkDescriptorSetLayout> dsls{resourceLayouts.size()};
-        for (int i = 0; i < resourceLayouts.size(); i++)
-        {
-            dsls[i] = PtrCast<VulkanResourceLayout>(resourceLayouts[i].get())->GetHandle();
-        }
-        pipelineLayoutCI.pSetLayouts = dsls.data();
-
-        VkPipelineLayout pipelineLayout;
-        VK_CHECK(vkCreatePipelineLayout(dev->LogicalDev(), &pipelineLayoutCI, nullptr, &pipelineLayout));
+        pushConstantRanges = _CvtPushConstantRanges(desc.pushConstantRanges);
+        pipelineCI.layout = _CreatePipelineLayout(dev, desc.resourceLayouts, pushConstantRanges);
 
         // Shader Stage
-
-        VkSpecializationInfo specializationInfo;
-        auto& specDescs = desc.specializations;
-        if (!specDescs.empty())
-        {
-            unsigned specDataSize = 0;
-            for(auto& spec : specDescs)
-            {
-                specDataSize += GetSpecializationConstantSize(spec->type);
-            }
-            std::vector<std::uint8_t> fullSpecData(specDataSize);
-            unsigned specializationCount = specDescs.size();
-            std::vector<VkSpecializationMapEntry> mapEntries(specializationCount);
-            unsigned specOffset = 0;
-            for (int i = 0; i < specializationCount; i++)
-            {
-                auto data = specDescs[i]->data;
-                byte* srcData = (byte*)&data;
-                unsigned dataSize = GetSpecializationConstantSize(specDescs[i]->type);
-                memcpy(fullSpecData.data() + specOffset, srcData, dataSize);
-                mapEntries[i].constantID = specDescs[i]->id;
-                mapEntries[i].offset = specOffset;
-                mapEntries[i].size = dataSize;
-                specOffset += dataSize;
-            }
-            specializationInfo.dataSize = specDataSize;
-            specializationInfo.pData = fullSpecData.data();
-            specializationInfo.mapEntryCount = specializationCount;
-            specializationInfo.pMapEntries = mapEntries.data();
-        }
+        specialization.Fill(desc.specializations.data(), desc.specializations.size());
 
         auto& shader = desc.computeShader;
         auto* vkShader = PtrCast<VulkanShader>(shader.get());
         VkPipelineShaderStageCreateInfo stageCI{};
+        stageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         stageCI.module = vkShader->GetHandle();
         stageCI.stage = VdToVkShaderStageSingle(shader->GetDesc().stage);
         stageCI.pName = "main"; // Meh
-        stageCI.pSpecializationInfo = &specializationInfo;
+        stageCI.pSpecializationInfo = &specialization.info;
         pipelineCI.stage = stageCI;
 
-        VkPipeline devicePipeline;
-        VK_CHECK(vkCreateComputePipelines(
-            dev->LogicalDev(),VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &devicePipeline
-        ));
+        pipelineCI.pNext = dev->PipelineCache().AttachFeedback(feedback, 1, pipelineCI.pNext);
+    }
 
-        
-        std::uint32_t resourceSetCount = desc.resourceLayouts.size();
-        std::uint32_t dynamicOffsetsCount = 0;
-        for(auto& layout : desc.resourceLayouts)
-        {
-            auto vkLayout = PtrCast<VulkanResourceLayout>(layout.get());
-            dynamicOffsetsCount += vkLayout->GetDynamicBufferCount();
+    sp<Pipeline> VulkanComputePipeline::Make(
+        const sp<VulkanDevice>& dev,
+        const ComputePipelineDescription& desc
+    ){
+        return MakeBatch(dev, &desc, 1).front();
+    }
+
+    std::vector<sp<Pipeline>> VulkanComputePipeline::MakeBatch(
+        const sp<VulkanDevice>& dev,
+        const ComputePipelineDescription* descs,
+        std::size_t count
+    ){
+        std::vector<std::unique_ptr<_ComputePipelineCI>> cis(count);
+        std::vector<VkComputePipelineCreateInfo> pipelineCIs(count);
+        for (std::size_t i = 0; i < count; i++) {
+            cis[i] = std::make_unique<_ComputePipelineCI>();
+            cis[i]->Fill(dev.get(), descs[i]);
+            pipelineCIs[i] = cis[i]->pipelineCI;
         }
 
-        auto rawPipe = new VulkanComputePipeline(dev);
-        rawPipe->_devicePipeline = devicePipeline;
-        rawPipe->_pipelineLayout = pipelineLayout;
-        rawPipe->resourceSetCount = resourceSetCount;
-        rawPipe->dynamicOffsetsCount = dynamicOffsetsCount;
+        auto& pipelineCache = dev->PipelineCache();
+        std::vector<VkPipeline> devicePipelines(count);
+        VK_CHECK(vkCreateComputePipelines(
+            dev->LogicalDev(), pipelineCache.GetHandle(),
+            count, pipelineCIs.data(), nullptr, devicePipelines.data()
+        ));
 
-        return sp(rawPipe);
+        std::vector<sp<Pipeline>> pipelines;
+        pipelines.reserve(count);
+        for (std::size_t i = 0; i < count; i++) {
+            auto& ci = *cis[i];
+            auto& desc = descs[i];
+            pipelineCache.RecordCreation(ci.feedback);
+
+            auto rawPipe = new VulkanComputePipeline(dev);
+            rawPipe->_devicePipeline = devicePipelines[i];
+            rawPipe->_pipelineLayout = ci.pipelineCI.layout;
+            rawPipe->resourceSetCount = desc.resourceLayouts.size();
+            rawPipe->dynamicOffsetsCount = _CountDynamicOffsets(desc.resourceLayouts);
+            rawPipe->_pushConstantRanges = std::move(ci.pushConstantRanges);
+            pipelines.push_back(sp(rawPipe));
+        }
+        return pipelines;
     }
 
 }
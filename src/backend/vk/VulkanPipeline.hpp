@@ -11,6 +11,7 @@
 namespace Veldrid
 {
     class VulkanDevice;
+    class _PipelineDedupCache;
 
     VkRenderPass CreateFakeRenderPassForCompat(
         VulkanDevice* dev,
@@ -19,6 +20,11 @@ namespace Veldrid
     );
 
     class VulkanPipelineBase : public Pipeline{
+        friend class _PipelineDedupCache;
+
+        //Set when the pipeline is shared through the dedup cache
+        _PipelineDedupCache* _dedupCache = nullptr;
+        std::size_t _dedupHash = 0;
 
     protected:
         VulkanDevice* _Dev() {return reinterpret_cast<VulkanDevice*>(dev.get());}
@@ -28,6 +34,7 @@ namespace Veldrid
         
         std::uint32_t resourceSetCount;
         std::uint32_t dynamicOffsetsCount;
+        std::vector<VkPushConstantRange> _pushConstantRanges;
         //public override bool IsComputePipeline { get; }
 
         //public ResourceRefCount RefCount { get; }
@@ -127,6 +134,9 @@ namespace Veldrid
         //    }
         //}
 
+        //Leave the dedup cache before anyone can find the dying pipeline
+        void weak_dispose() const override;
+
     public:
         virtual ~VulkanPipelineBase();
 
@@ -134,6 +144,10 @@ namespace Veldrid
         const VkPipelineLayout& GetLayout() const { return _pipelineLayout; }
         std::uint32_t GetResourceSetCount() const { return resourceSetCount; }
         std::uint32_t GetDynamicOffsetCount() const {return dynamicOffsetsCount;}
+
+        //Stages of every range overlapping the bytes, as vkCmdPushConstants
+        //requires. 0 if the bytes are not covered by the layout.
+        VkShaderStageFlags GetPushConstantStages(std::uint32_t offset, std::uint32_t size) const;
     
     };
 
@@ -152,6 +166,13 @@ namespace Veldrid
             const ComputePipelineDescription& desc
         );
 
+        //All pipelines are created by one vkCreateComputePipelines call
+        static std::vector<sp<Pipeline>> MakeBatch(
+            const sp<VulkanDevice>& dev,
+            const ComputePipelineDescription* descs,
+            std::size_t count
+        );
+
         bool IsComputePipeline() const override {return true;}
 
     };
@@ -178,6 +199,13 @@ namespace Veldrid
             const GraphicsPipelineDescription& desc
         );
 
+        //All pipelines are created by one vkCreateGraphicsPipelines call
+        static std::vector<sp<Pipeline>> MakeBatch(
+            const sp<VulkanDevice>& dev,
+            const GraphicsPipelineDescription* descs,
+            std::size_t count
+        );
+
         bool IsComputePipeline() const override {return false;}
 
     };
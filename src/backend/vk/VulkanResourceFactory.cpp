@@ -3,6 +3,8 @@
 #include <volk.h>
 
 #include <cassert>
+#include <cstdint>
+#include <optional>
 
 #include "VulkanDevice.hpp"
 #include "VulkanPipeline.hpp"
@@ -12,6 +14,7 @@
 #include "VulkanBindableResource.hpp"
 #include "VulkanSwapChain.hpp"
 #include "VulkanFramebuffer.hpp"
+#include "VkPipelineCompilePool.hpp"
 
 namespace Veldrid
 {
@@ -34,15 +37,26 @@ namespace Veldrid
 
     sp<Shader> VulkanResourceFactory::CreateShader(
         const Shader::Description& desc,
-        const std::vector<std::uint32_t>& spv
+        const std::uint32_t* spv,
+        std::size_t wordCount
     ){
-        return VulkanShader::Make(_CreateNewDevHandle(), desc, spv);
+        return VulkanShader::Make(_CreateNewDevHandle(), desc, spv, wordCount);
+    }
+
+    static sp<Pipeline> _CreateGraphicsPipeline(
+        const sp<VulkanDevice>& dev,
+        const GraphicsPipelineDescription& description
+    ) {
+        //Identical descriptions share one pipeline
+        return dev->PipelineDedup().GetOrCreate(description, [&]() {
+            return VulkanGraphicsPipeline::Make(dev, description);
+        });
     }
 
     sp<Pipeline> VulkanResourceFactory::CreateGraphicsPipeline(
         const GraphicsPipelineDescription& description
     ) {
-        return VulkanGraphicsPipeline::Make(_CreateNewDevHandle(), description);
+        return _CreateGraphicsPipeline(_CreateNewDevHandle(), description);
     }
         
     sp<Pipeline> VulkanResourceFactory::CreateComputePipeline(
@@ -51,6 +65,88 @@ namespace Veldrid
         return VulkanComputePipeline::Make(_CreateNewDevHandle(), description);
     }
 
+    std::future<sp<Pipeline>> VulkanResourceFactory::CreateGraphicsPipelineAsync(
+        const GraphicsPipelineDescription& description
+    ) {
+        //The binding model is only pointed to, the task keeps its own copy
+        std::optional<ResourceBindingModel> bindingModel;
+        if (description.resourceBindingModel != nullptr) {
+            bindingModel = *description.resourceBindingModel;
+        }
+        return _PipelineCompilePool::Get().Submit(
+            [dev = _CreateNewDevHandle(), desc = description, bindingModel]() mutable {
+                desc.resourceBindingModel = bindingModel.has_value() ? &*bindingModel : nullptr;
+                return _CreateGraphicsPipeline(dev, desc);
+            });
+    }
+
+    std::future<sp<Pipeline>> VulkanResourceFactory::CreateComputePipelineAsync(
+        const ComputePipelineDescription& description
+    ) {
+        return _PipelineCompilePool::Get().Submit(
+            [dev = _CreateNewDevHandle(), desc = description]() {
+                return VulkanComputePipeline::Make(dev, desc);
+            });
+    }
+
+    std::vector<sp<Pipeline>> VulkanResourceFactory::CreateGraphicsPipelines(
+        const std::vector<GraphicsPipelineDescription>& descriptions
+    ) {
+        auto dev = _CreateNewDevHandle();
+        auto& dedup = dev->PipelineDedup();
+
+        //Only descriptions without a live pipeline are compiled,
+        //each of them once even if repeated within the batch.
+        std::vector<sp<Pipeline>> pipelines(descriptions.size());
+        std::vector<std::size_t> hashes(descriptions.size());
+        std::vector<GraphicsPipelineDescription> missDescs;
+        std::vector<std::size_t> missIndices;
+        //Index into missDescs of each description compiled in the batch
+        std::vector<std::size_t> batchSlots(descriptions.size(), SIZE_MAX);
+        for (std::size_t i = 0; i < descriptions.size(); i++) {
+            hashes[i] = HashPipelineDescription(descriptions[i]);
+            pipelines[i] = dedup.Find(hashes[i], descriptions[i]);
+            if (pipelines[i] != nullptr) continue;
+
+            for (std::size_t slot = 0; slot < missIndices.size(); slot++) {
+                auto missIndex = missIndices[slot];
+                if (hashes[missIndex] == hashes[i]
+                    && IsSamePipelineDescription(missDescs[slot], descriptions[i])
+                ) {
+                    batchSlots[i] = slot;
+                    break;
+                }
+            }
+            if (batchSlots[i] == SIZE_MAX) {
+                batchSlots[i] = missDescs.size();
+                missDescs.push_back(descriptions[i]);
+                missIndices.push_back(i);
+            }
+        }
+        if (missDescs.empty()) return pipelines;
+
+        auto created = VulkanGraphicsPipeline::MakeBatch(dev, missDescs.data(), missDescs.size());
+        for (std::size_t slot = 0; slot < missIndices.size(); slot++) {
+            auto index = missIndices[slot];
+            pipelines[index] = dedup.Insert(hashes[index], descriptions[index], std::move(created[slot]));
+        }
+        //Repeats share the pipeline of their first occurrence
+        for (std::size_t i = 0; i < descriptions.size(); i++) {
+            if (pipelines[i] == nullptr) {
+                pipelines[i] = pipelines[missIndices[batchSlots[i]]];
+            }
+        }
+        return pipelines;
+    }
+
+    std::vector<sp<Pipeline>> VulkanResourceFactory::CreateComputePipelines(
+        const std::vector<ComputePipelineDescription>& descriptions
+    ) {
+        if (descriptions.empty()) return {};
+        return VulkanComputePipeline::MakeBatch(
+            _CreateNewDevHandle(), descriptions.data(), descriptions.size());
+    }
+
     sp<Texture> VulkanResourceFactory::WrapNativeTexture(
         void* nativeHandle,
         const Texture::Description& description
@@ -69,8 +165,10 @@ namespace Veldrid
     }
 
     
-    sp<CommandList> VulkanResourceFactory::CreateCommandList(){
-        return VulkanCommandList::Make(_CreateNewDevHandle());
+    sp<CommandList> VulkanResourceFactory::CreateCommandList(
+        const CommandList::Description& description
+    ){
+        return VulkanCommandList::Make(_CreateNewDevHandle(), description);
     }
 
     sp<Fence> VulkanResourceFactory::CreateFence(bool initialSignaled) {
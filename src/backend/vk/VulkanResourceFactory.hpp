@@ -33,9 +33,24 @@ namespace Veldrid{
         sp<Pipeline> CreateComputePipeline(
             const ComputePipelineDescription& description) override;
 
-        sp<Shader> VulkanResourceFactory::CreateShader(
+        std::future<sp<Pipeline>> CreateGraphicsPipelineAsync(
+            const GraphicsPipelineDescription& description) override;
+
+        std::future<sp<Pipeline>> CreateComputePipelineAsync(
+            const ComputePipelineDescription& description) override;
+
+        std::vector<sp<Pipeline>> CreateGraphicsPipelines(
+            const std::vector<GraphicsPipelineDescription>& descriptions) override;
+
+        std::vector<sp<Pipeline>> CreateComputePipelines(
+            const std::vector<ComputePipelineDescription>& descriptions) override;
+
+        using ResourceFactory::CreateShader;
+
+        sp<Shader> CreateShader(
             const Shader::Description& desc,
-            const std::vector<std::uint32_t>& spv
+            const std::uint32_t* spv,
+            std::size_t wordCount
         ) override;
 
         sp<Texture> WrapNativeTexture(
@@ -46,8 +61,10 @@ namespace Veldrid{
             const sp<Texture>& texture,
             const TextureView::Description& description) override;
 
-       
-        virtual sp<CommandList> CreateCommandList() override;
+        using ResourceFactory::CreateCommandList;
+
+        virtual sp<CommandList> CreateCommandList(
+            const CommandList::Description& description) override;
 
         virtual sp<Fence> CreateFence(bool initialSignaled) override;
         virtual sp<Semaphore> CreateDeviceSemaphore() override;
@@ -15,12 +15,13 @@ namespace Veldrid
     sp<Shader> VulkanShader::Make(
         const sp<VulkanDevice>& dev,
         const Shader::Description& desc,
-        const std::vector<std::uint32_t>& spvBinary
+        const std::uint32_t* spvBinary,
+        std::size_t wordCount
     ){
         VkShaderModuleCreateInfo shaderModuleCI {};
         shaderModuleCI.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        shaderModuleCI.codeSize = spvBinary.size() * sizeof(std::uint32_t);
-        shaderModuleCI.pCode = spvBinary.data();
+        shaderModuleCI.codeSize = wordCount * sizeof(std::uint32_t);
+        shaderModuleCI.pCode = spvBinary;
         VkShaderModule module;
         VK_CHECK(vkCreateShaderModule(dev->LogicalDev(), &shaderModuleCI, nullptr, &module));
 
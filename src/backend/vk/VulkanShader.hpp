@@ -35,7 +35,8 @@ namespace Veldrid
         static sp<Shader> Make(
             const sp<VulkanDevice>& dev,
             const Shader::Description& desc,
-            const std::vector<std::uint32_t>& spvBinary
+            const std::uint32_t* spvBinary,
+            std::size_t wordCount
         );
 
     };
@@ -140,10 +140,10 @@ namespace Veldrid
     }
 
     void VulkanSwapChain::ReleaseFramebuffers(){
-        auto _gd = PtrCast<VulkanDevice>(dev.get());
-        vkDestroyRenderPass(_gd->LogicalDev(), _renderPassNoClear, nullptr);
-        vkDestroyRenderPass(_gd->LogicalDev(), _renderPassNoClearLoad, nullptr);
-        vkDestroyRenderPass(_gd->LogicalDev(), _renderPassClear, nullptr);
+        //Render passes belong to the device cache, only forget them
+        _renderPassNoClear = VK_NULL_HANDLE;
+        _renderPassNoClearLoad = VK_NULL_HANDLE;
+        _renderPassClear = VK_NULL_HANDLE;
 
 #ifdef VLD_DEBUG
         //for(auto& fb : _fbs){
@@ -201,7 +201,6 @@ namespace Veldrid
 
             auto dTgt = _gd->GetResourceFactory()->CreateTexture(texDesc);
             auto vkDTgt = PtrCast<VulkanTexture>(dTgt.get());
-            vkDTgt->SetLayout(VK_IMAGE_LAYOUT_UNDEFINED);
 
             _depthTarget = RefRawPtr(vkDTgt);
             _fbDesc.depthTarget = { _depthTarget, _depthTarget->GetDesc().arrayLayers, _depthTarget->GetDesc().mipLevels };
@@ -227,7 +226,7 @@ namespace Veldrid
             //auto firstColorTgt = _gd->GetResourceFactory()->WrapNativeTexture(firstTex, texDesc);
             auto vkFirstColorTgt = PtrCast<VulkanTexture>(firstColorTgt.get());
             _fbDesc.colorTargets = { {firstColorTgt, firstColorTgt->GetDesc().arrayLayers, firstColorTgt->GetDesc().mipLevels} };
-            VulkanFramebufferBase::CreateCompatibleRenderPasses(_gd, _fbDesc, true,
+            VulkanFramebufferBase::CreateCompatibleRenderPasses(_gd, _fbDesc,
                 _renderPassNoClear, _renderPassNoClearLoad, _renderPassClear);
 
             _CreateSCFB(vkFirstColorTgt);
@@ -301,7 +300,8 @@ namespace Veldrid
             //assert(false);
             return result;
         }
-        _fbs[_currentImageIndex]->SetToInitialLayout();
+        //The image is still tracked in the present layout it was left in,
+        //the first list using it transitions it when submitted.
         return VK_SUCCESS;
     }
 
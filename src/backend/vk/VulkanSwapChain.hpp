@@ -51,40 +51,14 @@ namespace Veldrid
         virtual VkRenderPass GetRenderPassNoClear_Load() const;
         virtual VkRenderPass GetRenderPassClear() const;
 
+        virtual bool IsPresented() const override {return true;}
+
         virtual const Description& GetDesc() const;
 
         bool HasDepthTarget() const {return _depthTarget != nullptr;}
 
-        void SetToInitialLayout() {
-            _colorTarget->SetLayout(VK_IMAGE_LAYOUT_UNDEFINED);
-        }
-
-        void TransitionToAttachmentLayout(VkCommandBuffer cb) override {
-            {
-                _colorTarget->TransitionImageLayout(cb,
-                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                    VK_ACCESS_SHADER_WRITE_BIT,
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
-                );
-            }
-
-            // Depth
-            if (_depthTarget)
-            {
-               bool hasStencil = Helpers::FormatHelpers::IsStencilFormat(_depthTarget->GetDesc().format);
-
-                _depthTarget->TransitionImageLayout(cb,
-                    hasStencil
-                        ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-                        : VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-                    VK_ACCESS_SHADER_WRITE_BIT,
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
-                );
-            }
-        }
-
         void VisitAttachments(AttachmentVisitor visitor) override {
-            visitor(_colorTarget, VisitedAttachmentType::ColorAttachment);
+            visitor(_colorTarget, VisitedAttachmentType::ColorAttachment, {});
             
             // Depth
             if (_depthTarget)
@@ -93,7 +67,7 @@ namespace Veldrid
                 auto type = hasStencil
                     ? VisitedAttachmentType::DepthStencilAttachment
                     : VisitedAttachmentType::DepthAttachment;
-                visitor(_depthTarget, type);
+                visitor(_depthTarget, type, {});
             }
         }
 
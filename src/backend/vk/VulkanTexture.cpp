@@ -7,6 +7,8 @@
 #include "VulkanDevice.hpp"
 #include "VkTypeCvt.hpp"
 
+#include <cassert>
+
 namespace Veldrid {
     
     VulkanTexture::VulkanTexture(const sp<GraphicsDevice>& dev, const Texture::Description& desc)
@@ -148,9 +150,10 @@ namespace Veldrid {
         auto tex = new VulkanTexture{dev, desc};
         tex->_img = img;
         tex->_allocation = allocation;
-        tex->_layout = VkImageLayout::VK_IMAGE_LAYOUT_PREINITIALIZED;
-        tex->_accessFlag = 0;
-        tex->_pipelineFlag = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        tex->_InitStateTracking({
+            VkImageLayout::VK_IMAGE_LAYOUT_PREINITIALIZED,
+            0,
+            VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT });
         //ClearIfRenderTarget();
         // If the image is going to be used as a render target, we need to clear the data before its first use.
         //if (desc.usage.renderTarget) {
@@ -183,9 +186,7 @@ namespace Veldrid {
         auto tex = new VulkanTexture{dev, desc};
         tex->_img = (VkImage)nativeHandle;
         tex->_allocation = VK_NULL_HANDLE;
-        tex->_layout = layout;
-        tex->_accessFlag = accessFlag;
-        tex->_pipelineFlag = pipelineFlag;
+        tex->_InitStateTracking({ layout, accessFlag, pipelineFlag });
         //Debug.Assert(width > 0 && height > 0);
         //    _gd = gd;
         //    MipLevels = mipLevels;
@@ -209,82 +210,69 @@ namespace Veldrid {
     }
 
     
-    static std::uint32_t CalculateSubresource(
-        const Veldrid::Texture::Description& desc,
-        std::uint32_t mipLevel, std::uint32_t arrayLayer
-    ) {
-        return arrayLayer * desc.mipLevels+ mipLevel;
+    void VulkanTexture::_InitStateTracking(const SubresState& state) {
+        _layerCount = description.usage.cubemap
+            ? 6 * description.arrayLayers
+            : description.arrayLayers;
+        _mipStates.assign(description.mipLevels, { _LayerRun{ _layerCount, state } });
     }
 
-    void VulkanTexture::TransitionImageLayout(
-        VkCommandBuffer cb,
-        //std::uint32_t baseMipLevel,
-        //std::uint32_t levelCount,
-        //std::uint32_t baseArrayLayer,
-        //std::uint32_t layerCount,
-        VkImageLayout layout,
-        VkAccessFlags accessFlag,
-        VkPipelineStageFlags pipelineFlag
-    ){
-        /*VkImageLayout oldLayout = _imageLayouts[
-           CalculateSubresource(description, baseMipLevel, baseArrayLayer)];
-#ifdef VLD_DEBUG
-        //layout of all subresources should be the same
-        for (unsigned level = 0; level < levelCount; level++)
-        {
-            for (unsigned layer = 0; layer < layerCount; layer++)
-            {
-                assert(_imageLayouts[CalculateSubresource(
-                    description, baseMipLevel + level, baseArrayLayer + layer)] == oldLayout);
-            }
-        }
-#endif*/
-        if (_layout       == layout
-         && _accessFlag   == accessFlag
-         && _pipelineFlag == pipelineFlag) {
-            return;
-        }
+    _TexSubresRange VulkanTexture::ResolveRange(const _TexSubresRange& range) const {
+        _TexSubresRange r = range;
+        if (r.levelCount == ~0u) r.levelCount = description.mipLevels - r.baseMipLevel;
+        if (r.layerCount == ~0u) r.layerCount = _layerCount - r.baseArrayLayer;
+        assert(r.baseMipLevel + r.levelCount <= description.mipLevels);
+        assert(r.baseArrayLayer + r.layerCount <= _layerCount);
+        return r;
+    }
 
-        VkImageMemoryBarrier barrier{};
-        barrier.oldLayout = _layout;
-        barrier.newLayout = layout;
-        barrier.srcAccessMask = _accessFlag;
-        barrier.dstAccessMask = accessFlag;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = _img;
-        auto& aspectMask = barrier.subresourceRange.aspectMask;
-        if (description.usage.depthStencil) {
-            aspectMask = Helpers::FormatHelpers::IsStencilFormat(description.format)
-                ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT
-                : VK_IMAGE_ASPECT_DEPTH_BIT;
-        }
-        else {
-            aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    const VulkanTexture::SubresState& VulkanTexture::GetState(
+        std::uint32_t mipLevel, std::uint32_t arrayLayer
+    ) const {
+        auto& runs = _mipStates[mipLevel];
+        for (auto& run : runs) {
+            if (arrayLayer < run.endLayer) return run.state;
         }
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = description.mipLevels;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = description.arrayLayers;
-
-        VkPipelineStageFlags srcStageFlags = _pipelineFlag;
-        VkPipelineStageFlags dstStageFlags = pipelineFlag;
-
-        vkCmdPipelineBarrier(
-            cb,
-            srcStageFlags,
-            dstStageFlags,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
+        assert(false);
+        return runs.back().state;
+    }
 
-        _layout = layout;
-        _pipelineFlag = pipelineFlag;
-        _accessFlag = accessFlag;
+    void VulkanTexture::SetState(const _TexSubresRange& range, const SubresState& newState) {
+        auto r = ResolveRange(range);
+        auto first = r.baseArrayLayer, last = r.baseArrayLayer + r.layerCount;
 
+        for (auto mip = r.baseMipLevel; mip < r.baseMipLevel + r.levelCount; mip++) {
+            auto& runs = _mipStates[mip];
+            if (runs.size() == 1 && runs[0].state == newState) continue;
+            if (first == 0 && last == _layerCount) {
+                runs.assign(1, _LayerRun{ _layerCount, newState });
+                continue;
+            }
+
+            //Rebuild the run list: untouched head, new run, untouched tail
+            _scratchRuns.clear();
+            auto push = [&](std::uint32_t end, const SubresState& state) {
+                if (!_scratchRuns.empty() && _scratchRuns.back().state == state) {
+                    _scratchRuns.back().endLayer = end;
+                } else {
+                    _scratchRuns.push_back({ end, state });
+                }
+            };
+            std::uint32_t begin = 0;
+            bool inserted = false;
+            for (auto& run : runs) {
+                if (begin < first) push(std::min(run.endLayer, first), run.state);
+                if (!inserted && run.endLayer > first) {
+                    push(last, newState);
+                    inserted = true;
+                }
+                if (run.endLayer > last) push(run.endLayer, run.state);
+                begin = run.endLayer;
+            }
+            runs.swap(_scratchRuns);
+        }
     }
-    
+
     VulkanTextureView::~VulkanTextureView() {
         auto _dev = reinterpret_cast<VulkanDevice*>(dev.get());
         vkDestroyImageView(_dev->LogicalDev(), _view, nullptr);
@@ -6,8 +6,11 @@
 #include "veldrid/Texture.hpp"
 #include "veldrid/Sampler.hpp"
 
+#include <algorithm>
 #include <vector>
 
+#include "VkCommon.hpp"
+
 namespace Veldrid
 {
     class VulkanDevice;
@@ -17,25 +20,45 @@ namespace Veldrid
         VkImage _img;
         VmaAllocation _allocation;
 
-        //std::vector<VkImageLayout> _imageLayouts;
-
-        //Layout tracking
-        VkImageLayout _layout;
-        VkAccessFlags _accessFlag;
-        VkPipelineStageFlags _pipelineFlag;
-
+    public:
+        //State of a subresource as left by the last submitted command list
+        struct SubresState {
+            VkImageLayout layout;
+            VkAccessFlags access;
+            VkPipelineStageFlags stage;
+
+            bool operator==(const SubresState& other) const {
+                return layout == other.layout && access == other.access && stage == other.stage;
+            }
+            bool operator!=(const SubresState& other) const { return !(*this == other); }
+        };
+
+    private:
+        //State tracking, one list of layer runs per mip level.
+        //Adjacent runs with the same state are always merged.
+        struct _LayerRun {
+            std::uint32_t endLayer;
+            SubresState state;
+        };
+        std::vector<std::vector<_LayerRun>> _mipStates;
+        std::vector<_LayerRun> _scratchRuns;
+        std::uint32_t _layerCount;
+
+        _ResTrackingTag _trackingTag;
 
         VulkanTexture(
             const sp<GraphicsDevice>& dev,
             const Texture::Description& desc
         );
 
+        void _InitStateTracking(const SubresState& state);
 
     public:
 
         ~VulkanTexture();
 
         const VkImage& GetHandle() const { return _img; }
+        _ResTrackingTag& GetTrackingTag() { return _trackingTag; }
         bool IsOwnTexture() const {return _allocation != VK_NULL_HANDLE; }
 
         static sp<Texture> Make(
@@ -55,19 +78,33 @@ namespace Veldrid
 
 
     public:
-        void TransitionImageLayout(
-            VkCommandBuffer cb,
-            //std::uint32_t baseMipLevel,
-            //std::uint32_t levelCount,
-            //std::uint32_t baseArrayLayer,
-            //std::uint32_t layerCount,
-            VkImageLayout layout,
-            VkAccessFlags accessFlag,
-            VkPipelineStageFlags pipelineFlag
-        );
-
-        const VkImageLayout& GetLayout() const { return _layout; }
-        void SetLayout(VkImageLayout newLayout) { _layout = newLayout; }
+        //Array layers of the image, cubemap faces included
+        std::uint32_t GetLayerCount() const { return _layerCount; }
+        //Replace "remaining" counts with actual values
+        _TexSubresRange ResolveRange(const _TexSubresRange& range) const;
+
+        const SubresState& GetState(std::uint32_t mipLevel, std::uint32_t arrayLayer) const;
+        void SetState(const _TexSubresRange& range, const SubresState& newState);
+
+        //Call visitor(mipLevel, baseLayer, layerCount, state) for every run
+        //of layers sharing a state inside range.
+        template<typename Visitor>
+        void VisitStates(const _TexSubresRange& range, Visitor&& visitor) const {
+            auto r = ResolveRange(range);
+            auto first = r.baseArrayLayer, last = r.baseArrayLayer + r.layerCount;
+            for (auto mip = r.baseMipLevel; mip < r.baseMipLevel + r.levelCount; mip++) {
+                std::uint32_t begin = 0;
+                for (auto& run : _mipStates[mip]) {
+                    auto runFirst = std::max(begin, first);
+                    auto runLast = std::min(run.endLayer, last);
+                    if (runFirst < runLast) {
+                        visitor(mip, runFirst, runLast - runFirst, run.state);
+                    }
+                    begin = run.endLayer;
+                    if (begin >= last) break;
+                }
+            }
+        }
 
     };
 